@@ -0,0 +1,91 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "additional_data.hpp"
+
+#include <algorithm>
+
+namespace ibm
+{
+namespace logging
+{
+
+AdditionalData::AdditionalData(const std::vector<std::string>& data)
+{
+    Item* storage = inlineStorage.data();
+    if (data.size() > inlineItems)
+    {
+        heapStorage.resize(data.size());
+        storage = heapStorage.data();
+    }
+
+    size_t count = 0;
+    for (const auto& item : data)
+    {
+        auto pos = item.find('=');
+        if (pos == std::string::npos)
+        {
+            continue;
+        }
+
+        std::string_view view{item};
+        storage[count++] = {view.substr(0, pos), view.substr(pos + 1)};
+    }
+
+    items = {storage, count};
+
+    // The sorts are stable, so the first of any duplicate names
+    // stays first.  std::stable_sort uses a temporary buffer, so
+    // insertion sort the inline items to keep from allocating.
+    if (heapStorage.empty())
+    {
+        for (size_t i = 1; i < count; i++)
+        {
+            auto item = items[i];
+            auto j = i;
+            for (; (j > 0) && (item.first < items[j - 1].first); j--)
+            {
+                items[j] = items[j - 1];
+            }
+            items[j] = item;
+        }
+    }
+    else
+    {
+        std::stable_sort(items.begin(), items.end(),
+                         [](const auto& a, const auto& b) {
+            return a.first < b.first;
+        });
+    }
+}
+
+std::optional<std::string_view>
+    AdditionalData::get(std::string_view name) const
+{
+    auto item = std::lower_bound(items.begin(), items.end(), name,
+                                 [](const auto& i, std::string_view name) {
+        return i.first < name;
+    });
+
+    if ((item != items.end()) && (item->first == name))
+    {
+        return item->second;
+    }
+
+    return {};
+}
+
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * @class AdditionalData
+ *
+ * An index of the AdditionalData property of an error log, which
+ * is an array of strings in the form of:
+ *
+ *    NAME=VALUE
+ *
+ * Each item is split once, and the names are then searched with an
+ * exact match.  Views into the property are used, so it must outlive
+ * this object.
+ *
+ * The index is kept inside the object for typically sized properties,
+ * so building one on the stack doesn't allocate.
+ */
+class AdditionalData
+{
+  public:
+    AdditionalData() = default;
+    ~AdditionalData() = default;
+    AdditionalData(const AdditionalData&) = delete;
+    AdditionalData& operator=(const AdditionalData&) = delete;
+    AdditionalData(AdditionalData&&) = delete;
+    AdditionalData& operator=(AdditionalData&&) = delete;
+
+    /**
+     * Constructor
+     *
+     * @param[in] data - the AdditionalData property contents
+     */
+    explicit AdditionalData(const std::vector<std::string>& data);
+
+    /**
+     * Finds a value.  If the name is in the data more than
+     * once, the first one is used.
+     *
+     * @param[in] name - the name of the value to find
+     *
+     * @return optional<string_view> - the value, which is empty
+     *                                 for a NAME= item.
+     */
+    std::optional<std::string_view> get(std::string_view name) const;
+
+    /**
+     * The number of NAME=VALUE items
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return items.size();
+    }
+
+  private:
+    using Item = std::pair<std::string_view, std::string_view>;
+
+    /**
+     * The number of items that fit without allocating
+     */
+    static constexpr size_t inlineItems = 32;
+
+    /**
+     * Storage for the items when there are only a few
+     */
+    std::array<Item, inlineItems> inlineStorage;
+
+    /**
+     * Storage for the items when there are too many to fit inline
+     */
+    std::vector<Item> heapStorage;
+
+    /**
+     * The items, sorted by name and then by position
+     */
+    std::span<Item> items;
+};
+
+} // namespace logging
+} // namespace ibm
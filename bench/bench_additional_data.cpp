@@ -0,0 +1,130 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "additional_data.hpp"
+
+#include <array>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using namespace ibm::logging;
+
+namespace
+{
+
+/**
+ * The names the policy modifier rules look up, in the order
+ * policy::find() tries them when none of them are present.
+ */
+constexpr std::array<const char*, 8> modifierNames{
+    "CALLOUT_DEVICE_PATH", "CALLOUT_INVENTORY_PATH", "RAIL_NAME",
+    "INPUT_NAME",          "CALLOUT_DEVICE_PATH",    "PROCEDURE",
+    "ESEL",                "CALLOUT_INVENTORY_PATH"};
+
+/**
+ * The substring search policy::find() used before AdditionalData
+ * was indexed, kept here as the baseline.
+ */
+std::optional<std::string>
+    legacyGet(const std::vector<std::string>& additionalData,
+              const std::string& name)
+{
+    std::string value;
+
+    for (const auto& item : additionalData)
+    {
+        if (item.find(name + "=") != std::string::npos)
+        {
+            value = item.substr(item.find('=') + 1);
+            if (!item.empty())
+            {
+                return value;
+            }
+        }
+    }
+
+    return {};
+}
+
+/**
+ * Makes an AdditionalData property like a host error would have,
+ * with an ESEL, a callout, and the rest filled in with FFDC.
+ *
+ * @param[in] count - the number of items
+ *
+ * @return the property contents
+ */
+std::vector<std::string> makeAdditionalData(size_t count)
+{
+    std::vector<std::string> data;
+
+    std::string esel{"ESEL="};
+    for (size_t i = 0; i < 1024; i++)
+    {
+        static constexpr auto hex = "0123456789abcdef";
+        esel += hex[(i >> 4) & 0xF];
+        esel += hex[i & 0xF];
+        esel += ' ';
+    }
+    data.push_back(std::move(esel));
+
+    for (size_t i = 0; data.size() < count - 1; i++)
+    {
+        data.push_back("FFDC_REGISTER_" + std::to_string(i) +
+                       "=0x000000000000" + std::to_string(i % 10) + "0000");
+    }
+
+    data.push_back("CALLOUT_INVENTORY_PATH=/xyz/openbmc_project/inventory/"
+                   "system/chassis/motherboard/cpu0");
+
+    return data;
+}
+
+void BM_LegacyLookup(benchmark::State& state)
+{
+    auto data = makeAdditionalData(state.range(0));
+
+    for (auto _ : state)
+    {
+        for (const auto* name : modifierNames)
+        {
+            benchmark::DoNotOptimize(legacyGet(data, name));
+        }
+    }
+}
+
+void BM_IndexedLookup(benchmark::State& state)
+{
+    auto data = makeAdditionalData(state.range(0));
+
+    for (auto _ : state)
+    {
+        AdditionalData index{data};
+        for (const auto* name : modifierNames)
+        {
+            benchmark::DoNotOptimize(index.get(name));
+        }
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_LegacyLookup)->Arg(50)->Arg(100)->Arg(200);
+BENCHMARK(BM_IndexedLookup)->Arg(50)->Arg(100)->Arg(200);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,157 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "pel.hpp"
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using namespace ibm::logging;
+
+namespace
+{
+
+/**
+ * The substr based severity lookup policy::find() used before
+ * the PEL headers were parsed, kept here as the baseline.
+ */
+std::optional<std::string> legacyESELSeverity(const std::string& data)
+{
+    static constexpr auto UH_OFFSET = 48 * 4;
+    static constexpr auto UH_EYECATCHER = "55 48";
+    static constexpr auto UH_SEV_OFFSET = 10 * 3;
+
+    std::string severity = "Critical";
+
+    const std::map<std::string, std::string> sevTypes{{"1", "Informational"},
+                                                      {"2", "Warning"}};
+    if (data.size() <= (UH_OFFSET + UH_SEV_OFFSET))
+    {
+        return {};
+    }
+
+    auto userHeader = data.substr(UH_OFFSET, 5);
+    if (userHeader.compare(UH_EYECATCHER))
+    {
+        return {};
+    }
+
+    auto sevType = data.substr(UH_OFFSET + UH_SEV_OFFSET, 1);
+
+    auto sev = sevTypes.find(sevType);
+    if (sev != sevTypes.end())
+    {
+        severity = sev->second;
+    };
+
+    return severity;
+}
+
+/**
+ * Makes the hex text of an ESEL with a PEL in it
+ *
+ * @param[in] size - the number of bytes in the ESEL
+ *
+ * @return the text, like "00 11 22"
+ */
+std::string makeESEL(size_t size)
+{
+    static constexpr auto hex = "0123456789abcdef";
+
+    std::vector<uint8_t> data(size, 0);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = i * 7;
+    }
+
+    auto* ph = &data[pel::eselHeaderSize];
+    ph[0] = 'P';
+    ph[1] = 'H';
+
+    auto* uh = ph + pel::privateHeaderSize;
+    uh[0] = 'U';
+    uh[1] = 'H';
+    uh[10] = 0x20;
+
+    std::string text;
+    text.reserve(size * 3);
+    for (auto byte : data)
+    {
+        text += hex[byte >> 4];
+        text += hex[byte & 0xF];
+        text += ' ';
+    }
+    text.pop_back();
+
+    return text;
+}
+
+void BM_LegacySeverity(benchmark::State& state)
+{
+    auto esel = makeESEL(state.range(0));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(legacyESELSeverity(esel));
+    }
+}
+
+void BM_ParseESEL(benchmark::State& state)
+{
+    auto esel = makeESEL(state.range(0));
+
+    for (auto _ : state)
+    {
+        auto header = pel::parseESEL(esel);
+        benchmark::DoNotOptimize(pel::severityName(header->severity));
+    }
+}
+
+void BM_DecodeHex(benchmark::State& state)
+{
+    auto esel = makeESEL(state.range(0));
+    std::vector<uint8_t> bytes(state.range(0));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(pel::decodeHex(esel, bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * esel.size());
+}
+
+void BM_DecodeHexScalar(benchmark::State& state)
+{
+    auto esel = makeESEL(state.range(0));
+    std::vector<uint8_t> bytes(state.range(0));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(pel::decodeHexScalar(esel, bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * esel.size());
+}
+
+} // namespace
+
+BENCHMARK(BM_LegacySeverity)->Arg(1024)->Arg(16 * 1024)->Arg(64 * 1024);
+BENCHMARK(BM_ParseESEL)->Arg(1024)->Arg(16 * 1024)->Arg(64 * 1024);
+BENCHMARK(BM_DecodeHex)->Arg(1024)->Arg(16 * 1024)->Arg(64 * 1024);
+BENCHMARK(BM_DecodeHexScalar)->Arg(1024)->Arg(16 * 1024)->Arg(64 * 1024);
+
+BENCHMARK_MAIN();
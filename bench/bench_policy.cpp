@@ -0,0 +1,456 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "additional_data.hpp"
+#include "modifier_rules.hpp"
+#include "pel.hpp"
+#include "policy_cache.hpp"
+#include "policy_find.hpp"
+#include "policy_image.hpp"
+#include "policy_table.hpp"
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using namespace ibm::logging;
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+
+constexpr auto HOST_EVENT = "org.open_power.Host.Error.Event";
+
+constexpr auto inventoryPath =
+    "/xyz/openbmc_project/inventory/system/chassis/motherboard/";
+
+/**
+ * A policy table with about the number of details entries asked for,
+ * shaped like the service team's table: most errors have a catch-all
+ * and a few modifiers, some have one per DIMM or core, and the Host
+ * event error has an entry per FRU and severity.
+ *
+ * The JSON and a compiled image of it are written to a temporary
+ * directory that is removed along with the object.
+ */
+class GeneratedPolicy
+{
+  public:
+    explicit GeneratedPolicy(size_t entries)
+    {
+        char dir[] = {"/tmp/benchPolicyXXXXXX"};
+        this->dir = mkdtemp(dir);
+        jsonFile = this->dir / "policy.json";
+        imageFile = this->dir / "policy.bin";
+
+        std::mt19937 rng{42};
+        std::uniform_int_distribution<size_t> count{1, 20};
+        std::uniform_int_distribution<size_t> percent{0, 99};
+
+        std::ostringstream json;
+        json << "[";
+
+        size_t total = 0;
+        auto addError = [&](const std::string& error,
+                            const std::vector<std::string>& modifiers) {
+            if (total)
+            {
+                json << ",";
+            }
+            json << R"({"err":")" << error << R"(","dtls":[)";
+            for (size_t d = 0; d < modifiers.size(); d++, total++)
+            {
+                json << (d ? "," : "") << R"({"CEID":"BD)" << std::hex
+                     << (0x10000000 + total) << std::dec << R"(","mod":")"
+                     << modifiers[d] << R"(","msg":"Generated error )"
+                     << total << R"("})";
+            }
+            json << "]}";
+        };
+
+        // The Host event error, keyed on FRU and severity
+        std::vector<std::string> hostModifiers;
+        for (size_t core = 0; core < 48; core++)
+        {
+            for (auto severity : {"Informational", "Warning", "Critical"})
+            {
+                hostModifiers.push_back(inventoryPath + std::string{"cpu"} +
+                                        std::to_string(core / 24) + "/core" +
+                                        std::to_string(core % 24) + "||" +
+                                        severity);
+            }
+        }
+        addError(HOST_EVENT, hostModifiers);
+
+        for (size_t e = 0; total < entries; e++)
+        {
+            auto error = "xyz.openbmc_project.Error.Gen" + std::to_string(e);
+            errors.push_back(error);
+
+            std::vector<std::string> modifiers;
+            auto kind = percent(rng);
+            if (kind < 10)
+            {
+                // An entry per DIMM
+                for (size_t dimm = 0; dimm < 64; dimm++)
+                {
+                    modifiers.push_back(inventoryPath + std::string{"dimm"} +
+                                        std::to_string(dimm));
+                }
+            }
+            else if (kind < 20)
+            {
+                modifiers = {"I2C", "FSI", "6D", "A3"};
+            }
+            else
+            {
+                auto num = count(rng);
+                for (size_t d = 0; d < num; d++)
+                {
+                    modifiers.push_back("RAIL_" + std::to_string(d));
+                }
+            }
+
+            hits.emplace_back(error, modifiers.front());
+
+            if (percent(rng) < 80)
+            {
+                modifiers.push_back("");
+            }
+
+            addError(error, modifiers);
+        }
+
+        json << "]";
+
+        std::ofstream{jsonFile} << json.str();
+        policy::image::compile(jsonFile, imageFile);
+    }
+
+    ~GeneratedPolicy()
+    {
+        fs::remove_all(dir);
+    }
+
+    GeneratedPolicy(const GeneratedPolicy&) = delete;
+    GeneratedPolicy& operator=(const GeneratedPolicy&) = delete;
+
+    /**
+     * Returns the cached table for a size, generating it once
+     *
+     * @param[in] entries - the rough number of details entries
+     *
+     * @return const GeneratedPolicy&
+     */
+    static const GeneratedPolicy& get(size_t entries)
+    {
+        static std::map<size_t, std::unique_ptr<GeneratedPolicy>> tables;
+
+        auto& table = tables[entries];
+        if (!table)
+        {
+            table = std::make_unique<GeneratedPolicy>(entries);
+        }
+        return *table;
+    }
+
+    /**
+     * Loads the table from the JSON or from the image
+     *
+     * @param[in] image - if the image should be used
+     *
+     * @return Table
+     */
+    policy::Table load(bool image) const
+    {
+        return image ? policy::Table{imageFile, dir / "missing.json"}
+                     : policy::Table{jsonFile};
+    }
+
+    fs::path dir;
+    fs::path jsonFile;
+    fs::path imageFile;
+
+    /**
+     * The generated errors, other than the Host event
+     */
+    std::vector<std::string> errors;
+
+    /**
+     * An error and modifier pair in the table for each error
+     */
+    std::vector<std::pair<std::string, std::string>> hits;
+};
+
+/**
+ * Makes the hex text of an ESEL with a PEL of the given severity,
+ * like the host sends.
+ *
+ * @param[in] size - the number of bytes in the ESEL
+ * @param[in] severity - the PEL severity byte
+ *
+ * @return the text, like "00 11 22"
+ */
+std::string makeESEL(size_t size, uint8_t severity)
+{
+    static constexpr auto hex = "0123456789abcdef";
+
+    std::vector<uint8_t> data(size, 0);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = i * 7;
+    }
+
+    auto* ph = &data[pel::eselHeaderSize];
+    ph[0] = 'P';
+    ph[1] = 'H';
+
+    auto* uh = ph + pel::privateHeaderSize;
+    uh[0] = 'U';
+    uh[1] = 'H';
+    uh[10] = severity;
+
+    std::string text;
+    text.reserve(size * 3);
+    for (auto byte : data)
+    {
+        text += hex[byte >> 4];
+        text += hex[byte & 0xF];
+        text += ' ';
+    }
+    text.pop_back();
+
+    return text;
+}
+
+/**
+ * Makes the AdditionalData property of a typical error, with the
+ * metadata phosphor-logging adds and the modifier fields last.
+ *
+ * @param[in] fields - the NAME=VALUE items the error has
+ *
+ * @return the property
+ */
+std::vector<std::string> makeAdditionalData(std::vector<std::string> fields)
+{
+    std::vector<std::string> data{
+        "_PID=1234", "_CODE_FILE=/usr/src/debug/phosphor-hwmon/mainloop.cpp",
+        "_CODE_LINE=123", "_CODE_FUNC=read", "CALLOUT_ERRNO=5",
+        "SENSOR_NAME=/xyz/openbmc_project/sensors/temperature/dimm0"};
+
+    data.insert(data.end(), fields.begin(), fields.end());
+    return data;
+}
+
+/**
+ * The error logs used for the policy::find() benchmarks: a plain
+ * catch-all hit, an inventory callout, a PROCEDURE callout, a Host
+ * event with an 8KB ESEL, and an error that isn't in the table.
+ */
+std::vector<DbusPropertyMap> makeLogs(const GeneratedPolicy& generated)
+{
+    using namespace std::literals::string_literals;
+
+    std::vector<DbusPropertyMap> logs;
+
+    auto add = [&logs](const std::string& message,
+                       std::vector<std::string> fields) {
+        logs.push_back(
+            {{"Message"s, Value{message}},
+             {"AdditionalData"s, makeAdditionalData(std::move(fields))}});
+    };
+
+    add(generated.errors[1], {});
+    add(generated.errors[2],
+        {"CALLOUT_INVENTORY_PATH="s + inventoryPath + "dimm12"});
+    add(generated.errors[3], {"PROCEDURE=109"});
+    add(HOST_EVENT, {"ESEL=" + makeESEL(8 * 1024, 0x40),
+                     "CALLOUT_INVENTORY_PATH="s + inventoryPath +
+                         "cpu1/core3"});
+    add("xyz.openbmc_project.Error.NotInTable", {});
+
+    return logs;
+}
+
+constexpr size_t findTableSize = 10000;
+
+void BM_LoadJSON(benchmark::State& state)
+{
+    const auto& generated = GeneratedPolicy::get(state.range(0));
+
+    for (auto _ : state)
+    {
+        auto table = generated.load(false);
+        benchmark::DoNotOptimize(table.isLoaded());
+    }
+    state.SetBytesProcessed(state.iterations() *
+                            fs::file_size(generated.jsonFile));
+}
+
+void BM_LoadImage(benchmark::State& state)
+{
+    const auto& generated = GeneratedPolicy::get(state.range(0));
+
+    for (auto _ : state)
+    {
+        auto table = generated.load(true);
+        benchmark::DoNotOptimize(table.isLoaded());
+    }
+}
+
+/**
+ * Looks up every error's first modifier, which is in the table
+ */
+void BM_TableFindHit(benchmark::State& state)
+{
+    const auto& generated = GeneratedPolicy::get(findTableSize);
+    auto table = generated.load(state.range(0));
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        const auto& [error, modifier] =
+            generated.hits[i++ % generated.hits.size()];
+        benchmark::DoNotOptimize(table.find(error, modifier));
+    }
+}
+
+/**
+ * Looks up errors that aren't in the table
+ */
+void BM_TableFindMiss(benchmark::State& state)
+{
+    const auto& generated = GeneratedPolicy::get(findTableSize);
+    auto table = generated.load(state.range(0));
+
+    std::vector<std::string> errors;
+    for (size_t e = 0; e < 1000; e++)
+    {
+        errors.push_back("xyz.openbmc_project.Error.Missing" +
+                         std::to_string(e));
+    }
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(table.find(errors[i++ % errors.size()], ""));
+    }
+}
+
+/**
+ * Looks up modifiers that aren't in the table, so the catch-all
+ * entry is used when there is one
+ */
+void BM_TableFindCatchAll(benchmark::State& state)
+{
+    const auto& generated = GeneratedPolicy::get(findTableSize);
+    auto table = generated.load(state.range(0));
+
+    const std::string modifier{inventoryPath + std::string{"fan0"}};
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        const auto& error = generated.errors[i++ % generated.errors.size()];
+        benchmark::DoNotOptimize(table.find(error, modifier));
+    }
+}
+
+/**
+ * policy::find() on each kind of log, from the properties to
+ * the returned strings
+ */
+void BM_PolicyFind(benchmark::State& state)
+{
+    const auto& generated = GeneratedPolicy::get(findTableSize);
+    auto table = generated.load(false);
+    auto logs = makeLogs(generated);
+    const auto& log = logs[state.range(0)];
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(policy::find(table, log));
+    }
+}
+
+void BM_PolicyFindCached(benchmark::State& state)
+{
+    const auto& generated = GeneratedPolicy::get(findTableSize);
+    auto table = generated.load(false);
+    auto logs = makeLogs(generated);
+    const auto& log = logs[state.range(0)];
+
+    policy::Cache cache{POLICY_CACHE_SIZE};
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(policy::find(table, cache, log));
+    }
+}
+
+/**
+ * Getting the Host event search modifier, which includes the
+ * severity from the ESEL, out of a log's AdditionalData
+ */
+void BM_ESELSeverity(benchmark::State& state)
+{
+    auto data = makeAdditionalData(
+        {"ESEL=" + makeESEL(state.range(0), 0x20),
+         "CALLOUT_INVENTORY_PATH=" + std::string{inventoryPath} + "cpu0"});
+
+    const auto& rules = policy::Rules::defaults();
+    policy::ModifierBuffer first;
+    policy::ModifierBuffer fallback;
+
+    for (auto _ : state)
+    {
+        AdditionalData ad{data};
+        auto modifiers = rules.evaluate(HOST_EVENT, ad, first, fallback);
+        benchmark::DoNotOptimize(modifiers.firstTry);
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_LoadJSON)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadImage)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+
+// The argument is 0 for a table from JSON, 1 for one from an image
+BENCHMARK(BM_TableFindHit)->Arg(0)->Arg(1);
+BENCHMARK(BM_TableFindMiss)->Arg(0)->Arg(1);
+BENCHMARK(BM_TableFindCatchAll)->Arg(0)->Arg(1);
+
+// The argument is the index of the log in makeLogs()
+BENCHMARK(BM_PolicyFind)->DenseRange(0, 4);
+BENCHMARK(BM_PolicyFindCached)->DenseRange(0, 4);
+
+BENCHMARK(BM_ESELSeverity)->Arg(1024)->Arg(16 * 1024)->Arg(64 * 1024);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,224 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "callout_loader.hpp"
+#include "callout_store.hpp"
+
+#include <experimental/filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using namespace ibm::logging;
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+
+constexpr uint32_t numLogs = 5000;
+constexpr uint32_t calloutsPerLog = 3;
+
+constexpr auto entryPath = "/xyz/openbmc_project/logging/entry/";
+
+/**
+ * A callout store full of logs with callouts, like after
+ * a restart with a full repository.  Half of the logs
+ * were deleted and replaced since the last compaction.
+ *
+ * It is written to a temporary directory that is removed
+ * along with the object.
+ */
+class GeneratedStore
+{
+  public:
+    explicit GeneratedStore(bool withIndex)
+    {
+        char dir[] = {"/tmp/benchRestoreXXXXXX"};
+        this->dir = mkdtemp(dir);
+
+        CalloutStore store{this->dir};
+        store.loadIndex();
+
+        for (uint32_t id = 1; id <= numLogs * 3 / 2; id++)
+        {
+            for (uint32_t num = 0; num < calloutsPerLog; num++)
+            {
+                CalloutRecord record;
+                record.entryID = id;
+                record.calloutNum = num;
+                record.timestamp = 1520000000000 + id;
+                record.inventoryPath =
+                    "/xyz/openbmc_project/inventory/system/chassis/"
+                    "motherboard/cpu0/core" +
+                    std::to_string(num);
+                record.buildDate = "2018-03-14 - 12:00:00";
+                record.manufacturer = "IBM";
+                record.model = "Processor Module";
+                record.partNumber = "02CY211";
+                record.serialNumber = "YA1934" + std::to_string(id);
+                store.append(record);
+            }
+
+            if (id > numLogs)
+            {
+                store.erase(id - numLogs);
+            }
+        }
+        store.sync();
+
+        if (withIndex)
+        {
+            store.saveIndex();
+        }
+    }
+
+    ~GeneratedStore()
+    {
+        fs::remove_all(dir);
+    }
+
+    GeneratedStore(const GeneratedStore&) = delete;
+    GeneratedStore& operator=(const GeneratedStore&) = delete;
+
+    /**
+     * Returns the cached store, generating it once
+     *
+     * @param[in] withIndex - if it should have a restore index
+     *
+     * @return const GeneratedStore&
+     */
+    static const GeneratedStore& get(bool withIndex)
+    {
+        static std::map<bool, std::unique_ptr<GeneratedStore>> stores;
+
+        auto& store = stores[withIndex];
+        if (!store)
+        {
+            store = std::make_unique<GeneratedStore>(withIndex);
+        }
+        return *store;
+    }
+
+    fs::path dir;
+};
+
+/**
+ * Stands in for creating the D-Bus objects on the bus thread,
+ * which needs a bus: makes the object path and keeps a copy of
+ * the properties, as the Callout object would.
+ */
+struct Published
+{
+    std::vector<std::string> paths;
+    std::vector<CalloutRecord> callouts;
+
+    void publish(const CalloutRecord& record)
+    {
+        paths.push_back(entryPath + std::to_string(record.entryID) +
+                        "/callouts/" + std::to_string(record.calloutNum));
+        callouts.push_back(record);
+    }
+};
+
+void BM_LoadIndex(benchmark::State& state)
+{
+    const auto& generated = GeneratedStore::get(state.range(0));
+
+    for (auto _ : state)
+    {
+        CalloutStore store{generated.dir};
+        auto index = store.loadIndex();
+        benchmark::DoNotOptimize(index.size());
+    }
+}
+
+void BM_RestoreSerial(benchmark::State& state)
+{
+    const auto& generated = GeneratedStore::get(true);
+
+    for (auto _ : state)
+    {
+        CalloutStore store{generated.dir};
+        Published published;
+
+        for (const auto& [entryID, summary] : store.loadIndex())
+        {
+            for (const auto& record : store.read(entryID))
+            {
+                published.publish(record);
+            }
+        }
+        benchmark::DoNotOptimize(published.callouts.size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * numLogs * calloutsPerLog);
+}
+
+void BM_RestoreParallel(benchmark::State& state)
+{
+    const auto& generated = GeneratedStore::get(true);
+
+    for (auto _ : state)
+    {
+        CalloutStore store{generated.dir};
+        Published published;
+
+        std::vector<uint32_t> ids;
+        for (const auto& [entryID, summary] : store.loadIndex())
+        {
+            ids.push_back(entryID);
+        }
+
+        CalloutLoader loader{store, std::move(ids),
+                             static_cast<size_t>(state.range(0))};
+        CalloutLoader::Batch batch;
+
+        while (loader.next(batch))
+        {
+            for (const auto& loaded : batch)
+            {
+                for (const auto& record : loaded.records)
+                {
+                    published.publish(record);
+                }
+            }
+        }
+        benchmark::DoNotOptimize(published.callouts.size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * numLogs * calloutsPerLog);
+}
+
+} // namespace
+
+// The argument is 1 to use the restore index, 0 to read the whole log
+BENCHMARK(BM_LoadIndex)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// 5,000 logs with 3 callouts each
+BENCHMARK(BM_RestoreSerial)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The argument is the number of decoding threads
+BENCHMARK(BM_RestoreParallel)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -88,6 +88,36 @@ Callout::Callout(sdbusplus::bus_t& bus, const std::string& objectPath,
     entryID(id), timestamp(timestamp)
 {}
 
+Callout::Callout(sdbusplus::bus_t& bus, const std::string& objectPath,
+                 const CalloutRecord& record) :
+    CalloutObject(bus, objectPath.c_str(), CalloutObject::action::defer_emit),
+    entryID(record.calloutNum), timestamp(record.timestamp)
+{
+    path(record.inventoryPath);
+    buildDate(record.buildDate);
+    manufacturer(record.manufacturer);
+    model(record.model);
+    partNumber(record.partNumber);
+    serialNumber(record.serialNumber);
+}
+
+CalloutRecord Callout::record(uint32_t logID) const
+{
+    CalloutRecord record;
+
+    record.entryID = logID;
+    record.calloutNum = entryID;
+    record.timestamp = timestamp;
+    record.inventoryPath = path();
+    record.buildDate = buildDate();
+    record.manufacturer = manufacturer();
+    record.model = model();
+    record.partNumber = partNumber();
+    record.serialNumber = serialNumber();
+
+    return record;
+}
+
 Callout::Callout(sdbusplus::bus_t& bus, const std::string& objectPath,
                  const std::string& inventoryPath, size_t id,
                  uint64_t timestamp, const DbusPropertyMap& properties) :
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "callout_store.hpp"
 #include "dbus.hpp"
 #include "interfaces.hpp"
 
@@ -62,6 +63,29 @@ class Callout : public CalloutObject
     Callout(sdbusplus::bus_t& bus, const std::string& objectPath, size_t id,
             uint64_t timestamp);
 
+    /**
+     * Constructor
+     *
+     * This version is for restoring the callout from its record
+     * in the CalloutStore.  The object isn't added to D-Bus until
+     * emit_object_added() is called.
+     *
+     * @param[in] bus - D-Bus object
+     * @param[in] objectPath - object path
+     * @param[in] record - the persisted callout
+     */
+    Callout(sdbusplus::bus_t& bus, const std::string& objectPath,
+            const CalloutRecord& record);
+
+    /**
+     * Returns the record to persist the callout in the CalloutStore
+     *
+     * @param[in] logID - the ID of the error log it's for
+     *
+     * @return CalloutRecord
+     */
+    CalloutRecord record(uint32_t logID) const;
+
     /**
      * Returns the callout ID
      *
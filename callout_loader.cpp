@@ -0,0 +1,143 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "callout_loader.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+
+namespace ibm
+{
+namespace logging
+{
+
+using namespace phosphor::logging;
+
+CalloutLoader::CalloutLoader(const CalloutStore& store,
+                             std::vector<uint32_t> entryIDs, size_t threads,
+                             size_t batchSize) :
+    store(store), entryIDs(std::move(entryIDs)),
+    batchSize(std::max<size_t>(batchSize, 1))
+{
+    batches.resize((this->entryIDs.size() + this->batchSize - 1) /
+                   this->batchSize);
+
+    threads = std::min(threadCount(threads), batches.size());
+
+    for (size_t i = 0; i < threads; i++)
+    {
+        this->threads.emplace_back(&CalloutLoader::run, this);
+    }
+}
+
+CalloutLoader::~CalloutLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    spaceReady.notify_all();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+size_t CalloutLoader::threadCount(size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    return threads;
+}
+
+bool CalloutLoader::next(Batch& batch)
+{
+    std::unique_lock<std::mutex> lock{mutex};
+
+    if (nextToReturn == batches.size())
+    {
+        return false;
+    }
+
+    batchReady.wait(lock, [this] { return batches[nextToReturn].has_value(); });
+
+    batch = std::move(*batches[nextToReturn]);
+    batches[nextToReturn].reset();
+    nextToReturn++;
+    spaceReady.notify_all();
+
+    return true;
+}
+
+void CalloutLoader::run()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+
+    while (true)
+    {
+        // Don't get too far ahead of what's been returned
+        spaceReady.wait(lock, [this] {
+            return stopping || (nextToLoad == batches.size()) ||
+                   (nextToLoad < nextToReturn + maxAhead);
+        });
+        if (stopping || (nextToLoad == batches.size()))
+        {
+            break;
+        }
+
+        auto number = nextToLoad++;
+
+        lock.unlock();
+        auto batch = load(number);
+        lock.lock();
+
+        batches[number] = std::move(batch);
+        batchReady.notify_all();
+    }
+}
+
+CalloutLoader::Batch CalloutLoader::load(size_t number)
+{
+    auto begin = number * batchSize;
+    auto end = std::min(begin + batchSize, entryIDs.size());
+
+    Batch batch;
+    batch.reserve(end - begin);
+
+    for (auto i = begin; i < end; i++)
+    {
+        Loaded loaded{entryIDs[i], {}};
+        try
+        {
+            loaded.records = store.read(entryIDs[i]);
+        }
+        catch (const std::exception& e)
+        {
+            log<level::ERR>("Failed reading saved callouts",
+                            entry("ENTRY_ID=%u", entryIDs[i]),
+                            entry("ERROR=%s", e.what()));
+        }
+        batch.push_back(std::move(loaded));
+    }
+
+    return batch;
+}
+
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "callout_store.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * @class CalloutLoader
+ *
+ * Reads and decodes the saved callouts of a list of error logs on a
+ * pool of threads, and hands them back a batch at a time in the
+ * order of the list, so the caller can create the D-Bus objects for
+ * one batch while the next ones are being read.
+ *
+ * The threads only read the store, so it must not be written to
+ * until the loader is destroyed.
+ */
+class CalloutLoader
+{
+  public:
+    /**
+     * The callouts of one error log
+     */
+    struct Loaded
+    {
+        uint32_t entryID;
+        std::vector<CalloutRecord> records;
+    };
+
+    using Batch = std::vector<Loaded>;
+
+    CalloutLoader() = delete;
+    CalloutLoader(const CalloutLoader&) = delete;
+    CalloutLoader& operator=(const CalloutLoader&) = delete;
+    CalloutLoader(CalloutLoader&&) = delete;
+    CalloutLoader& operator=(CalloutLoader&&) = delete;
+
+    /**
+     * Constructor
+     *
+     * Starts the threads.
+     *
+     * @param[in] store - the store to read from
+     * @param[in] entryIDs - the logs to read the callouts of
+     * @param[in] threads - the number of threads, 0 for one per CPU
+     * @param[in] batchSize - the number of logs in a batch
+     */
+    CalloutLoader(const CalloutStore& store, std::vector<uint32_t> entryIDs,
+                  size_t threads = 0, size_t batchSize = defaultBatchSize);
+
+    /**
+     * Destructor
+     *
+     * Stops the threads, dropping any batches not returned yet.
+     */
+    ~CalloutLoader();
+
+    /**
+     * Waits for the next batch
+     *
+     * A log whose callouts couldn't be read is returned
+     * without any.
+     *
+     * @param[out] batch - the batch
+     *
+     * @return bool - false once all batches have been returned
+     */
+    bool next(Batch& batch);
+
+    /**
+     * The number of threads a loader would start
+     *
+     * @param[in] threads - the number asked for, 0 for one per CPU
+     *
+     * @return size_t
+     */
+    static size_t threadCount(size_t threads = 0);
+
+    /**
+     * The default number of logs in a batch
+     */
+    static constexpr size_t defaultBatchSize = 64;
+
+    /**
+     * The most batches read ahead of the caller
+     */
+    static constexpr size_t maxAhead = 8;
+
+  private:
+    /**
+     * The thread function, which reads batches until
+     * there are none left.
+     */
+    void run();
+
+    /**
+     * Reads the callouts for a batch
+     *
+     * @param[in] number - the batch number
+     *
+     * @return Batch - the callouts
+     */
+    Batch load(size_t number);
+
+    /**
+     * The store
+     */
+    const CalloutStore& store;
+
+    /**
+     * The logs to read, in order
+     */
+    const std::vector<uint32_t> entryIDs;
+
+    /**
+     * The number of logs in a batch
+     */
+    const size_t batchSize;
+
+    /**
+     * Guards everything below that the threads share
+     */
+    std::mutex mutex;
+
+    /**
+     * Signalled when a batch has been read
+     */
+    std::condition_variable batchReady;
+
+    /**
+     * Signalled when a batch has been returned or it's time to stop
+     */
+    std::condition_variable spaceReady;
+
+    /**
+     * The batches read and not returned yet, by batch number
+     */
+    std::vector<std::optional<Batch>> batches;
+
+    /**
+     * The next batch to read
+     */
+    size_t nextToLoad = 0;
+
+    /**
+     * The next batch to return
+     */
+    size_t nextToReturn = 0;
+
+    /**
+     * If the threads should stop
+     */
+    bool stopping = false;
+
+    /**
+     * The threads, started last
+     */
+    std::vector<std::thread> threads;
+};
+
+} // namespace logging
+} // namespace ibm
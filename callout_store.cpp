@@ -0,0 +1,965 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+
+#include "callout_store.hpp"
+
+#include "crc32.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/tuple.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+CEREAL_CLASS_VERSION(ibm::logging::CalloutRecord, CALLOUT_CLASS_VERSION);
+
+namespace ibm
+{
+namespace logging
+{
+
+namespace fs = std::experimental::filesystem;
+using namespace phosphor::logging;
+
+/**
+ * Function required by Cereal for reading a callout saved by
+ * Callout::serialize() into a record.
+ *
+ * @param[in] archive - the Cereal archive object
+ * @param[in] record - the record to restore
+ * @param[in] version - the version of the persisted data
+ */
+template <class Archive>
+void load(Archive& archive, CalloutRecord& record, const std::uint32_t version)
+{
+    size_t calloutNum;
+
+    archive(calloutNum, record.timestamp, record.inventoryPath,
+            record.buildDate, record.manufacturer, record.model,
+            record.partNumber, record.serialNumber);
+
+    record.calloutNum = calloutNum;
+}
+
+namespace
+{
+
+/**
+ * Reads the fields of a record payload, failing once
+ * it runs past the end.
+ */
+class PayloadReader
+{
+  public:
+    PayloadReader(const uint8_t* data, size_t size) : data(data), size(size)
+    {}
+
+    template <typename T>
+    bool read(T& value)
+    {
+        if (size - offset < sizeof(T))
+        {
+            return false;
+        }
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string& value)
+    {
+        uint32_t length = 0;
+        if (!read(length) || (size - offset < length))
+        {
+            return false;
+        }
+        value.assign(reinterpret_cast<const char*>(data + offset), length);
+        offset += length;
+        return true;
+    }
+
+  private:
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+};
+
+template <typename T>
+void put(std::vector<uint8_t>& buffer, const T& value)
+{
+    auto bytes = reinterpret_cast<const uint8_t*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+void put(std::vector<uint8_t>& buffer, const std::string& value)
+{
+    put(buffer, static_cast<uint32_t>(value.size()));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+/**
+ * Fills in a record header, whose payload has already been
+ * added to the buffer after it.
+ *
+ * @param[in,out] buffer - the buffer
+ * @param[in] start - the offset of the header in the buffer
+ * @param[in] type - the record type
+ */
+void finishRecord(std::vector<uint8_t>& buffer, size_t start,
+                  store::RecordType type)
+{
+    store::RecordHeader header{};
+    header.magic = store::recordMagic;
+    header.type = static_cast<uint16_t>(type);
+    header.size = buffer.size() - start - sizeof(header);
+
+    auto checked = offsetof(store::RecordHeader, type);
+    header.checksum =
+        crc32(reinterpret_cast<const uint8_t*>(&header) + checked,
+              offsetof(store::RecordHeader, checksum) - checked);
+    header.checksum = crc32(buffer.data() + start + sizeof(header),
+                            header.size, header.checksum);
+
+    std::memcpy(buffer.data() + start, &header, sizeof(header));
+}
+
+/**
+ * Starts a record in the buffer, leaving room for its header
+ *
+ * @param[in,out] buffer - the buffer
+ *
+ * @return size_t - the offset of the record
+ */
+size_t startRecord(std::vector<uint8_t>& buffer)
+{
+    auto start = buffer.size();
+    buffer.resize(start + sizeof(store::RecordHeader));
+    return start;
+}
+
+/**
+ * Decodes a callout record's payload
+ *
+ * @param[in] data - the payload
+ * @param[in] size - the payload size
+ * @param[out] record - the callout
+ *
+ * @return bool - if the payload was valid
+ */
+bool decode(const uint8_t* data, size_t size, CalloutRecord& record)
+{
+    PayloadReader reader{data, size};
+
+    return reader.read(record.entryID) && reader.read(record.calloutNum) &&
+           reader.read(record.timestamp) &&
+           reader.read(record.inventoryPath) &&
+           reader.read(record.buildDate) && reader.read(record.manufacturer) &&
+           reader.read(record.model) && reader.read(record.partNumber) &&
+           reader.read(record.serialNumber);
+}
+
+/**
+ * Reads part of a file
+ *
+ * @param[in] fd - the file descriptor
+ * @param[in] offset - where to start
+ * @param[in] size - how much to read
+ *
+ * @return vector - the data
+ */
+std::vector<uint8_t> readRange(int fd, uint64_t offset, size_t size)
+{
+    std::vector<uint8_t> data(size);
+    size_t done = 0;
+    while (done < data.size())
+    {
+        auto rc = pread(fd, data.data() + done, data.size() - done,
+                        offset + done);
+        if (rc < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (rc <= 0)
+        {
+            throw std::runtime_error{"Could not read the callout log"};
+        }
+        done += rc;
+    }
+
+    return data;
+}
+
+/**
+ * Returns the size of a file
+ *
+ * @param[in] fd - the file descriptor
+ *
+ * @return uint64_t - the size
+ */
+uint64_t fileLength(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        throw std::runtime_error{"Could not stat the callout log"};
+    }
+    return st.st_size;
+}
+
+/**
+ * Checks a record's header and checksum
+ *
+ * @param[in] data - the record
+ * @param[in] size - the bytes available from the record on
+ * @param[out] header - the record header
+ *
+ * @return bool - if there is a valid record there
+ */
+bool checkRecord(const uint8_t* data, size_t size, store::RecordHeader& header)
+{
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if ((header.magic != store::recordMagic) ||
+        (size - sizeof(header) < header.size))
+    {
+        return false;
+    }
+
+    auto checked = offsetof(store::RecordHeader, type);
+    auto checksum = crc32(reinterpret_cast<const uint8_t*>(&header) + checked,
+                          offsetof(store::RecordHeader, checksum) - checked);
+    return crc32(data + sizeof(header), header.size, checksum) ==
+           header.checksum;
+}
+
+/**
+ * Writes a whole buffer to a file at an offset
+ *
+ * @param[in] fd - the file descriptor
+ * @param[in] data - the data
+ * @param[in] size - the data size
+ * @param[in] offset - where to write it
+ *
+ * @return bool - if it was all written
+ */
+bool writeAll(int fd, const uint8_t* data, size_t size, off_t offset)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        auto rc = pwrite(fd, data + done, size - done, offset + done);
+        if (rc < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (rc <= 0)
+        {
+            return false;
+        }
+        done += rc;
+    }
+    return true;
+}
+
+/**
+ * Writes a new file, syncs it, and renames it into place
+ *
+ * @param[in] path - the file to replace
+ * @param[in] data - the contents
+ */
+void replaceFile(const fs::path& path, const std::vector<uint8_t>& data)
+{
+    auto tempPath = path.string() + ".tmp";
+
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                    0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error{"Could not create " + tempPath};
+    }
+
+    auto ok = writeAll(fd, data.data(), data.size(), 0) && (fdatasync(fd) == 0);
+    close(fd);
+
+    if (!ok)
+    {
+        fs::remove(tempPath);
+        throw std::runtime_error{"Failed writing " + tempPath};
+    }
+
+    fs::rename(tempPath, path);
+
+    // Make the rename itself stick
+    fd = ::open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/**
+ * Returns a new log file with just a header
+ *
+ * @param[in] generation - the file's generation
+ *
+ * @return vector - the file contents
+ */
+std::vector<uint8_t> newFile(uint32_t generation = 0)
+{
+    store::FileHeader header{};
+    std::memcpy(header.magic, store::magic, sizeof(header.magic));
+    header.version = store::version;
+    header.generation = generation;
+
+    std::vector<uint8_t> data(sizeof(header));
+    std::memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+} // namespace
+
+CalloutStore::CalloutStore(const fs::path& dir) :
+    dir(dir), path(dir / fileName), indexPath(dir / indexName)
+{}
+
+CalloutStore::~CalloutStore()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+void CalloutStore::open()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    // The old files are still intact if these are here
+    fs::remove(path.string() + ".tmp");
+    fs::remove(indexPath.string() + ".tmp");
+
+    if (!fs::exists(path))
+    {
+        // An index can only be for an older log file
+        fs::remove(indexPath);
+
+        // The first time, the file is written with any old
+        // callouts already in it.
+        fs::create_directories(dir);
+
+        auto data = newFile();
+        auto oldDirs = migrate(data);
+
+        replaceFile(path, data);
+
+        for (const auto& oldDir : oldDirs)
+        {
+            fs::remove_all(oldDir);
+        }
+    }
+    else
+    {
+        // The log already has their callouts if the old directories
+        // are still here, as it's only written after they're read.
+        auto leftovers = findOldDirs();
+        for (const auto& [entryID, oldDir] : leftovers)
+        {
+            fs::remove_all(oldDir);
+        }
+
+        if (!leftovers.empty())
+        {
+            log<level::INFO>("Removed old saved callout directories",
+                             entry("LOGS=%zu", leftovers.size()));
+        }
+    }
+
+    fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error{"Could not open " + path.string()};
+    }
+
+    generation = 0;
+    fileBytes = sizeof(store::FileHeader);
+    liveBytes = 0;
+    indexedBytes = 0;
+    scannedBytes = 0;
+    logs.clear();
+}
+
+CalloutStore::Index CalloutStore::loadIndex()
+{
+    open();
+
+    auto size = fileLength(fd);
+
+    store::FileHeader header{};
+    if (size >= sizeof(header))
+    {
+        auto data = readRange(fd, 0, sizeof(header));
+        std::memcpy(&header, data.data(), sizeof(header));
+    }
+
+    if ((size < sizeof(header)) ||
+        std::memcmp(header.magic, store::magic, sizeof(header.magic)) ||
+        (header.version != store::version))
+    {
+        // Keep the bad file around to look at, and start over
+        log<level::ERR>("Invalid callout log. Moving it aside",
+                        entry("FILE=%s", path.c_str()));
+        fs::rename(path, path.string() + ".bad");
+        open();
+        return {};
+    }
+
+    generation = header.generation;
+
+    // Only what was written after the index was saved has to be read
+    scan(readIndex() ? indexedBytes : sizeof(header));
+
+    Index index;
+    for (const auto& [entryID, saved] : logs)
+    {
+        index.emplace(entryID,
+                      Summary{saved.timestamp,
+                              static_cast<uint32_t>(saved.records.size())});
+    }
+
+    return index;
+}
+
+CalloutStore::Records CalloutStore::load()
+{
+    Records records;
+
+    for (const auto& [entryID, summary] : loadIndex())
+    {
+        records.emplace(entryID, read(entryID));
+    }
+
+    return records;
+}
+
+bool CalloutStore::readIndex()
+{
+    int indexFD = ::open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (indexFD < 0)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    try
+    {
+        data = readRange(indexFD, 0, fileLength(indexFD));
+    }
+    catch (const std::exception& e)
+    {
+        close(indexFD);
+        return false;
+    }
+    close(indexFD);
+
+    store::IndexHeader header{};
+    if (data.size() < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    auto checksum = crc32(&header, offsetof(store::IndexHeader, checksum));
+    checksum = crc32(data.data() + sizeof(header), data.size() - sizeof(header),
+                     checksum);
+
+    // It has to be for this log file, which can have been
+    // added to since, but not cut short.
+    if (std::memcmp(header.magic, store::indexMagic, sizeof(header.magic)) ||
+        (header.version != store::indexVersion) ||
+        (header.checksum != checksum) || (header.generation != generation) ||
+        (header.logSize < sizeof(store::FileHeader)) ||
+        (header.logSize > fileLength(fd)))
+    {
+        log<level::INFO>("Not using the callout restore index",
+                         entry("FILE=%s", indexPath.c_str()));
+        return false;
+    }
+
+    PayloadReader reader{data.data() + sizeof(header),
+                         data.size() - sizeof(header)};
+    uint64_t live = 0;
+
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+        store::IndexEntry indexEntry;
+        if (!reader.read(indexEntry))
+        {
+            logs.clear();
+            return false;
+        }
+
+        auto& saved = logs[indexEntry.entryID];
+        saved.timestamp = indexEntry.timestamp;
+
+        for (uint32_t j = 0; j < indexEntry.count; j++)
+        {
+            store::IndexLocation location;
+            if (!reader.read(location) ||
+                (location.offset < sizeof(store::FileHeader)) ||
+                (location.offset + location.size > header.logSize))
+            {
+                logs.clear();
+                return false;
+            }
+
+            saved.records.push_back({location.offset, location.size});
+            live += location.size;
+        }
+    }
+
+    liveBytes = live;
+    indexedBytes = header.logSize;
+
+    return true;
+}
+
+void CalloutStore::scan(uint64_t start)
+{
+    auto data = readRange(fd, start, fileLength(fd) - start);
+    scannedBytes = data.size();
+
+    size_t offset = 0;
+    store::RecordHeader recordHeader;
+
+    while (checkRecord(data.data() + offset, data.size() - offset,
+                       recordHeader))
+    {
+        auto payload = data.data() + offset + sizeof(recordHeader);
+        auto payloadSize = recordHeader.size;
+
+        Location location{start + offset,
+                          static_cast<uint32_t>(sizeof(recordHeader) +
+                                                payloadSize)};
+
+        auto type = static_cast<store::RecordType>(recordHeader.type);
+        if (type == store::RecordType::callout)
+        {
+            CalloutRecord record;
+            if (decode(payload, payloadSize, record))
+            {
+                add(record.entryID, record.timestamp, location);
+            }
+        }
+        else if (type == store::RecordType::erase)
+        {
+            uint32_t entryID = 0;
+            PayloadReader reader{payload, payloadSize};
+            if (reader.read(entryID))
+            {
+                remove(entryID);
+            }
+        }
+
+        offset += location.size;
+    }
+
+    if (offset != data.size())
+    {
+        // Most likely a record cut short by a power loss
+        log<level::ERR>("Damaged callout log. Truncating it",
+                        entry("FILE=%s", path.c_str()),
+                        entry("SIZE=%llu", static_cast<unsigned long long>(
+                                               start + data.size())),
+                        entry("GOOD_SIZE=%llu",
+                              static_cast<unsigned long long>(start + offset)));
+
+        if (ftruncate(fd, start + offset) < 0)
+        {
+            throw std::runtime_error{"Could not truncate the callout log"};
+        }
+    }
+
+    fileBytes = start + offset;
+}
+
+std::vector<CalloutRecord> CalloutStore::read(uint32_t entryID) const
+{
+    std::vector<CalloutRecord> records;
+
+    auto found = logs.find(entryID);
+    if (found == logs.end())
+    {
+        return records;
+    }
+
+    const auto& locations = found->second.records;
+    size_t i = 0;
+
+    while (i < locations.size())
+    {
+        // Records next to each other in the file are read together
+        auto offset = locations[i].offset;
+        auto end = offset + locations[i].size;
+        auto first = i++;
+
+        while ((i < locations.size()) && (locations[i].offset == end))
+        {
+            end += locations[i++].size;
+        }
+
+        auto data = readRange(fd, offset, end - offset);
+
+        for (auto j = first; j < i; j++)
+        {
+            auto recordData = data.data() + (locations[j].offset - offset);
+            store::RecordHeader header;
+            CalloutRecord record;
+
+            if (!checkRecord(recordData, locations[j].size, header) ||
+                (header.type !=
+                 static_cast<uint16_t>(store::RecordType::callout)) ||
+                !decode(recordData + sizeof(header), header.size, record) ||
+                (record.entryID != entryID))
+            {
+                log<level::ERR>("Damaged callout record",
+                                entry("ENTRY_ID=%u", entryID),
+                                entry("OFFSET=%llu",
+                                      static_cast<unsigned long long>(
+                                          locations[j].offset)));
+                continue;
+            }
+
+            records.push_back(std::move(record));
+        }
+    }
+
+    return records;
+}
+
+void CalloutStore::add(uint32_t entryID, uint64_t timestamp, Location location)
+{
+    auto [saved, added] = logs.try_emplace(entryID);
+    if (added)
+    {
+        saved->second.timestamp = timestamp;
+    }
+    else if (saved->second.timestamp != timestamp)
+    {
+        saved->second.timestamp = mixedTimestamps;
+    }
+
+    saved->second.records.push_back(location);
+    liveBytes += location.size;
+}
+
+bool CalloutStore::remove(uint32_t entryID)
+{
+    auto found = logs.find(entryID);
+    if (found == logs.end())
+    {
+        return false;
+    }
+
+    for (const auto& location : found->second.records)
+    {
+        liveBytes -= location.size;
+    }
+    logs.erase(found);
+
+    return true;
+}
+
+void CalloutStore::encode(const CalloutRecord& record,
+                          std::vector<uint8_t>& buffer)
+{
+    auto start = startRecord(buffer);
+
+    put(buffer, record.entryID);
+    put(buffer, record.calloutNum);
+    put(buffer, record.timestamp);
+    put(buffer, record.inventoryPath);
+    put(buffer, record.buildDate);
+    put(buffer, record.manufacturer);
+    put(buffer, record.model);
+    put(buffer, record.partNumber);
+    put(buffer, record.serialNumber);
+
+    finishRecord(buffer, start, store::RecordType::callout);
+}
+
+void CalloutStore::write(const std::vector<uint8_t>& buffer)
+{
+    if (fd < 0)
+    {
+        throw std::runtime_error{"The callout log isn't open"};
+    }
+
+    if (!writeAll(fd, buffer.data(), buffer.size(), fileBytes))
+    {
+        // Don't leave part of a record behind for the next one
+        // to be written after.
+        if (ftruncate(fd, fileBytes) < 0)
+        {
+            log<level::ERR>("Could not truncate the callout log",
+                            entry("ERRNO=%d", errno));
+        }
+        throw std::runtime_error{"Failed writing the callout log"};
+    }
+
+    fileBytes += buffer.size();
+}
+
+void CalloutStore::append(const CalloutRecord& record)
+{
+    std::vector<uint8_t> buffer;
+    encode(record, buffer);
+
+    auto offset = fileBytes;
+    write(buffer);
+
+    add(record.entryID, record.timestamp,
+        {offset, static_cast<uint32_t>(buffer.size())});
+}
+
+bool CalloutStore::erase(uint32_t entryID)
+{
+    if (logs.find(entryID) == logs.end())
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> buffer;
+    auto start = startRecord(buffer);
+    put(buffer, entryID);
+    finishRecord(buffer, start, store::RecordType::erase);
+
+    write(buffer);
+
+    return remove(entryID);
+}
+
+void CalloutStore::sync()
+{
+    if ((fd < 0) || (fdatasync(fd) < 0))
+    {
+        throw std::runtime_error{"Failed syncing the callout log"};
+    }
+    syncCount++;
+}
+
+bool CalloutStore::needsCompaction() const
+{
+    return (fileBytes >= minCompactSize) &&
+           (fileBytes - liveBytes > fileBytes / 2);
+}
+
+void CalloutStore::compact()
+{
+    auto old = readRange(fd, 0, fileBytes);
+    auto data = newFile(generation + 1);
+    data.reserve(sizeof(store::FileHeader) + liveBytes);
+
+    // Keep the records in ID order, so the logs are
+    // restored oldest first.
+    std::map<uint32_t, const SavedLog*> ordered;
+    for (const auto& [entryID, saved] : logs)
+    {
+        ordered.emplace(entryID, &saved);
+    }
+
+    std::unordered_map<uint32_t, SavedLog> newLogs;
+    for (const auto& [entryID, saved] : ordered)
+    {
+        auto& moved = newLogs[entryID];
+        moved.timestamp = saved->timestamp;
+
+        for (const auto& location : saved->records)
+        {
+            if (location.offset + location.size > old.size())
+            {
+                throw std::runtime_error{"Callout log changed size"};
+            }
+
+            moved.records.push_back({data.size(), location.size});
+            data.insert(data.end(), old.begin() + location.offset,
+                        old.begin() + location.offset + location.size);
+        }
+    }
+
+    replaceFile(path, data);
+
+    close(fd);
+    fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error{"Could not open " + path.string()};
+    }
+
+    // The saved index is for the old generation now
+    generation++;
+    logs = std::move(newLogs);
+    fileBytes = data.size();
+    indexedBytes = 0;
+
+    try
+    {
+        saveIndex();
+    }
+    catch (const std::exception& e)
+    {
+        log<level::ERR>("Failed saving the callout restore index",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+void CalloutStore::saveIndex()
+{
+    store::IndexHeader header{};
+    std::memcpy(header.magic, store::indexMagic, sizeof(header.magic));
+    header.version = store::indexVersion;
+    header.generation = generation;
+    header.logSize = fileBytes;
+    header.count = logs.size();
+
+    std::vector<uint8_t> data(sizeof(header));
+
+    for (const auto& [entryID, saved] : logs)
+    {
+        put(data, store::IndexEntry{
+                      entryID, static_cast<uint32_t>(saved.records.size()),
+                      saved.timestamp});
+
+        for (const auto& location : saved.records)
+        {
+            put(data, store::IndexLocation{location.offset, location.size, 0});
+        }
+    }
+
+    auto checked = offsetof(store::IndexHeader, checksum);
+    header.checksum = crc32(&header, checked);
+    header.checksum = crc32(data.data() + sizeof(header),
+                            data.size() - sizeof(header), header.checksum);
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    replaceFile(indexPath, data);
+
+    indexedBytes = fileBytes;
+}
+
+std::map<uint32_t, fs::path> CalloutStore::findOldDirs() const
+{
+    std::map<uint32_t, fs::path> oldDirs;
+
+    for (const auto& logDir : fs::directory_iterator(dir))
+    {
+        try
+        {
+            size_t end = 0;
+            auto name = logDir.path().filename().string();
+            auto entryID = std::stoul(name, &end);
+            if (end == name.size())
+            {
+                oldDirs.emplace(entryID, logDir.path());
+            }
+        }
+        catch (const std::exception& e)
+        {
+            continue;
+        }
+    }
+
+    return oldDirs;
+}
+
+std::vector<fs::path> CalloutStore::migrate(std::vector<uint8_t>& data)
+{
+    // Sort by log and then by callout, so they're restored
+    // in the same order as before.
+    std::map<uint32_t, std::map<uint32_t, CalloutRecord>> found;
+    std::vector<fs::path> oldDirs;
+
+    for (const auto& [entryID, logDir] : findOldDirs())
+    {
+        oldDirs.push_back(logDir);
+
+        auto calloutDir = logDir / "callouts";
+        if (!fs::is_directory(calloutDir))
+        {
+            continue;
+        }
+
+        for (const auto& file : fs::directory_iterator(calloutDir))
+        {
+            try
+            {
+                CalloutRecord record;
+                std::ifstream stream(file.path().c_str(), std::ios::binary);
+                cereal::BinaryInputArchive iarchive(stream);
+
+                iarchive(record);
+
+                record.entryID = entryID;
+                found[entryID][record.calloutNum] = std::move(record);
+            }
+            catch (const std::exception& e)
+            {
+                log<level::ERR>("Failed migrating a saved callout",
+                                entry("FILE=%s", file.path().c_str()),
+                                entry("ERROR=%s", e.what()));
+            }
+        }
+    }
+
+    size_t count = 0;
+    for (const auto& [entryID, callouts] : found)
+    {
+        for (const auto& [calloutNum, record] : callouts)
+        {
+            encode(record, data);
+            count++;
+        }
+    }
+
+    if (!oldDirs.empty())
+    {
+        log<level::INFO>("Moving the saved callouts into the callout log",
+                         entry("COUNT=%zu", count),
+                         entry("LOGS=%zu", oldDirs.size()));
+    }
+
+    return oldDirs;
+}
+
+} // namespace logging
+} // namespace ibm
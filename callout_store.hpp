@@ -0,0 +1,497 @@
+#pragma once
+
+#include <cstdint>
+#include <experimental/filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * The persisted data for one callout
+ */
+struct CalloutRecord
+{
+    uint32_t entryID = 0;    // The error log's ID
+    uint32_t calloutNum = 0; // Which of the log's callouts this is
+    uint64_t timestamp = 0;  // The error log's timestamp
+    std::string inventoryPath;
+    std::string buildDate;
+    std::string manufacturer;
+    std::string model;
+    std::string partNumber;
+    std::string serialNumber;
+};
+
+namespace store
+{
+
+/**
+ * The layout of the callout log.  All fields are in the byte order
+ * of the BMC.
+ *
+ *   FileHeader
+ *   RecordHeader, payload
+ *   RecordHeader, payload
+ *   ...
+ *
+ * Records are only ever appended, and are only durable once sync()
+ * is called.  A callout record's payload is:
+ *
+ *   uint32_t entryID
+ *   uint32_t calloutNum
+ *   uint64_t timestamp
+ *   6 x (uint32_t size, char[size]) - the inventory path and the
+ *                                     Asset properties
+ *
+ * and a delete record's payload is the uint32_t entry ID of the log
+ * whose callouts were deleted.  The checksum of a record covers the
+ * type, the size, and the payload, so a record torn by a power loss
+ * while it was being written is found and dropped.
+ */
+constexpr char magic[8] = {'I', 'B', 'M', 'C', 'A', 'L', 'O', 'G'};
+constexpr uint32_t version = 1;
+constexpr uint32_t recordMagic = 0x4C435242; // "BRCL"
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t generation; // Bumped by each compaction
+};
+
+enum class RecordType : uint16_t
+{
+    callout = 1,
+    erase = 2
+};
+
+struct RecordHeader
+{
+    uint32_t magic;
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t size;     // Of the payload
+    uint32_t checksum; // CRC-32 of type through the end of the payload
+};
+
+/**
+ * The layout of the restore index, a snapshot of where the live
+ * records of each error log are in the callout log, so startup
+ * doesn't have to read the whole log to find them.
+ *
+ *   IndexHeader
+ *   IndexEntry, count x IndexLocation
+ *   IndexEntry, count x IndexLocation
+ *   ...
+ *
+ * It is only used if it is for the same generation of the log
+ * file, and the log is at least as big as the part it covers.
+ * Records after that part are found by reading the rest of the log.
+ */
+constexpr char indexMagic[8] = {'I', 'B', 'M', 'C', 'A', 'I', 'D', 'X'};
+constexpr uint32_t indexVersion = 1;
+
+struct IndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t generation; // Of the log file
+    uint64_t logSize;    // The bytes of the log file it covers
+    uint32_t count;      // Of IndexEntry
+    uint32_t checksum;   // CRC-32 of the header up to here and the rest
+};
+
+struct IndexEntry
+{
+    uint32_t entryID;
+    uint32_t count; // Of IndexLocation
+    uint64_t timestamp;
+};
+
+struct IndexLocation
+{
+    uint64_t offset;
+    uint32_t size; // Including the record header
+    uint32_t reserved;
+};
+
+} // namespace store
+
+/**
+ * @class CalloutStore
+ *
+ * Persists callouts in a single append-only log file of CRC protected
+ * records, in place of a directory and a file per callout.  Adding a
+ * log's callouts appends their records, and deleting a log appends a
+ * small delete record, so neither touches any metadata but the log
+ * file's size.
+ *
+ * The space taken by deleted callouts is reclaimed by compact(), which
+ * writes the live records to a new file that is then renamed over the
+ * old one.  The caller decides when to run it, based on
+ * needsCompaction().
+ *
+ * Where each log's records are is also kept in a restore index file,
+ * which saveIndex() rewrites.  At startup, loadIndex() reads it along
+ * with only the part of the log written since, and the records of a
+ * log are read with read() once it is known to still exist.
+ *
+ * The first time the store is opened, any callouts saved in the old
+ * <dir>/<entry ID>/callouts/<n> files are moved into it.
+ */
+class CalloutStore
+{
+  public:
+    /**
+     * The live callouts of each error log, keyed on its ID
+     */
+    using Records = std::map<uint32_t, std::vector<CalloutRecord>>;
+
+    /**
+     * What is saved for an error log
+     */
+    struct Summary
+    {
+        uint64_t timestamp; // mixedTimestamps if its records disagree
+        uint32_t count;     // Of callouts
+    };
+
+    /**
+     * The summaries of the logs with saved callouts, keyed on the ID
+     */
+    using Index = std::map<uint32_t, Summary>;
+
+    CalloutStore() = delete;
+    CalloutStore(const CalloutStore&) = delete;
+    CalloutStore& operator=(const CalloutStore&) = delete;
+    CalloutStore(CalloutStore&&) = delete;
+    CalloutStore& operator=(CalloutStore&&) = delete;
+    ~CalloutStore();
+
+    /**
+     * Constructor
+     *
+     * Nothing is read until load() is called.
+     *
+     * @param[in] dir - the directory to keep the log file in
+     */
+    explicit CalloutStore(const std::experimental::filesystem::path& dir);
+
+    /**
+     * Opens the log file, creating it and migrating the old callout
+     * files into it if it doesn't exist yet, and finds the live
+     * callouts in it.
+     *
+     * If the restore index is valid, it is read, along with the part
+     * of the log written after it was saved.  If not, the whole log
+     * is read with one sequential read.  If the end of the log is
+     * damaged, it is truncated to the last good record.
+     *
+     * Throws a std::runtime_error on failure.
+     *
+     * @return Index - the logs with callouts
+     */
+    Index loadIndex();
+
+    /**
+     * Does a loadIndex() and then reads all of the callouts
+     *
+     * Throws a std::runtime_error on failure.
+     *
+     * @return Records - the callouts
+     */
+    Records load();
+
+    /**
+     * Reads the saved callouts of an error log, in the order
+     * they were saved.  A record that fails its checksum is
+     * skipped.
+     *
+     * This only reads the file, so calls to it can be made from
+     * several threads at once, but not while it is being written.
+     *
+     * Throws a std::runtime_error on failure.
+     *
+     * @param[in] entryID - the error log's ID
+     *
+     * @return vector - the callouts
+     */
+    std::vector<CalloutRecord> read(uint32_t entryID) const;
+
+    /**
+     * Appends a callout
+     *
+     * Throws a std::runtime_error on failure.
+     *
+     * @param[in] record - the callout
+     */
+    void append(const CalloutRecord& record);
+
+    /**
+     * Deletes all callouts for an error log.  Nothing is written
+     * if it doesn't have any.
+     *
+     * Throws a std::runtime_error on failure.
+     *
+     * @param[in] entryID - the error log's ID
+     *
+     * @return bool - if the log had any callouts
+     */
+    bool erase(uint32_t entryID);
+
+    /**
+     * Flushes the records written so far to storage
+     *
+     * Throws a std::runtime_error on failure.
+     */
+    void sync();
+
+    /**
+     * If enough of the file is taken up by deleted callouts that
+     * it should be compacted.
+     *
+     * @return bool
+     */
+    bool needsCompaction() const;
+
+    /**
+     * Rewrites the file with only the live records.  If it fails,
+     * the old file is left in place.
+     *
+     * Throws a std::runtime_error on failure.
+     */
+    void compact();
+
+    /**
+     * Writes the restore index for the records synced so far.
+     * The log must have been synced first.
+     *
+     * Throws a std::runtime_error on failure.
+     */
+    void saveIndex();
+
+    /**
+     * The bytes of the log file written since the restore index
+     * was last saved, which would have to be read at startup.
+     *
+     * @return uint64_t
+     */
+    inline uint64_t indexLag() const
+    {
+        return fileBytes - indexedBytes;
+    }
+
+    /**
+     * The bytes of the log file read at load time, which is
+     * less than all of it when the index was used.
+     *
+     * @return uint64_t
+     */
+    inline uint64_t scannedSize() const
+    {
+        return scannedBytes;
+    }
+
+    /**
+     * The size of the log file
+     *
+     * @return uint64_t
+     */
+    inline uint64_t fileSize() const
+    {
+        return fileBytes;
+    }
+
+    /**
+     * The bytes in the log file used by live records
+     *
+     * @return uint64_t
+     */
+    inline uint64_t liveSize() const
+    {
+        return liveBytes;
+    }
+
+    /**
+     * The number of times the file has been synced
+     *
+     * @return uint64_t
+     */
+    inline uint64_t syncs() const
+    {
+        return syncCount;
+    }
+
+    /**
+     * The files are compacted once they are at least this big
+     * and over half of them is garbage.
+     */
+    static constexpr uint64_t minCompactSize = 64 * 1024;
+
+    /**
+     * The index should be saved once this much has been added
+     * to the log since it last was.
+     */
+    static constexpr uint64_t maxIndexLag = 64 * 1024;
+
+    /**
+     * The Summary timestamp of a log with callouts from
+     * different logs that had the same ID.
+     */
+    static constexpr uint64_t mixedTimestamps = UINT64_MAX;
+
+    /**
+     * The name of the log file in the directory
+     */
+    static constexpr auto fileName = "callouts.log";
+
+    /**
+     * The name of the restore index file in the directory
+     */
+    static constexpr auto indexName = "callouts.idx";
+
+  private:
+    /**
+     * Where a record is in the file
+     */
+    struct Location
+    {
+        uint64_t offset;
+        uint32_t size; // Including the header
+    };
+
+    /**
+     * Where the records of a log are
+     */
+    struct SavedLog
+    {
+        uint64_t timestamp;
+        std::vector<Location> records;
+    };
+
+    /**
+     * Adds a record to what's saved for a log
+     *
+     * @param[in] entryID - the log's ID
+     * @param[in] timestamp - the log's timestamp
+     * @param[in] location - where the record is
+     */
+    void add(uint32_t entryID, uint64_t timestamp, Location location);
+
+    /**
+     * Drops what's saved for a log
+     *
+     * @param[in] entryID - the log's ID
+     *
+     * @return bool - if it had anything saved
+     */
+    bool remove(uint32_t entryID);
+
+    /**
+     * Reads the restore index into logs, if it is valid
+     * for the log file.
+     *
+     * @return bool - if it was
+     */
+    bool readIndex();
+
+    /**
+     * Reads the records in the log file from an offset to the end,
+     * truncating it at the first damaged one.
+     *
+     * @param[in] start - the offset of the first record
+     */
+    void scan(uint64_t start);
+
+    /**
+     * Encodes a callout record, header and all, onto a buffer
+     *
+     * @param[in] record - the callout
+     * @param[in,out] buffer - the buffer to add it to
+     */
+    static void encode(const CalloutRecord& record,
+                       std::vector<uint8_t>& buffer);
+
+    /**
+     * Writes the whole buffer at the end of the file
+     *
+     * @param[in] buffer - the data
+     */
+    void write(const std::vector<uint8_t>& buffer);
+
+    /**
+     * Finds the per-log directories of the old layout, which
+     * are named for their log's entry ID.
+     *
+     * @return map - the directories, keyed by entry ID
+     */
+    std::map<uint32_t, std::experimental::filesystem::path>
+        findOldDirs() const;
+
+    /**
+     * Reads any callouts saved in the old directory layout and
+     * adds their records to a buffer.
+     *
+     * @param[in,out] data - the buffer
+     *
+     * @return vector - the old directories, to remove once
+     *                  the records are saved.
+     */
+    std::vector<std::experimental::filesystem::path>
+        migrate(std::vector<uint8_t>& data);
+
+    /**
+     * Opens the log file.  If it doesn't exist yet it is created,
+     * with the callouts from the old directory layout in it, and
+     * any old restore index is removed.  Otherwise, old directories
+     * left by a migration that didn't finish are removed.  Temporary
+     * files left by a compaction or an index save that didn't finish
+     * are removed.
+     */
+    void open();
+
+    /**
+     * The directory the log file is in
+     */
+    std::experimental::filesystem::path dir;
+
+    /**
+     * The log file's path
+     */
+    std::experimental::filesystem::path path;
+
+    /**
+     * The restore index's path
+     */
+    std::experimental::filesystem::path indexPath;
+
+    /**
+     * The log file descriptor
+     */
+    int fd = -1;
+
+    /**
+     * The log file's generation
+     */
+    uint32_t generation = 0;
+
+    /**
+     * The records of the live callouts, keyed on the entry ID
+     */
+    std::unordered_map<uint32_t, SavedLog> logs;
+
+    uint64_t fileBytes = 0;
+    uint64_t liveBytes = 0;
+    uint64_t indexedBytes = 0; // Of the log covered by the saved index
+    uint64_t scannedBytes = 0;
+    uint64_t syncCount = 0;
+};
+
+} // namespace logging
+} // namespace ibm
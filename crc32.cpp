@@ -0,0 +1,63 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "crc32.hpp"
+
+#include <array>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * Builds the lookup table for the reflected 0xEDB88320 polynomial.
+ *
+ * @return array - the 256 entry table
+ */
+static constexpr std::array<uint32_t, 256> makeTable()
+{
+    std::array<uint32_t, 256> table{};
+
+    for (uint32_t i = 0; i < table.size(); i++)
+    {
+        uint32_t value = i;
+        for (auto bit = 0; bit < 8; bit++)
+        {
+            value = (value & 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1);
+        }
+        table[i] = value;
+    }
+
+    return table;
+}
+
+static constexpr auto crcTable = makeTable();
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = crcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * Calculates the standard (IEEE 802.3) CRC-32 of a buffer.
+ *
+ * The calculation can be continued across multiple buffers by
+ * passing the previous result back in as the crc parameter.
+ *
+ * @param[in] data - the data to checksum
+ * @param[in] size - the size of the data
+ * @param[in] crc - the CRC of any preceding data, 0 to start
+ *
+ * @return uint32_t - the CRC-32 value
+ */
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+} // namespace logging
+} // namespace ibm
@@ -29,21 +29,37 @@ constexpr auto PROPERTY_IFACE = "org.freedesktop.DBus.Properties";
 
 using namespace phosphor::logging;
 
-ObjectValueTree getManagedObjects(sdbusplus::bus_t& bus,
-                                  const std::string& service,
-                                  const std::string& objPath)
+sdbusplus::message_t getManagedObjectsReply(sdbusplus::bus_t& bus,
+                                            const std::string& service,
+                                            const std::string& objPath)
 {
-    ObjectValueTree interfaces;
-
     auto method = bus.new_method_call(service.c_str(), objPath.c_str(),
                                       "org.freedesktop.DBus.ObjectManager",
                                       "GetManagedObjects");
 
-    auto reply = bus.call(method);
+    return bus.call(method);
+}
+
+sd_bus_slot* getManagedObjectsAsync(sdbusplus::bus_t& bus,
+                                    const std::string& service,
+                                    const std::string& objPath,
+                                    sd_bus_message_handler_t handler,
+                                    void* data)
+{
+    sd_bus_slot* slot = nullptr;
+
+    auto method = bus.new_method_call(service.c_str(), objPath.c_str(),
+                                      "org.freedesktop.DBus.ObjectManager",
+                                      "GetManagedObjects");
 
-    reply.read(interfaces);
+    auto rc = sd_bus_call_async(bus.get(), &slot, method.get(), handler, data,
+                                0);
+    if (rc < 0)
+    {
+        throw sdbusplus::exception::SdBusError(-rc, "sd_bus_call_async");
+    }
 
-    return interfaces;
+    return slot;
 }
 
 DbusPropertyMap getAllProperties(sdbusplus::bus_t& bus,
@@ -63,6 +79,44 @@ DbusPropertyMap getAllProperties(sdbusplus::bus_t& bus,
     return properties;
 }
 
+sd_bus_slot* getAllPropertiesAsync(sdbusplus::bus_t& bus,
+                                   const std::string& service,
+                                   const std::string& objPath,
+                                   const std::string& interface,
+                                   sd_bus_message_handler_t handler,
+                                   void* data)
+{
+    sd_bus_slot* slot = nullptr;
+
+    auto method = bus.new_method_call(service.c_str(), objPath.c_str(),
+                                      PROPERTY_IFACE, "GetAll");
+    method.append(interface);
+
+    auto rc = sd_bus_call_async(bus.get(), &slot, method.get(), handler, data,
+                                0);
+    if (rc < 0)
+    {
+        throw sdbusplus::exception::SdBusError(-rc, "sd_bus_call_async");
+    }
+
+    return slot;
+}
+
+std::string getNameOwner(sdbusplus::bus_t& bus, const std::string& name)
+{
+    std::string owner;
+
+    auto method = bus.new_method_call("org.freedesktop.DBus",
+                                      "/org/freedesktop/DBus",
+                                      "org.freedesktop.DBus", "GetNameOwner");
+    method.append(name);
+    auto reply = bus.call(method);
+
+    reply.read(owner);
+
+    return owner;
+}
+
 DbusSubtree getSubtree(sdbusplus::bus_t& bus, const std::string& root,
                        int depth, const std::string& interface)
 {
@@ -79,28 +133,5 @@ DbusSubtree getSubtree(sdbusplus::bus_t& bus, const std::string& root,
 
     return tree;
 }
-
-DbusService getService(const std::string& objPath, const std::string& interface,
-                       const DbusSubtree& tree)
-{
-    DbusService service;
-
-    auto services = tree.find(objPath);
-    if (services != tree.end())
-    {
-        auto s = std::find_if(services->second.begin(), services->second.end(),
-                              [&interface](const auto& entry) {
-            auto i = std::find(entry.second.begin(), entry.second.end(),
-                               interface);
-            return i != entry.second.end();
-        });
-        if (s != services->second.end())
-        {
-            service = s->first;
-        }
-    }
-
-    return service;
-}
 } // namespace logging
 } // namespace ibm
@@ -36,20 +36,55 @@ using DbusSubtree =
     std::map<DbusPath, std::map<DbusService, DbusInterfaceList>>;
 
 /**
- * Returns the managed objects for an object path and service
+ * Gets the managed objects for an object path and service, without
+ * reading them out of the reply.
  *
- * Returns an empty map if there are any failures.
+ * Throws an sdbusplus exception if the call fails.
  *
  * @param[in] bus - the D-Bus object
  * @param[in] service - the D-Bus service name
  * @param[in] objPath - the D-Bus object path
  *
- * @return ObjectValueTree - A map of object paths to their
- *                           interfaces and properties.
+ * @return message_t - the reply, holding an a{oa{sa{sv}}}
  */
-ObjectValueTree getManagedObjects(sdbusplus::bus_t& bus,
-                                  const std::string& service,
-                                  const std::string& objPath);
+sdbusplus::message_t getManagedObjectsReply(sdbusplus::bus_t& bus,
+                                            const std::string& service,
+                                            const std::string& objPath);
+
+/**
+ * Starts a call to get the managed objects for an object path and
+ * service, without waiting for the reply.
+ *
+ * The reply, or error, is passed to the handler from the event loop.
+ *
+ * Throws an sdbusplus exception if the call can't be sent.
+ *
+ * @param[in] bus - the D-Bus object
+ * @param[in] service - the D-Bus service name
+ * @param[in] objPath - the D-Bus object path
+ * @param[in] handler - the function to call with the reply
+ * @param[in] data - passed to the handler
+ *
+ * @return sd_bus_slot* - the call's slot.  Unreferencing it before
+ *                        the reply comes in cancels the call.
+ */
+sd_bus_slot* getManagedObjectsAsync(sdbusplus::bus_t& bus,
+                                    const std::string& service,
+                                    const std::string& objPath,
+                                    sd_bus_message_handler_t handler,
+                                    void* data);
+
+/**
+ * Returns the unique name of the owner of a bus name
+ *
+ * Throws an sdbusplus exception if the name has no owner.
+ *
+ * @param[in] bus - the D-Bus object
+ * @param[in] name - the D-Bus service name
+ *
+ * @return string - the unique name, like :1.42
+ */
+std::string getNameOwner(sdbusplus::bus_t& bus, const std::string& name);
 
 /**
  * Returns the subtree for a root, depth, and interface.
@@ -66,21 +101,6 @@ ObjectValueTree getManagedObjects(sdbusplus::bus_t& bus,
 DbusSubtree getSubtree(sdbusplus::bus_t& bus, const std::string& root,
                        int depth, const std::string& interface);
 
-/**
- * Get the D-Bus service name for the object path and interface from
- * the data returned from a GetSubTree call.
- *
- * Returns an empty string if the service can't be found.
- *
- * @param[in] objPath - the D-Bus object path
- * @param[in] interface - the D-Bus interface name
- * @param[in] tree - the D-Bus GetSubTree response
- *
- * @return string - the service name
- */
-DbusService getService(const std::string& objPath, const std::string& interface,
-                       const DbusSubtree& tree);
-
 /**
  * Returns all properties on a particular interface on a
  * particular D-Bus object.
@@ -98,5 +118,30 @@ DbusPropertyMap getAllProperties(sdbusplus::bus_t& bus,
                                  const std::string& service,
                                  const std::string& objPath,
                                  const std::string& interface);
+
+/**
+ * Starts a call to get all properties on an interface on a D-Bus
+ * object, without waiting for the reply.
+ *
+ * The reply, or error, is passed to the handler from the event loop.
+ *
+ * Throws an sdbusplus exception if the call can't be sent.
+ *
+ * @param[in] bus - the D-Bus object
+ * @param[in] service - the D-Bus service name
+ * @param[in] objPath - the D-Bus object path
+ * @param[in] interface - the D-Bus interface name
+ * @param[in] handler - the function to call with the reply
+ * @param[in] data - passed to the handler
+ *
+ * @return sd_bus_slot* - the call's slot.  Unreferencing it before
+ *                        the reply comes in cancels the call.
+ */
+sd_bus_slot* getAllPropertiesAsync(sdbusplus::bus_t& bus,
+                                   const std::string& service,
+                                   const std::string& objPath,
+                                   const std::string& interface,
+                                   sd_bus_message_handler_t handler,
+                                   void* data);
 } // namespace logging
 } // namespace ibm
@@ -0,0 +1,326 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+
+#include "entry_reader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * A property that is decoded, and the signature it must have
+ */
+struct WantedProperty
+{
+    std::string_view interface;
+    std::string_view name;
+    std::string_view signature;
+};
+
+static constexpr std::array<WantedProperty, 4> wantedProperties{
+    {{LOGGING_IFACE, "Message", "s"},
+     {LOGGING_IFACE, "AdditionalData", "as"},
+     {LOGGING_IFACE, "Timestamp", "t"},
+     {ASSOC_IFACE, "Associations", "a(sss)"}}};
+
+bool isEntryPath(std::string_view objPath)
+{
+    constexpr std::string_view prefix{LOGGING_PATH "/entry/"};
+
+    if (!objPath.starts_with(prefix) || (objPath.size() == prefix.size()))
+    {
+        return false;
+    }
+
+    objPath.remove_prefix(prefix.size());
+    return std::all_of(objPath.begin(), objPath.end(), [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c));
+    });
+}
+
+/**
+ * Reads a string array out of a message
+ *
+ * @param[in] msg - the message, at the array
+ * @param[out] value - the strings
+ *
+ * @return int - a negative errno on failure
+ */
+static int readStrings(sd_bus_message* msg, std::vector<std::string>& value)
+{
+    auto r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "s");
+    if (r < 0)
+    {
+        return r;
+    }
+
+    const char* item = nullptr;
+    while ((r = sd_bus_message_read_basic(msg, 's', &item)) > 0)
+    {
+        value.emplace_back(item);
+    }
+
+    return (r < 0) ? r : sd_bus_message_exit_container(msg);
+}
+
+/**
+ * Reads an associations array out of a message
+ *
+ * @param[in] msg - the message, at the array
+ * @param[out] value - the associations
+ *
+ * @return int - a negative errno on failure
+ */
+static int readAssociations(sd_bus_message* msg,
+                            AssociationsPropertyType& value)
+{
+    auto r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "(sss)");
+    if (r < 0)
+    {
+        return r;
+    }
+
+    while ((r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_STRUCT,
+                                               "sss")) > 0)
+    {
+        const char* forward = nullptr;
+        const char* reverse = nullptr;
+        const char* endpoint = nullptr;
+
+        if (((r = sd_bus_message_read_basic(msg, 's', &forward)) < 0) ||
+            ((r = sd_bus_message_read_basic(msg, 's', &reverse)) < 0) ||
+            ((r = sd_bus_message_read_basic(msg, 's', &endpoint)) < 0) ||
+            ((r = sd_bus_message_exit_container(msg)) < 0))
+        {
+            return r;
+        }
+
+        value.emplace_back(forward, reverse, endpoint);
+    }
+
+    return (r < 0) ? r : sd_bus_message_exit_container(msg);
+}
+
+/**
+ * Reads the contents of a property's variant
+ *
+ * @param[in] msg - the message, inside the variant
+ * @param[in] signature - the contents' signature
+ * @param[out] value - the value
+ *
+ * @return int - a negative errno on failure
+ */
+static int readValue(sd_bus_message* msg, std::string_view signature,
+                     Value& value)
+{
+    int r = 0;
+
+    if (signature == "s")
+    {
+        const char* s = nullptr;
+        r = sd_bus_message_read_basic(msg, 's', &s);
+        if (r >= 0)
+        {
+            value = std::string{s};
+        }
+    }
+    else if (signature == "t")
+    {
+        uint64_t t = 0;
+        r = sd_bus_message_read_basic(msg, 't', &t);
+        if (r >= 0)
+        {
+            value = t;
+        }
+    }
+    else if (signature == "as")
+    {
+        std::vector<std::string> strings;
+        r = readStrings(msg, strings);
+        if (r >= 0)
+        {
+            value = std::move(strings);
+        }
+    }
+    else
+    {
+        AssociationsPropertyType associations;
+        r = readAssociations(msg, associations);
+        if (r >= 0)
+        {
+            value = std::move(associations);
+        }
+    }
+
+    return r;
+}
+
+/**
+ * Reads the wanted properties of one interface
+ *
+ * @param[in] msg - the message, at the a{sv} array
+ * @param[in] interface - the interface name
+ * @param[out] properties - the properties read
+ *
+ * @return int - a negative errno on failure
+ */
+static int readProperties(sd_bus_message* msg, std::string_view interface,
+                          DbusPropertyMap& properties)
+{
+    auto r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "{sv}");
+    if (r < 0)
+    {
+        return r;
+    }
+
+    while ((r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_DICT_ENTRY,
+                                               "sv")) > 0)
+    {
+        const char* name = nullptr;
+        const char* contents = nullptr;
+
+        if (((r = sd_bus_message_read_basic(msg, 's', &name)) < 0) ||
+            ((r = sd_bus_message_peek_type(msg, nullptr, &contents)) < 0))
+        {
+            return r;
+        }
+
+        auto wanted = std::find_if(
+            wantedProperties.begin(), wantedProperties.end(),
+            [interface, name, contents](const auto& p) {
+            return (p.interface == interface) && (p.name == name) &&
+                   (p.signature == contents);
+        });
+
+        if (wanted == wantedProperties.end())
+        {
+            r = sd_bus_message_skip(msg, "v");
+        }
+        else
+        {
+            Value value;
+            if (((r = sd_bus_message_enter_container(
+                      msg, SD_BUS_TYPE_VARIANT, contents)) < 0) ||
+                ((r = readValue(msg, contents, value)) < 0) ||
+                ((r = sd_bus_message_exit_container(msg)) < 0))
+            {
+                return r;
+            }
+            properties.emplace(name, std::move(value));
+        }
+
+        if ((r < 0) || ((r = sd_bus_message_exit_container(msg)) < 0))
+        {
+            return r;
+        }
+    }
+
+    return (r < 0) ? r : sd_bus_message_exit_container(msg);
+}
+
+int readEntryInterfaces(sd_bus_message* msg, DbusInterfaceMap& interfaces)
+{
+    auto r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY,
+                                            "{sa{sv}}");
+    if (r < 0)
+    {
+        return r;
+    }
+
+    while ((r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_DICT_ENTRY,
+                                               "sa{sv}")) > 0)
+    {
+        const char* name = nullptr;
+        if ((r = sd_bus_message_read_basic(msg, 's', &name)) < 0)
+        {
+            return r;
+        }
+
+        std::string_view interface{name};
+        if ((interface == LOGGING_IFACE) || (interface == ASSOC_IFACE))
+        {
+            r = readProperties(msg, interface, interfaces[name]);
+        }
+        else
+        {
+            r = sd_bus_message_skip(msg, "a{sv}");
+        }
+
+        if ((r < 0) || ((r = sd_bus_message_exit_container(msg)) < 0))
+        {
+            return r;
+        }
+    }
+
+    return (r < 0) ? r : sd_bus_message_exit_container(msg);
+}
+
+int readEntries(sd_bus_message* msg, const EntryCallback& callback,
+                const EntryFilter& filter)
+{
+    auto r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY,
+                                            "{oa{sa{sv}}}");
+    if (r < 0)
+    {
+        return r;
+    }
+
+    DbusInterfaceMap interfaces;
+
+    while ((r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_DICT_ENTRY,
+                                               "oa{sa{sv}}")) > 0)
+    {
+        const char* path = nullptr;
+        if ((r = sd_bus_message_read_basic(msg, 'o', &path)) < 0)
+        {
+            return r;
+        }
+
+        if (isEntryPath(path) && (!filter || filter(path)))
+        {
+            interfaces.clear();
+            if ((r = readEntryInterfaces(msg, interfaces)) < 0)
+            {
+                return r;
+            }
+
+            if (interfaces.find(LOGGING_IFACE) != interfaces.end())
+            {
+                callback(path, interfaces);
+            }
+        }
+        else if ((r = sd_bus_message_skip(msg, "a{sa{sv}}")) < 0)
+        {
+            return r;
+        }
+
+        if ((r = sd_bus_message_exit_container(msg)) < 0)
+        {
+            return r;
+        }
+    }
+
+    return (r < 0) ? r : sd_bus_message_exit_container(msg);
+}
+
+} // namespace logging
+} // namespace ibm
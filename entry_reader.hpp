@@ -0,0 +1,82 @@
+#pragma once
+
+#include "dbus.hpp"
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * Says if an object path is a phosphor-logging entry, like
+ * /xyz/openbmc_project/logging/entry/5, and not something
+ * under one, like its callouts.
+ *
+ * @param[in] objPath - the D-Bus object path
+ *
+ * @return bool
+ */
+bool isEntryPath(std::string_view objPath);
+
+/**
+ * Reads the interfaces and properties of one object from a message
+ * positioned at its a{sa{sv}} array, as found in InterfacesAdded
+ * signals and GetManagedObjects replies.
+ *
+ * Only the properties the daemon uses are decoded:
+ *  - Message, AdditionalData, and Timestamp on the Logging.Entry
+ *    interface
+ *  - Associations on the Association.Definitions interface
+ * Everything else is skipped over without being decoded, so the
+ * other properties and interfaces on an entry cost nothing.
+ *
+ * @param[in] msg - the message
+ * @param[out] interfaces - the interfaces read
+ *
+ * @return int - a negative errno on failure
+ */
+int readEntryInterfaces(sd_bus_message* msg, DbusInterfaceMap& interfaces);
+
+/**
+ * The function passed each entry by readEntries()
+ *
+ * @param[in] objectPath - the entry's object path
+ * @param[in] interfaces - its interfaces, as read by
+ *                         readEntryInterfaces()
+ */
+using EntryCallback = std::function<void(const std::string& objectPath,
+                                         const DbusInterfaceMap& interfaces)>;
+
+/**
+ * The function readEntries() asks if it should read an entry
+ *
+ * @param[in] objectPath - the entry's object path
+ *
+ * @return bool - true to read it and pass it to the callback
+ */
+using EntryFilter = std::function<bool(std::string_view objectPath)>;
+
+/**
+ * Walks the objects in a GetManagedObjects reply one at a time,
+ * passing each log entry to the callback as soon as it is read and
+ * then discarding it, so only one entry is ever decoded at once.
+ *
+ * Objects that aren't entries, and entries the filter turns down,
+ * are skipped without being decoded.
+ *
+ * @param[in] msg - the message, at its a{oa{sa{sv}}} array
+ * @param[in] callback - the function to pass each entry to
+ * @param[in] filter - the function that picks the entries to read,
+ *                     or nullptr to read all of them
+ *
+ * @return int - a negative errno on failure
+ */
+int readEntries(sd_bus_message* msg, const EntryCallback& callback,
+                const EntryFilter& filter = nullptr);
+
+} // namespace logging
+} // namespace ibm
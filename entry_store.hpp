@@ -0,0 +1,381 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * @class InlineVector
+ *
+ * A vector that holds its first N elements inside itself, and only
+ * allocates for the ones after that.  Elements can only be added
+ * at the end.
+ */
+template <typename T, size_t N>
+class InlineVector
+{
+  public:
+    InlineVector() = default;
+    ~InlineVector() = default;
+    InlineVector(const InlineVector&) = default;
+    InlineVector& operator=(const InlineVector&) = default;
+    InlineVector(InlineVector&&) = default;
+    InlineVector& operator=(InlineVector&&) = default;
+
+    /**
+     * Adds an element to the end
+     *
+     * @param[in] value - the element
+     */
+    void push_back(T value)
+    {
+        if (count < N)
+        {
+            inlined[count] = std::move(value);
+        }
+        else
+        {
+            overflow.push_back(std::move(value));
+        }
+        count++;
+    }
+
+    /**
+     * Returns an element
+     *
+     * @param[in] index - the element's position
+     *
+     * @return T&
+     */
+    T& operator[](size_t index)
+    {
+        return (index < N) ? inlined[index] : overflow[index - N];
+    }
+
+    /**
+     * Returns an element
+     *
+     * @param[in] index - the element's position
+     *
+     * @return const T&
+     */
+    const T& operator[](size_t index) const
+    {
+        return (index < N) ? inlined[index] : overflow[index - N];
+    }
+
+    /**
+     * Removes all elements, in reverse order
+     */
+    void clear()
+    {
+        overflow.clear();
+        for (size_t i = std::min(count, N); i > 0; i--)
+        {
+            inlined[i - 1] = T{};
+        }
+        count = 0;
+    }
+
+    /**
+     * The number of elements
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * If there aren't any elements
+     *
+     * @return bool
+     */
+    inline bool empty() const
+    {
+        return count == 0;
+    }
+
+  private:
+    std::array<T, N> inlined{};
+    std::vector<T> overflow;
+    size_t count = 0;
+};
+
+/**
+ * @class EntryStore
+ *
+ * Holds a record for each error log, indexed on the log's ID.
+ *
+ * phosphor-logging hands out IDs in increasing order and the logs
+ * are usually deleted oldest first, so the records are kept in a
+ * deque of slots covering the range of IDs in use.  Looking up,
+ * adding, and removing a record are all O(1).  A deleted log in
+ * the middle of the range leaves behind an empty slot until the
+ * logs on one side of it are gone too.
+ *
+ * The range is kept from getting much larger than the number of
+ * records, such as when one old log outlives thousands of newer
+ * ones, by moving the oldest records into a sparse map until it
+ * isn't.  So a reference to a record is only good until the next
+ * insert().
+ *
+ * @tparam Record - the record type, which must be default
+ *                  constructible and move assignable.
+ */
+template <typename Record>
+class EntryStore
+{
+  public:
+    using ID = uint32_t;
+
+    EntryStore() = default;
+    ~EntryStore() = default;
+    EntryStore(const EntryStore&) = delete;
+    EntryStore& operator=(const EntryStore&) = delete;
+    EntryStore(EntryStore&&) = default;
+    EntryStore& operator=(EntryStore&&) = default;
+
+    /**
+     * Returns the record for an ID, adding an empty one
+     * if there isn't one yet.
+     *
+     * @param[in] id - the error log ID
+     *
+     * @return Record& - the record
+     */
+    Record& insert(ID id)
+    {
+        if (auto record = find(id); record)
+        {
+            return *record;
+        }
+
+        if (slots.empty())
+        {
+            first = id;
+            slots.emplace_back();
+        }
+        else if (id < first)
+        {
+            // Restored logs don't come in numerical order
+            if (tooSparse(first + slots.size() - id, slotted + 1))
+            {
+                count++;
+                return sparse[id];
+            }
+
+            for (; first > id; first--)
+            {
+                slots.emplace_front();
+            }
+        }
+        else if (id - first >= slots.size())
+        {
+            // Make room by moving the oldest records out of the way
+            while (!slots.empty() &&
+                   tooSparse(static_cast<size_t>(id - first) + 1, slotted + 1))
+            {
+                evictFront();
+            }
+
+            if (slots.empty())
+            {
+                first = id;
+            }
+            slots.resize(static_cast<size_t>(id - first) + 1);
+        }
+
+        auto& slot = slots[id - first];
+        slot.used = true;
+        slotted++;
+        count++;
+        return slot.record;
+    }
+
+    /**
+     * Returns the record for an ID
+     *
+     * @param[in] id - the error log ID
+     *
+     * @return Record* - the record, or nullptr if there isn't one
+     */
+    Record* find(ID id)
+    {
+        if ((id >= first) && (id - first < slots.size()) &&
+            slots[id - first].used)
+        {
+            return &slots[id - first].record;
+        }
+
+        if (sparse.empty())
+        {
+            return nullptr;
+        }
+
+        auto record = sparse.find(id);
+        return (record != sparse.end()) ? &record->second : nullptr;
+    }
+
+    /**
+     * Removes the record for an ID
+     *
+     * @param[in] id - the error log ID
+     *
+     * @return bool - if there was a record
+     */
+    bool erase(ID id)
+    {
+        if ((id < first) || (id - first >= slots.size()) ||
+            !slots[id - first].used)
+        {
+            if (sparse.erase(id) == 0)
+            {
+                return false;
+            }
+            count--;
+            return true;
+        }
+
+        slots[id - first].record = Record{};
+        slots[id - first].used = false;
+        slotted--;
+        count--;
+
+        while (!slots.empty() && !slots.front().used)
+        {
+            slots.pop_front();
+            first++;
+        }
+
+        while (!slots.empty() && !slots.back().used)
+        {
+            slots.pop_back();
+        }
+
+        return true;
+    }
+
+    /**
+     * The number of records
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return count;
+    }
+
+    /**
+     * The number of slots, including the empty ones
+     * between records.
+     *
+     * @return size_t
+     */
+    inline size_t slotCount() const
+    {
+        return slots.size();
+    }
+
+    /**
+     * The number of records moved out of the slots
+     *
+     * @return size_t
+     */
+    inline size_t sparseCount() const
+    {
+        return sparse.size();
+    }
+
+    /**
+     * The range of IDs the slots can cover without being checked
+     */
+    static constexpr size_t minSpan = 256;
+
+    /**
+     * The most slots per record in a larger range
+     */
+    static constexpr size_t maxSlotsPerRecord = 4;
+
+  private:
+    /**
+     * Says if a range of slots would be too empty
+     *
+     * @param[in] span - the number of slots
+     * @param[in] used - the number of them with records
+     *
+     * @return bool
+     */
+    static inline bool tooSparse(size_t span, size_t used)
+    {
+        return (span > minSpan) && (span > maxSlotsPerRecord * used);
+    }
+
+    /**
+     * Moves the first slot's record, if it has one, to the sparse
+     * map, and removes it and any empty slots after it.
+     */
+    void evictFront()
+    {
+        if (slots.front().used)
+        {
+            sparse.emplace(first, std::move(slots.front().record));
+            slotted--;
+        }
+
+        do
+        {
+            slots.pop_front();
+            first++;
+        } while (!slots.empty() && !slots.front().used);
+    }
+
+    /**
+     * The record for one ID
+     */
+    struct Slot
+    {
+        bool used = false;
+        Record record;
+    };
+
+    /**
+     * The slots, for IDs first through first + slots.size() - 1
+     */
+    std::deque<Slot> slots;
+
+    /**
+     * The ID of the first slot
+     */
+    ID first = 0;
+
+    /**
+     * The records that are too far from the others to be in
+     * the slots
+     */
+    std::map<ID, Record> sparse;
+
+    /**
+     * The number of used slots
+     */
+    size_t slotted = 0;
+
+    /**
+     * The number of records
+     */
+    size_t count = 0;
+};
+
+} // namespace logging
+} // namespace ibm
@@ -21,11 +21,5 @@ using CalloutObject = ServerObject<CalloutInterface, ObjectPathInterface>;
 
 using PolicyInterface = sdbusplus::com::ibm::Logging::server::Policy;
 using PolicyObject = ServerObject<PolicyInterface>;
-
-enum class InterfaceType
-{
-    CALLOUT,
-    POLICY
-};
 } // namespace logging
 } // namespace ibm
@@ -0,0 +1,667 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+
+#include "inventory_cache.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <string_view>
+
+namespace ibm
+{
+namespace logging
+{
+
+using namespace phosphor::logging;
+namespace rules = sdbusplus::bus::match::rules;
+
+void ServiceMap::fill(const DbusSubtree& tree, const std::string& interface)
+{
+    services.clear();
+    pathCounts.clear();
+
+    for (const auto& [objPath, objServices] : tree)
+    {
+        auto s = std::find_if(objServices.begin(), objServices.end(),
+                              [&interface](const auto& entry) {
+            return std::find(entry.second.begin(), entry.second.end(),
+                             interface) != entry.second.end();
+        });
+        if (s != objServices.end())
+        {
+            add(objPath, s->first);
+        }
+    }
+}
+
+void ServiceMap::add(const DbusPath& objPath, const DbusService& service)
+{
+    auto [entry, added] = services.try_emplace(objPath, service);
+    if (!added)
+    {
+        if (entry->second == service)
+        {
+            return;
+        }
+
+        auto count = pathCounts.find(entry->second);
+        if (--count->second == 0)
+        {
+            pathCounts.erase(count);
+        }
+        entry->second = service;
+    }
+
+    pathCounts[service]++;
+}
+
+void ServiceMap::add(const ObjectValueTree& objects, const DbusService& service)
+{
+    for (const auto& object : objects)
+    {
+        add(object.first, service);
+    }
+}
+
+bool ServiceMap::remove(const DbusPath& objPath)
+{
+    auto entry = services.find(objPath);
+    if (entry == services.end())
+    {
+        return false;
+    }
+
+    auto count = pathCounts.find(entry->second);
+    if (--count->second == 0)
+    {
+        pathCounts.erase(count);
+    }
+    services.erase(entry);
+
+    return true;
+}
+
+size_t ServiceMap::removeService(const DbusService& service)
+{
+    auto count = pathCounts.find(service);
+    if (count == pathCounts.end())
+    {
+        return 0;
+    }
+
+    auto removed = std::erase_if(services, [&service](const auto& entry) {
+        return entry.second == service;
+    });
+    pathCounts.erase(count);
+
+    return removed;
+}
+
+const DbusService* ServiceMap::find(const DbusPath& objPath) const
+{
+    auto entry = services.find(objPath);
+    if (entry == services.end())
+    {
+        return nullptr;
+    }
+    return &entry->second;
+}
+
+std::vector<DbusService> ServiceMap::serviceNames() const
+{
+    std::vector<DbusService> names;
+    names.reserve(pathCounts.size());
+
+    for (const auto& count : pathCounts)
+    {
+        names.push_back(count.first);
+    }
+
+    return names;
+}
+
+const AssetCache::Entry* AssetCache::find(const DbusPath& objPath)
+{
+    auto entry = entries.find(objPath);
+    if (entry == entries.end())
+    {
+        missCount++;
+        return nullptr;
+    }
+
+    hitCount++;
+    return &entry->second;
+}
+
+const AssetCache::Entry& AssetCache::insert(const DbusPath& objPath,
+                                            Entry entry)
+{
+    auto [slot, added] = entries.insert_or_assign(objPath, std::move(entry));
+    return slot->second;
+}
+
+size_t AssetCache::insert(const ObjectValueTree& objects,
+                          const std::string& interface)
+{
+    size_t count = 0;
+
+    for (const auto& [objPath, interfaces] : objects)
+    {
+        auto properties = interfaces.find(interface);
+        if (properties != interfaces.end())
+        {
+            insert(objPath, properties->second);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+bool AssetCache::erase(const DbusPath& objPath)
+{
+    return entries.erase(objPath) != 0;
+}
+
+void AssetCache::clear()
+{
+    entries.clear();
+}
+
+/**
+ * Finds the path of an object in an InterfacesAdded signal if
+ * one of the interfaces added is the one passed in.
+ *
+ * Only the interface names are read, with the properties skipped
+ * over, as they aren't needed and inventory objects can have
+ * property types that the Value variant doesn't cover.
+ *
+ * @param[in] msg - the InterfacesAdded signal
+ * @param[in] interface - the D-Bus interface name
+ * @param[out] objPath - the object path, if found
+ *
+ * @return bool - if the interface was added
+ */
+static bool findAddedInterface(sdbusplus::message_t& msg,
+                               const std::string& interface, DbusPath& objPath)
+{
+    auto m = msg.get();
+    const char* path = nullptr;
+
+    if ((sd_bus_message_read_basic(m, 'o', &path) < 0) ||
+        (sd_bus_message_enter_container(m, SD_BUS_TYPE_ARRAY, "{sa{sv}}") <
+         0))
+    {
+        return false;
+    }
+
+    while (sd_bus_message_enter_container(m, SD_BUS_TYPE_DICT_ENTRY,
+                                          "sa{sv}") > 0)
+    {
+        const char* name = nullptr;
+        if (sd_bus_message_read_basic(m, 's', &name) < 0)
+        {
+            return false;
+        }
+
+        if (interface == name)
+        {
+            objPath = path;
+            return true;
+        }
+
+        if ((sd_bus_message_skip(m, "a{sv}") < 0) ||
+            (sd_bus_message_exit_container(m) < 0))
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+int readInterface(sd_bus_message* msg, const std::string& interface,
+                  ObjectValueTree& objects)
+{
+    auto r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY,
+                                            "{oa{sa{sv}}}");
+
+    while ((r >= 0) && ((r = sd_bus_message_enter_container(
+                             msg, SD_BUS_TYPE_DICT_ENTRY, "oa{sa{sv}}")) > 0))
+    {
+        const char* path = nullptr;
+        if (((r = sd_bus_message_read_basic(msg, 'o', &path)) < 0) ||
+            ((r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY,
+                                                 "{sa{sv}}")) < 0))
+        {
+            break;
+        }
+
+        while ((r = sd_bus_message_enter_container(
+                    msg, SD_BUS_TYPE_DICT_ENTRY, "sa{sv}")) > 0)
+        {
+            const char* name = nullptr;
+            if ((r = sd_bus_message_read_basic(msg, 's', &name)) < 0)
+            {
+                break;
+            }
+
+            if (interface != name)
+            {
+                r = sd_bus_message_skip(msg, "a{sv}");
+            }
+            else
+            {
+                auto& properties =
+                    objects[sdbusplus::message::object_path{std::string{path}}]
+                           [name];
+
+                r = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY,
+                                                   "{sv}");
+                while ((r >= 0) &&
+                       ((r = sd_bus_message_enter_container(
+                             msg, SD_BUS_TYPE_DICT_ENTRY, "sv")) > 0))
+                {
+                    const char* property = nullptr;
+                    const char* contents = nullptr;
+                    if (((r = sd_bus_message_read_basic(msg, 's', &property)) <
+                         0) ||
+                        ((r = sd_bus_message_peek_type(msg, nullptr,
+                                                       &contents)) < 0))
+                    {
+                        break;
+                    }
+
+                    if (std::string_view{contents} == "s")
+                    {
+                        const char* value = nullptr;
+                        if (((r = sd_bus_message_enter_container(
+                                  msg, SD_BUS_TYPE_VARIANT, "s")) < 0) ||
+                            ((r = sd_bus_message_read_basic(msg, 's',
+                                                            &value)) < 0) ||
+                            ((r = sd_bus_message_exit_container(msg)) < 0))
+                        {
+                            break;
+                        }
+                        properties.emplace(property, std::string{value});
+                    }
+                    else
+                    {
+                        r = sd_bus_message_skip(msg, "v");
+                    }
+
+                    if ((r < 0) ||
+                        ((r = sd_bus_message_exit_container(msg)) < 0))
+                    {
+                        break;
+                    }
+                }
+
+                if (r >= 0)
+                {
+                    r = sd_bus_message_exit_container(msg);
+                }
+            }
+
+            if ((r < 0) || ((r = sd_bus_message_exit_container(msg)) < 0))
+            {
+                break;
+            }
+        }
+
+        if ((r < 0) || ((r = sd_bus_message_exit_container(msg)) < 0) ||
+            ((r = sd_bus_message_exit_container(msg)) < 0))
+        {
+            break;
+        }
+    }
+
+    if (r >= 0)
+    {
+        r = sd_bus_message_exit_container(msg);
+    }
+
+    return r;
+}
+
+InventoryCache::InventoryCache(sdbusplus::bus_t& bus, bool warm) :
+    bus(bus), warmEnabled(warm),
+    addMatch(bus,
+             rules::interfacesAdded() + rules::path_namespace(INVENTORY_PATH),
+             std::bind(std::mem_fn(&InventoryCache::interfacesAdded), this,
+                       std::placeholders::_1)),
+    removeMatch(bus,
+                rules::interfacesRemoved() +
+                    rules::path_namespace(INVENTORY_PATH),
+                std::bind(std::mem_fn(&InventoryCache::interfacesRemoved),
+                          this, std::placeholders::_1)),
+    propertiesMatch(
+        bus, rules::propertiesChangedNamespace(INVENTORY_PATH, ASSET_IFACE),
+        std::bind(std::mem_fn(&InventoryCache::propertiesChanged), this,
+                  std::placeholders::_1))
+{
+    watchOwners();
+
+    if (warmEnabled)
+    {
+        this->warm();
+    }
+}
+
+DbusService InventoryCache::getService(const std::string& inventoryPath)
+{
+    if (stale)
+    {
+        load();
+    }
+
+    auto service = services.find(inventoryPath);
+    return service ? *service : DbusService{};
+}
+
+void InventoryCache::getAssetProperties(const std::string& inventoryPath,
+                                        AssetCallback callback)
+{
+    auto entry = assetCache.find(inventoryPath);
+    if (entry)
+    {
+        callback(*entry ? &**entry : nullptr);
+        return;
+    }
+
+    auto request = requests.find(inventoryPath);
+    if (request != requests.end())
+    {
+        request->second->callbacks.push_back(std::move(callback));
+        return;
+    }
+
+    auto service = getService(inventoryPath);
+    if (service.empty())
+    {
+        // Don't remember a miss if the mapper couldn't be read
+        if (!stale)
+        {
+            assetCache.insert(inventoryPath, std::nullopt);
+        }
+        callback(nullptr);
+        return;
+    }
+
+    auto newRequest = std::make_unique<Request>();
+    newRequest->cache = this;
+    newRequest->path = inventoryPath;
+    newRequest->callbacks.push_back(std::move(callback));
+
+    newRequest->slot.reset(getAllPropertiesAsync(bus, service, inventoryPath,
+                                                 ASSET_IFACE, handleReply,
+                                                 newRequest.get()));
+
+    requests.emplace(inventoryPath, std::move(newRequest));
+}
+
+int InventoryCache::handleReply(sd_bus_message* msg, void* data,
+                                sd_bus_error* /*error*/)
+{
+    auto request = static_cast<Request*>(data);
+    sdbusplus::message_t reply{msg};
+
+    request->cache->complete(*request, reply);
+
+    return 0;
+}
+
+void InventoryCache::complete(Request& request, sdbusplus::message_t& reply)
+{
+    // Take the request out first, as the callbacks may make new ones
+    auto node = requests.extract(request.path);
+    auto callbacks = std::move(request.callbacks);
+
+    AssetCache::Entry properties;
+
+    if (reply.is_method_error())
+    {
+        auto error = sd_bus_message_get_error(reply.get());
+        log<level::ERR>("Failed getting the Asset properties",
+                        entry("PATH=%s", request.path.c_str()),
+                        entry("ERROR=%s", error ? error->name : ""));
+    }
+    else
+    {
+        try
+        {
+            DbusPropertyMap values;
+            reply.read(values);
+            properties = std::move(values);
+        }
+        catch (const sdbusplus::exception_t& e)
+        {
+            log<level::ERR>("Failed reading the Asset properties",
+                            entry("PATH=%s", request.path.c_str()),
+                            entry("ERROR=%s", e.what()));
+        }
+    }
+
+    const AssetCache::Entry* entry = &properties;
+    if (properties && !request.invalidated)
+    {
+        entry = &assetCache.insert(request.path, std::move(properties));
+    }
+
+    for (auto& callback : callbacks)
+    {
+        callback(*entry ? &**entry : nullptr);
+    }
+}
+
+void InventoryCache::warm()
+{
+    warmInvalidated.clear();
+
+    try
+    {
+        warmSlot.reset(getManagedObjectsAsync(bus, INVENTORY_BUSNAME,
+                                              INVENTORY_PATH, handleWarmReply,
+                                              this));
+    }
+    catch (const sdbusplus::exception_t& e)
+    {
+        warmSlot.reset();
+        log<level::ERR>("Failed getting the inventory objects",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+int InventoryCache::handleWarmReply(sd_bus_message* msg, void* data,
+                                    sd_bus_error* /*error*/)
+{
+    auto cache = static_cast<InventoryCache*>(data);
+    auto slot = std::move(cache->warmSlot);
+
+    if (sd_bus_message_is_method_error(msg, nullptr))
+    {
+        auto error = sd_bus_message_get_error(msg);
+        log<level::ERR>("Failed getting the inventory objects",
+                        entry("ERROR=%s", error ? error->name : ""));
+        return 0;
+    }
+
+    ObjectValueTree objects;
+    auto r = readInterface(msg, ASSET_IFACE, objects);
+    if (r < 0)
+    {
+        log<level::ERR>("Failed reading the inventory objects",
+                        entry("RC=%d", r));
+        return 0;
+    }
+
+    // Properties that changed after the call was made may be stale
+    for (const auto& objPath : cache->warmInvalidated)
+    {
+        objects.erase(objPath);
+    }
+    cache->warmInvalidated.clear();
+
+    cache->services.add(objects, INVENTORY_BUSNAME);
+    cache->watchOwners();
+    auto count = cache->assetCache.insert(objects, ASSET_IFACE);
+
+    log<level::INFO>("Read the Asset properties of the inventory",
+                     entry("OBJECTS=%zu", count));
+
+    return 0;
+}
+
+void InventoryCache::invalidate(const DbusPath& objPath)
+{
+    assetCache.erase(objPath);
+
+    if (warmSlot)
+    {
+        warmInvalidated.insert(objPath);
+    }
+
+    auto request = requests.find(objPath);
+    if (request != requests.end())
+    {
+        request->second->invalidated = true;
+    }
+}
+
+void InventoryCache::load()
+{
+    try
+    {
+        services.fill(getSubtree(bus, INVENTORY_PATH, 0, ASSET_IFACE),
+                      ASSET_IFACE);
+        stale = false;
+        watchOwners();
+    }
+    catch (const sdbusplus::exception_t& e)
+    {
+        log<level::ERR>("Failed getting the inventory subtree",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+void InventoryCache::interfacesAdded(sdbusplus::message_t& msg)
+{
+    DbusPath path;
+
+    if (findAddedInterface(msg, ASSET_IFACE, path))
+    {
+        services.add(path, msg.get_sender());
+        invalidate(path);
+        watchOwners();
+    }
+}
+
+void InventoryCache::interfacesRemoved(sdbusplus::message_t& msg)
+{
+    sdbusplus::message::object_path path;
+    DbusInterfaceList interfaces;
+
+    msg.read(path, interfaces);
+
+    auto i = std::find(interfaces.begin(), interfaces.end(), ASSET_IFACE);
+    if (i != interfaces.end())
+    {
+        services.remove(path);
+        invalidate(path);
+        watchOwners();
+    }
+}
+
+void InventoryCache::nameOwnerChanged(sdbusplus::message_t& msg)
+{
+    std::string name;
+    std::string oldOwner;
+    std::string newOwner;
+
+    msg.read(name, oldOwner, newOwner);
+
+    if (!oldOwner.empty())
+    {
+        // The paths may be under either the well known name
+        // from the mapper or the unique name from a signal.
+        auto removed = services.removeService(name);
+        if (name != oldOwner)
+        {
+            removed += services.removeService(oldOwner);
+        }
+
+        if (removed)
+        {
+            stale = true;
+            assetCache.clear();
+
+            for (auto& request : requests)
+            {
+                request.second->invalidated = true;
+            }
+        }
+    }
+
+    // The inventory manager started or restarted
+    if (warmEnabled && (name == INVENTORY_BUSNAME) && !newOwner.empty())
+    {
+        warm();
+    }
+}
+
+void InventoryCache::watchOwners()
+{
+    auto watched = [this](const DbusService& service) {
+        return services.hosts(service) ||
+               (warmEnabled && (service == INVENTORY_BUSNAME));
+    };
+
+    std::erase_if(ownerMatches, [&watched](const auto& match) {
+        return !watched(match.first);
+    });
+
+    auto names = services.serviceNames();
+    if (warmEnabled)
+    {
+        names.push_back(INVENTORY_BUSNAME);
+    }
+
+    for (const auto& name : names)
+    {
+        if (ownerMatches.find(name) == ownerMatches.end())
+        {
+            ownerMatches.emplace(
+                name,
+                std::make_unique<sdbusplus::bus::match_t>(
+                    bus, rules::nameOwnerChanged(name),
+                    std::bind(std::mem_fn(&InventoryCache::nameOwnerChanged),
+                              this, std::placeholders::_1)));
+        }
+    }
+}
+
+void InventoryCache::propertiesChanged(sdbusplus::message_t& msg)
+{
+    // The match only lets through the Asset interface, so there's
+    // no need to read the message.
+    invalidate(msg.get_path());
+}
+
+} // namespace logging
+} // namespace ibm
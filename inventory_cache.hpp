@@ -0,0 +1,511 @@
+#pragma once
+
+#include "dbus.hpp"
+
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/bus/match.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * @class ServiceMap
+ *
+ * A hash map of the D-Bus service hosting an interface on each
+ * object path, that also counts the paths each service hosts so
+ * the ones for a service that went away can be found quickly.
+ */
+class ServiceMap
+{
+  public:
+    ServiceMap() = default;
+    ~ServiceMap() = default;
+    ServiceMap(const ServiceMap&) = default;
+    ServiceMap& operator=(const ServiceMap&) = default;
+    ServiceMap(ServiceMap&&) = default;
+    ServiceMap& operator=(ServiceMap&&) = default;
+
+    /**
+     * Replaces the contents with the paths that have the
+     * interface in the data returned from a GetSubTree call.
+     *
+     * @param[in] tree - the D-Bus GetSubTree response
+     * @param[in] interface - the D-Bus interface name
+     */
+    void fill(const DbusSubtree& tree, const std::string& interface);
+
+    /**
+     * Sets the service for a path
+     *
+     * @param[in] objPath - the D-Bus object path
+     * @param[in] service - the D-Bus service name
+     */
+    void add(const DbusPath& objPath, const DbusService& service);
+
+    /**
+     * Sets the service for every path in the data returned
+     * from a service's GetManagedObjects call.
+     *
+     * @param[in] objects - the D-Bus GetManagedObjects response
+     * @param[in] service - the D-Bus service name
+     */
+    void add(const ObjectValueTree& objects, const DbusService& service);
+
+    /**
+     * Removes a path
+     *
+     * @param[in] objPath - the D-Bus object path
+     *
+     * @return bool - if the path was there
+     */
+    bool remove(const DbusPath& objPath);
+
+    /**
+     * Removes all paths hosted by a service
+     *
+     * @param[in] service - the D-Bus service name
+     *
+     * @return size_t - the number of paths removed
+     */
+    size_t removeService(const DbusService& service);
+
+    /**
+     * Returns the service for a path
+     *
+     * @param[in] objPath - the D-Bus object path
+     *
+     * @return const DbusService* - the service, or nullptr
+     *                              if the path isn't there.
+     */
+    const DbusService* find(const DbusPath& objPath) const;
+
+    /**
+     * Says if a service hosts any of the paths
+     *
+     * @param[in] service - the D-Bus service name
+     *
+     * @return bool
+     */
+    inline bool hosts(const DbusService& service) const
+    {
+        return pathCounts.find(service) != pathCounts.end();
+    }
+
+    /**
+     * Returns the services hosting the paths
+     *
+     * @return vector<DbusService>
+     */
+    std::vector<DbusService> serviceNames() const;
+
+    /**
+     * The number of paths
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return services.size();
+    }
+
+  private:
+    /**
+     * The service for each path
+     */
+    std::unordered_map<DbusPath, DbusService> services;
+
+    /**
+     * The number of paths each service hosts
+     */
+    std::unordered_map<DbusService, size_t> pathCounts;
+};
+
+/**
+ * @class AssetCache
+ *
+ * The Asset properties of inventory objects, keyed on their paths.
+ * A path with no Asset service is cached too, so it isn't looked up
+ * again for every log that calls it out.
+ */
+class AssetCache
+{
+  public:
+    /**
+     * An entry's properties, or nullopt if the path doesn't
+     * have an Asset interface.
+     */
+    using Entry = std::optional<DbusPropertyMap>;
+
+    AssetCache() = default;
+    ~AssetCache() = default;
+    AssetCache(const AssetCache&) = default;
+    AssetCache& operator=(const AssetCache&) = default;
+    AssetCache(AssetCache&&) = default;
+    AssetCache& operator=(AssetCache&&) = default;
+
+    /**
+     * Finds the entry for a path, counting it as a hit or a miss.
+     *
+     * @param[in] objPath - the inventory object path
+     *
+     * @return const Entry* - the entry, or nullptr if the
+     *                        path isn't cached.
+     */
+    const Entry* find(const DbusPath& objPath);
+
+    /**
+     * Sets the entry for a path
+     *
+     * @param[in] objPath - the inventory object path
+     * @param[in] entry - the properties, or nullopt if there
+     *                    is no Asset interface.
+     *
+     * @return const Entry& - the cached entry
+     */
+    const Entry& insert(const DbusPath& objPath, Entry entry);
+
+    /**
+     * Adds the properties of every object that has the interface
+     * in the data returned from a GetManagedObjects call.
+     *
+     * @param[in] objects - the D-Bus GetManagedObjects response
+     * @param[in] interface - the D-Bus interface name
+     *
+     * @return size_t - the number of objects added
+     */
+    size_t insert(const ObjectValueTree& objects, const std::string& interface);
+
+    /**
+     * Removes the entry for a path
+     *
+     * @param[in] objPath - the inventory object path
+     *
+     * @return bool - if the path was cached
+     */
+    bool erase(const DbusPath& objPath);
+
+    /**
+     * Removes all entries
+     */
+    void clear();
+
+    /**
+     * The number of lookups found in the cache, including
+     * the ones for paths without an Asset interface.
+     *
+     * @return uint64_t
+     */
+    inline uint64_t hits() const
+    {
+        return hitCount;
+    }
+
+    /**
+     * The number of lookups that weren't in the cache
+     *
+     * @return uint64_t
+     */
+    inline uint64_t misses() const
+    {
+        return missCount;
+    }
+
+    /**
+     * The number of entries in the cache
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return entries.size();
+    }
+
+  private:
+    /**
+     * The entries
+     */
+    std::unordered_map<DbusPath, Entry> entries;
+
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+/**
+ * Reads the objects in a GetManagedObjects reply, keeping only the
+ * string properties of one interface, and only the objects that
+ * have it.
+ *
+ * The rest of the reply is skipped over without being decoded, as
+ * inventory objects can have property types that the Value variant
+ * doesn't cover, and aren't needed anyway.
+ *
+ * @param[in] msg - the message, at its a{oa{sa{sv}}} array
+ * @param[in] interface - the D-Bus interface name
+ * @param[out] objects - the objects with the interface
+ *
+ * @return int - a negative errno on failure
+ */
+int readInterface(sd_bus_message* msg, const std::string& interface,
+                  ObjectValueTree& objects);
+
+/**
+ * @class InventoryCache
+ *
+ * Keeps track of which service hosts the Asset interface on each
+ * inventory object, so that finding the service for a callout
+ * doesn't need a call to the mapper.
+ *
+ * The paths are read from the mapper the first time they're needed,
+ * and then kept up to date from the InterfacesAdded and
+ * InterfacesRemoved signals under the inventory path.  If a service
+ * with inventory objects goes away they are all dropped, and the
+ * mapper is asked again on the next lookup, as the service's objects
+ * may come back without signals.
+ *
+ * The Asset properties are cached as well, and an object's are
+ * dropped when a PropertiesChanged signal for its Asset interface
+ * comes in.
+ *
+ * Optionally, the cache can be warmed with the Asset properties of
+ * every object in the inventory manager, read with one call at
+ * startup and again whenever the inventory manager restarts, so
+ * that creating callouts doesn't need any calls at all.
+ */
+class InventoryCache
+{
+  public:
+    InventoryCache() = delete;
+    ~InventoryCache() = default;
+    InventoryCache(const InventoryCache&) = delete;
+    InventoryCache& operator=(const InventoryCache&) = delete;
+    InventoryCache(InventoryCache&&) = delete;
+    InventoryCache& operator=(InventoryCache&&) = delete;
+
+    /**
+     * Constructor
+     *
+     * @param[in] bus - the D-Bus bus object
+     * @param[in] warm - if the Asset properties should be read
+     *                   from the inventory manager up front
+     */
+    InventoryCache(sdbusplus::bus_t& bus, bool warm);
+
+    /**
+     * Returns the service hosting the Asset interface on an
+     * inventory object.
+     *
+     * @param[in] inventoryPath - the inventory object path
+     *
+     * @return DbusService - the service, or empty if there isn't one
+     */
+    DbusService getService(const std::string& inventoryPath);
+
+    /**
+     * The function called with an object's Asset properties, or
+     * with nullptr if it doesn't have any or they couldn't be read.
+     * The properties are only valid during the call.
+     */
+    using AssetCallback = std::function<void(const DbusPropertyMap*)>;
+
+    /**
+     * Gets the Asset properties of an inventory object, either
+     * right away from the cache or, if they have to be read, from
+     * the event loop once the reply comes in.  Only one read is
+     * in flight for an object at a time.
+     *
+     * @param[in] inventoryPath - the inventory object path
+     * @param[in] callback - the function to pass the properties to
+     */
+    void getAssetProperties(const std::string& inventoryPath,
+                            AssetCallback callback);
+
+    /**
+     * The cached Asset properties, for their statistics
+     *
+     * @return const AssetCache&
+     */
+    inline const AssetCache& assets() const
+    {
+        return assetCache;
+    }
+
+  private:
+    /**
+     * An Asset GetAll call waiting for its reply
+     */
+    struct Request
+    {
+        InventoryCache* cache;
+        DbusPath path;
+        std::unique_ptr<sd_bus_slot, decltype(&sd_bus_slot_unref)> slot{
+            nullptr, sd_bus_slot_unref};
+        std::vector<AssetCallback> callbacks;
+
+        // If the properties changed after the call was made,
+        // so the reply shouldn't be cached.
+        bool invalidated = false;
+    };
+
+    /**
+     * The sd-bus callback for a GetAll reply
+     */
+    static int handleReply(sd_bus_message* msg, void* data,
+                           sd_bus_error* error);
+
+    /**
+     * Caches the properties from a GetAll reply, and passes
+     * them to everything waiting on them.
+     *
+     * @param[in] request - the request
+     * @param[in] reply - the reply
+     */
+    void complete(Request& request, sdbusplus::message_t& reply);
+
+    /**
+     * Starts reading the Asset properties of all of the inventory
+     * manager's objects, replacing any read already in progress.
+     */
+    void warm();
+
+    /**
+     * The sd-bus callback for the GetManagedObjects reply
+     */
+    static int handleWarmReply(sd_bus_message* msg, void* data,
+                               sd_bus_error* error);
+
+    /**
+     * Drops the cached properties for a path, and keeps a
+     * read in flight for it from being cached.
+     *
+     * @param[in] objPath - the inventory object path
+     */
+    void invalidate(const DbusPath& objPath);
+
+    /**
+     * Fills the service map from the mapper, leaving it
+     * stale if that fails so it will be tried again.
+     */
+    void load();
+
+    /**
+     * The callback for an interfaces added signal under the
+     * inventory path.
+     *
+     * @param[in] msg - the sdbusplus message
+     */
+    void interfacesAdded(sdbusplus::message_t& msg);
+
+    /**
+     * The callback for an interfaces removed signal under the
+     * inventory path.
+     *
+     * @param[in] msg - the sdbusplus message
+     */
+    void interfacesRemoved(sdbusplus::message_t& msg);
+
+    /**
+     * The callback for a NameOwnerChanged signal for one of
+     * the watched services.
+     *
+     * @param[in] msg - the sdbusplus message
+     */
+    void nameOwnerChanged(sdbusplus::message_t& msg);
+
+    /**
+     * Makes the NameOwnerChanged matches cover just the services
+     * in the service map, and the inventory manager if the cache
+     * is warmed from it, so other clients coming and going on the
+     * bus don't wake the daemon.
+     *
+     * It isn't called from nameOwnerChanged(), so a match isn't
+     * removed from its own callback.  The match of a service that
+     * went away is dropped on the next update instead.
+     */
+    void watchOwners();
+
+    /**
+     * The callback for a PropertiesChanged signal on an
+     * Asset interface in the inventory.
+     *
+     * @param[in] msg - the sdbusplus message
+     */
+    void propertiesChanged(sdbusplus::message_t& msg);
+
+    /**
+     * The sdbusplus bus object
+     */
+    sdbusplus::bus_t& bus;
+
+    /**
+     * The service for each inventory path with an Asset interface
+     */
+    ServiceMap services;
+
+    /**
+     * If the services have to be read from the mapper
+     */
+    bool stale = true;
+
+    /**
+     * The Asset properties of each inventory path looked up
+     */
+    AssetCache assetCache;
+
+    /**
+     * The GetAll calls in flight, keyed on path
+     */
+    std::unordered_map<DbusPath, std::unique_ptr<Request>> requests;
+
+    /**
+     * If the cache is warmed from the inventory manager
+     */
+    const bool warmEnabled;
+
+    /**
+     * The GetManagedObjects call in flight, if there is one
+     */
+    std::unique_ptr<sd_bus_slot, decltype(&sd_bus_slot_unref)> warmSlot{
+        nullptr, sd_bus_slot_unref};
+
+    /**
+     * The paths whose Asset properties changed while the
+     * GetManagedObjects call was in flight.
+     */
+    std::unordered_set<DbusPath> warmInvalidated;
+
+    /**
+     * The match object for interfacesAdded
+     */
+    sdbusplus::bus::match_t addMatch;
+
+    /**
+     * The match object for interfacesRemoved
+     */
+    sdbusplus::bus::match_t removeMatch;
+
+    /**
+     * The NameOwnerChanged match objects, keyed on the
+     * service they're for.
+     */
+    std::unordered_map<DbusService, std::unique_ptr<sdbusplus::bus::match_t>>
+        ownerMatches;
+
+    /**
+     * The match object for PropertiesChanged
+     */
+    sdbusplus::bus::match_t propertiesMatch;
+};
+
+} // namespace logging
+} // namespace ibm
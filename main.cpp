@@ -17,24 +17,48 @@
 
 #include "manager.hpp"
 
+#include <pthread.h>
+#include <systemd/sd-event.h>
+
 #include <sdbusplus/bus.hpp>
 #include <sdbusplus/server/manager.hpp>
 
+#include <csignal>
+
 int main()
 {
+    // The Manager handles SIGUSR1 on the event loop.  Block it
+    // before the Manager starts any threads, which inherit the
+    // mask, so the signal can't be delivered to one of them and
+    // kill the daemon.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
     auto bus = sdbusplus::bus::new_default();
 
+    sd_event* event = nullptr;
+    auto rc = sd_event_default(&event);
+    if (rc < 0)
+    {
+        return rc;
+    }
+
+    // The bus is attached to the event loop before the Manager is
+    // created so it can add its own event sources to it.
+    bus.attach_event(event, SD_EVENT_PRIORITY_NORMAL);
+
     sdbusplus::server::manager_t objManager(bus, LOGGING_PATH);
 
     ibm::logging::Manager manager{bus};
 
     bus.request_name(IBM_LOGGING_BUSNAME);
 
-    while (true)
-    {
-        bus.process_discard();
-        bus.wait();
-    }
+    rc = sd_event_loop(event);
+
+    bus.detach_event();
+    sd_event_unref(event);
 
-    return 0;
+    return rc;
 }
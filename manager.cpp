@@ -17,7 +17,7 @@
 
 #include "manager.hpp"
 
-#include "callout.hpp"
+#include "entry_reader.hpp"
 #include "policy_find.hpp"
 
 #include <phosphor-logging/log.hpp>
@@ -32,40 +32,222 @@ using namespace phosphor::logging;
 
 Manager::Manager(sdbusplus::bus_t& bus) :
     bus(bus),
-    addMatch(bus,
-             sdbusplus::bus::match::rules::interfacesAdded() +
-                 sdbusplus::bus::match::rules::path_namespace(LOGGING_PATH),
-             std::bind(std::mem_fn(&Manager::interfaceAdded), this,
-                       std::placeholders::_1)),
-    removeMatch(bus,
-                sdbusplus::bus::match::rules::interfacesRemoved() +
-                    sdbusplus::bus::match::rules::path_namespace(LOGGING_PATH),
-                std::bind(std::mem_fn(&Manager::interfaceRemoved), this,
-                          std::placeholders::_1))
+    ownerMatch(bus,
+               sdbusplus::bus::match::rules::nameOwnerChanged(LOGGING_BUSNAME),
+               std::bind(std::mem_fn(&Manager::loggingOwnerChanged), this,
+                         std::placeholders::_1))
 #ifdef USE_POLICY_INTERFACE
     ,
-    policies(POLICY_JSON_PATH)
+    policies(POLICY_IMAGE_PATH,
+             std::vector<std::string>{POLICY_JSON_PATH,
+                                      POLICY_OVERLAY_JSON_PATH})
 #endif
 {
+    auto event = sd_bus_get_event(bus.get());
+    if (event)
+    {
+#ifdef USE_POLICY_INTERFACE
+        policyWatcher = std::make_unique<policy::Watcher>(
+            event,
+            std::vector<std::string>{POLICY_IMAGE_PATH, POLICY_JSON_PATH,
+                                     POLICY_OVERLAY_JSON_PATH},
+            [this]() { policies.reload(); });
+#endif
+
+        // SIGUSR1 writes the statistics to the journal.  The signal
+        // has to be blocked in every thread for sd_event to be able
+        // to handle it, which main() does before creating the Manager.
+        sd_event_source* source = nullptr;
+        auto rc = sd_event_add_signal(event, &source, SIGUSR1,
+                                      handleStatsSignal, this);
+        if (rc < 0)
+        {
+            log<level::ERR>("sd_event_add_signal failed for SIGUSR1",
+                            entry("RC=%d", rc));
+        }
+        statsSource.reset(source);
+    }
+
+    // The owner match is already in place, so a change
+    // after this will still be seen.
+    try
+    {
+        watchLogging(getNameOwner(bus, LOGGING_BUSNAME));
+    }
+    catch (const sdbusplus::exception_t& e)
+    {
+        log<level::ERR>("Failed getting the logging service owner",
+                        entry("ERROR=%s", e.what()));
+    }
+
     createAll();
 }
 
+void Manager::watchLogging(const std::string& owner)
+{
+    namespace rules = sdbusplus::bus::match::rules;
+
+    addMatch.reset();
+    removeMatch.reset();
+
+    if (owner.empty())
+    {
+        return;
+    }
+
+    // Only listen to the logging service, and only for entry paths,
+    // which leaves out our own callout objects.  Paths under an
+    // entry still get through arg0path, so they are filtered again
+    // in the callbacks.
+    auto filter = rules::sender(owner) + rules::path_namespace(LOGGING_PATH) +
+                  rules::argNpath(0, LOGGING_PATH "/entry/");
+
+    addMatch = std::make_unique<sdbusplus::bus::match_t>(
+        bus, rules::interfacesAdded() + filter,
+        std::bind(std::mem_fn(&Manager::interfaceAdded), this,
+                  std::placeholders::_1));
+
+    removeMatch = std::make_unique<sdbusplus::bus::match_t>(
+        bus, rules::interfacesRemoved() + filter,
+        std::bind(std::mem_fn(&Manager::interfaceRemoved), this,
+                  std::placeholders::_1));
+}
+
+void Manager::loggingOwnerChanged(sdbusplus::message_t& msg)
+{
+    std::string name;
+    std::string oldOwner;
+    std::string newOwner;
+
+    msg.read(name, oldOwner, newOwner);
+
+    // The matches go in first so nothing is missed between
+    // reading the entries and watching for new ones.
+    watchLogging(newOwner);
+
+    if (!newOwner.empty())
+    {
+        createMissing();
+    }
+}
+
+int Manager::handleStatsSignal(sd_event_source* /*source*/,
+                               const struct signalfd_siginfo* /*info*/,
+                               void* data)
+{
+    static_cast<Manager*>(data)->logStatistics();
+    return 0;
+}
+
+void Manager::logStatistics()
+{
+    const auto& assets = inventory.assets();
+
+    log<level::INFO>("IBM logging statistics",
+                     entry("ENTRIES=%zu", entries.size()),
+                     entry("ASSET_CACHE_HITS=%llu", assets.hits()),
+                     entry("ASSET_CACHE_MISSES=%llu", assets.misses()),
+                     entry("ASSET_CACHE_SIZE=%zu", assets.size()),
+                     entry("CALLOUTS_SAVED=%llu", persistTotals.committed),
+                     entry("CALLOUT_SAVE_FAILURES=%llu", persistTotals.failed),
+                     entry("CALLOUT_LOG_SIZE=%llu", persistTotals.fileSize),
+                     entry("CALLOUT_LOG_LIVE=%llu", persistTotals.liveSize));
+
+#ifdef USE_POLICY_INTERFACE
+    log<level::INFO>("IBM logging policy cache statistics",
+                     entry("POLICY_CACHE_HITS=%llu", policyCache.hits()),
+                     entry("POLICY_CACHE_MISSES=%llu", policyCache.misses()),
+                     entry("POLICY_CACHE_SIZE=%zu", policyCache.size()));
+#endif
+}
+
 void Manager::createAll()
 {
+    // Only the index of the saved callouts is read up front.  The
+    // callouts of the logs that still exist are read after all of
+    // the logs have been seen.  Nothing has been queued to the
+    // persist worker yet, so the store can be used directly.
+    try
+    {
+        savedCallouts = calloutStore.loadIndex();
+
+        log<level::INFO>("Loaded the callout restore index",
+                         entry("LOGS=%zu", savedCallouts.size()),
+                         entry("SCANNED=%llu", calloutStore.scannedSize()));
+    }
+    catch (const std::exception& e)
+    {
+        log<level::ERR>("Failed loading the saved callouts",
+                        entry("ERROR=%s", e.what()));
+    }
+
+    bool haveAll = false;
     try
     {
-        auto objects = getManagedObjects(bus, LOGGING_BUSNAME, LOGGING_PATH);
+        auto reply = getManagedObjectsReply(bus, LOGGING_BUSNAME, LOGGING_PATH);
+
+        // Each entry is handled as it is read out of the reply,
+        // instead of decoding all of them up front.
+        auto r = readEntries(reply.get(),
+                             [this](const std::string& objectPath,
+                                    const DbusInterfaceMap& interfaces) {
+            createWithRestore(objectPath, interfaces);
+        });
+
+        if (r < 0)
+        {
+            log<level::ERR>("Failed reading the logging managed objects",
+                            entry("RC=%d", r));
+        }
+        else
+        {
+            haveAll = true;
+        }
+    }
+    catch (const sdbusplus::exception_t& e)
+    {
+        log<level::ERR>("sdbusplus error getting logging managed objects",
+                        entry("ERROR=%s", e.what()));
+    }
+
+    // This reads the store, so it has to be done before
+    // anything is queued to the persist worker.
+    restoreQueuedCallouts();
 
-        for (const auto& object : objects)
+    if (haveAll)
+    {
+        // What's left is for logs that were deleted
+        // while this app wasn't running.
+        for (const auto& callouts : savedCallouts)
         {
-            const auto& interfaces = object.second;
+            eraseSavedCallouts(callouts.first);
+        }
+    }
 
-            auto propertyMap = interfaces.find(LOGGING_IFACE);
+    savedCallouts.clear();
+    calloutRestores.clear();
+}
 
-            if (propertyMap != interfaces.end())
-            {
-                createWithRestore(object.first, interfaces);
-            }
+void Manager::createMissing()
+{
+    try
+    {
+        auto reply = getManagedObjectsReply(bus, LOGGING_BUSNAME, LOGGING_PATH);
+
+        auto isNew = [this](std::string_view objectPath) {
+            return !isKnown(getEntryID(std::string{objectPath}));
+        };
+
+        auto r = readEntries(reply.get(),
+                             [this](const std::string& objectPath,
+                                    const DbusInterfaceMap& interfaces) {
+            create(objectPath, interfaces);
+        }, isNew);
+
+        if (r < 0)
+        {
+            log<level::ERR>("Failed reading the logging managed objects",
+                            entry("RC=%d", r));
         }
     }
     catch (const sdbusplus::exception_t& e)
@@ -80,7 +262,7 @@ void Manager::createWithRestore(const std::string& objectPath,
 {
     createObject(objectPath, interfaces);
 
-    restoreCalloutObjects(objectPath, interfaces);
+    queueCalloutRestore(objectPath, interfaces);
 }
 
 void Manager::create(const std::string& objectPath,
@@ -102,69 +284,32 @@ void Manager::createObject(const std::string& objectPath,
 
 void Manager::erase(EntryID id)
 {
-    fs::remove_all(getSaveDir(id));
-    childEntries.erase(id);
+    pendingCallouts.erase(id);
     entries.erase(id);
+    eraseSavedCallouts(id);
 }
 
-void Manager::addInterface(const std::string& objectPath, InterfaceType type,
-                           std::any& object)
+void Manager::eraseSavedCallouts(EntryID id)
 {
-    auto id = getEntryID(objectPath);
-    auto entry = entries.find(id);
-
-    if (entry == entries.end())
-    {
-        InterfaceMap interfaces;
-        interfaces.emplace(type, object);
-        entries.emplace(id, std::move(interfaces));
-    }
-    else
-    {
-        entry->second.emplace(type, object);
-    }
+    persistWorker.erase(id);
 }
 
-void Manager::addChildInterface(const std::string& objectPath,
-                                InterfaceType type, std::any& object)
+void Manager::persistDone(const PersistWorker::Results& results)
 {
-    auto id = getEntryID(objectPath);
-    auto entry = childEntries.find(id);
-
-    // childEntries is:
-    // A map of error log entry IDs to:
-    //  a map of interface types to:
-    //    a vector of interface objects
-
-    if (entry == childEntries.end())
-    {
-        ObjectList objects{object};
-        InterfaceMapMulti interfaces;
-        interfaces.emplace(type, std::move(objects));
-        childEntries.emplace(id, std::move(interfaces));
-    }
-    else
-    {
-        auto i = entry->second.find(type);
-        if (i == entry->second.end())
-        {
-            ObjectList objects{object};
-            entry->second.emplace(type, objects);
-        }
-        else
-        {
-            i->second.emplace_back(object);
-        }
-    }
+    persistTotals.committed += results.committed;
+    persistTotals.failed += results.failed;
+    persistTotals.fileSize = results.fileSize;
+    persistTotals.liveSize = results.liveSize;
 }
 
 #ifdef USE_POLICY_INTERFACE
 void Manager::createPolicyInterface(const std::string& objectPath,
                                     const DbusPropertyMap& properties)
 {
-    auto values = policy::find(policies, properties);
+    auto table = policies.get();
+    auto values = policy::find(*table, modifierRules, policyCache, properties);
 
-    auto object = std::make_shared<PolicyObject>(
+    auto object = std::make_unique<PolicyObject>(
         bus, objectPath.c_str(), PolicyObject::action::defer_emit);
 
     object->eventID(std::get<policy::EIDField>(values));
@@ -172,9 +317,7 @@ void Manager::createPolicyInterface(const std::string& objectPath,
 
     object->emit_object_added();
 
-    std::any anyObject = object;
-
-    addInterface(objectPath, InterfaceType::POLICY, anyObject);
+    entries.insert(getEntryID(objectPath)).policy = std::move(object);
 }
 #endif
 
@@ -197,113 +340,236 @@ void Manager::createCalloutObjects(const std::string& objectPath,
     auto assocValue = std::get<AssociationsPropertyType>(assocProperty->second);
 
     auto id = getEntryID(objectPath);
-    auto calloutNum = 0;
-    DbusSubtree subtree;
+    auto pending = std::make_shared<PendingCallouts>();
+    pending->objectPath = objectPath;
+    pending->timestamp = getLogTimestamp(interfaces);
 
     for (const auto& association : assocValue)
     {
-        try
+        if (std::get<forwardPos>(association) == "callout")
         {
-            if (std::get<forwardPos>(association) != "callout")
-            {
-                continue;
-            }
+            pending->callouts.push_back({std::get<endpointPos>(association)});
+        }
+    }
 
-            auto callout = std::get<endpointPos>(association);
+    if (pending->callouts.empty())
+    {
+        return;
+    }
 
-            if (subtree.empty())
-            {
-                subtree = getSubtree(bus, "/", 0, ASSET_IFACE);
-                if (subtree.empty())
-                {
-                    break;
-                }
-            }
+    pendingCallouts[id] = pending;
+
+    // The properties of all callouts are requested at once, and each
+    // is filled in as its reply comes in.  If the log is deleted
+    // first, the replies are dropped.
+    std::weak_ptr<PendingCallouts> weak = pending;
 
-            auto service = getService(callout, ASSET_IFACE, subtree);
-            if (service.empty())
+    for (size_t i = 0; i < pending->callouts.size(); i++)
+    {
+        auto callback = [this, weak, i](const DbusPropertyMap* properties) {
+            auto pending = weak.lock();
+            if (!pending)
             {
-                continue;
+                return;
             }
 
-            auto properties = getAllProperties(bus, service, callout,
-                                               ASSET_IFACE);
-            if (properties.empty())
+            auto& callout = pending->callouts[i];
+            callout.done = true;
+            if (properties && !properties->empty())
             {
-                continue;
+                callout.properties = *properties;
             }
 
-            auto calloutPath = getCalloutObjectPath(objectPath, calloutNum);
+            publishCallouts(*pending);
+        };
 
-            auto object = std::make_shared<Callout>(
-                bus, calloutPath, callout, calloutNum,
-                getLogTimestamp(interfaces), properties);
+        try
+        {
+            inventory.getAssetProperties(pending->callouts[i].inventoryPath,
+                                         std::move(callback));
+        }
+        catch (const sdbusplus::exception_t& e)
+        {
+            log<level::ERR>("sdbusplus exception", entry("ERROR=%s", e.what()));
 
-            auto dir = getCalloutSaveDir(id);
-            if (!fs::exists(dir))
+            if (weak.expired())
             {
-                fs::create_directories(dir);
+                return;
             }
-            object->serialize(dir);
+            pending->callouts[i].done = true;
+            publishCallouts(*pending);
+        }
+    }
+}
+
+void Manager::publishCallouts(PendingCallouts& pending)
+{
+    auto id = getEntryID(pending.objectPath);
 
-            std::any anyObject = object;
-            addChildInterface(objectPath, InterfaceType::CALLOUT, anyObject);
-            calloutNum++;
+    // Callouts are numbered in association order, skipping the
+    // ones without Asset properties, so a callout can only be
+    // published once all of the ones before it have their replies.
+    while ((pending.next < pending.callouts.size()) &&
+           pending.callouts[pending.next].done)
+    {
+        auto& callout = pending.callouts[pending.next++];
+        if (!callout.properties)
+        {
+            continue;
+        }
+
+        try
+        {
+            auto calloutPath = getCalloutObjectPath(pending.objectPath,
+                                                    pending.calloutNum);
+
+            auto object = std::make_unique<Callout>(
+                bus, calloutPath, callout.inventoryPath, pending.calloutNum,
+                pending.timestamp, *callout.properties);
+
+            persistWorker.append(object->record(id));
+
+            entries.insert(id).callouts.push_back(std::move(object));
+            pending.calloutNum++;
         }
         catch (const sdbusplus::exception_t& e)
         {
             log<level::ERR>("sdbusplus exception", entry("ERROR=%s", e.what()));
         }
+
+        callout.properties.reset();
+    }
+
+    if (pending.next == pending.callouts.size())
+    {
+        pendingCallouts.erase(id);
     }
 }
 
-void Manager::restoreCalloutObjects(const std::string& objectPath,
-                                    const DbusInterfaceMap& interfaces)
+void Manager::queueCalloutRestore(const std::string& objectPath,
+                                  const DbusInterfaceMap& interfaces)
 {
-    auto saveDir = getCalloutSaveDir(getEntryID(objectPath));
+    auto id = getEntryID(objectPath);
+    auto callouts = savedCallouts.find(id);
 
-    if (!fs::exists(saveDir))
+    if (callouts == savedCallouts.end())
     {
         return;
     }
 
-    size_t id;
-    for (auto& f : fs::directory_iterator(saveDir))
+    // Check that the callouts are for this log, and not an
+    // older one with the same ID.  If not, they're left in
+    // savedCallouts to be deleted.
+    auto timestamp = getLogTimestamp(interfaces);
+    if (callouts->second.timestamp != timestamp)
     {
-        try
+        log<level::INFO>("Timestamp mismatch in persisted Callout. Discarding",
+                         entry("ENTRY_ID=%u", id),
+                         entry("PERSISTED_TS=%llu", callouts->second.timestamp),
+                         entry("EXPECTED_TS=%llu", timestamp));
+        return;
+    }
+
+    calloutRestores.push_back({id, objectPath});
+    savedCallouts.erase(callouts);
+}
+
+void Manager::restoreQueuedCallouts()
+{
+    if (calloutRestores.empty())
+    {
+        return;
+    }
+
+    // With one CPU, other threads can't read any faster, and
+    // only add the cost of handing the records over.
+    if (CalloutLoader::threadCount() == 1)
+    {
+        for (const auto& [id, objectPath] : calloutRestores)
         {
-            id = std::stoul(f.path().filename());
+            try
+            {
+                restoreCallouts(id, objectPath, calloutStore.read(id));
+            }
+            catch (const std::exception& e)
+            {
+                log<level::ERR>("Failed reading saved callouts",
+                                entry("ENTRY_ID=%u", id),
+                                entry("ERROR=%s", e.what()));
+            }
         }
-        catch (const std::exception& e)
+        return;
+    }
+
+    std::vector<uint32_t> ids;
+    ids.reserve(calloutRestores.size());
+    for (const auto& restore : calloutRestores)
+    {
+        ids.push_back(restore.first);
+    }
+
+    // The callouts are read and decoded on other threads, and
+    // come back in the same order, a batch of logs at a time.
+    CalloutLoader loader{calloutStore, std::move(ids)};
+    CalloutLoader::Batch batch;
+    size_t next = 0;
+
+    while (loader.next(batch))
+    {
+        for (const auto& loaded : batch)
         {
-            log<level::ERR>("Invalid IBM logging callout save file. Deleting",
-                            entry("FILE=%s", f.path().c_str()));
-            fs::remove(f.path());
-            continue;
+            const auto& [id, objectPath] = calloutRestores[next++];
+            restoreCallouts(id, objectPath, loaded.records);
         }
+    }
+}
 
-        auto path = getCalloutObjectPath(objectPath, id);
-        auto callout = std::make_shared<Callout>(bus, path, id,
-                                                 getLogTimestamp(interfaces));
-        if (callout->deserialize(saveDir))
+void Manager::restoreCallouts(EntryID id, const std::string& objectPath,
+                              const std::vector<CalloutRecord>& records)
+{
+    for (const auto& record : records)
+    {
+        try
         {
+            auto path = getCalloutObjectPath(objectPath, record.calloutNum);
+            auto callout = std::make_unique<Callout>(bus, path, record);
+
             callout->emit_object_added();
-            std::any anyObject = callout;
-            addChildInterface(objectPath, InterfaceType::CALLOUT, anyObject);
+            entries.insert(id).callouts.push_back(std::move(callout));
+        }
+        catch (const sdbusplus::exception_t& e)
+        {
+            log<level::ERR>("sdbusplus exception", entry("ERROR=%s", e.what()));
         }
     }
 }
 
 void Manager::interfaceAdded(sdbusplus::message_t& msg)
 {
-    sdbusplus::message::object_path path;
-    DbusInterfaceMap interfaces;
+    auto m = msg.get();
+    const char* path = nullptr;
 
-    msg.read(path, interfaces);
+    // Check the path before reading any further
+    auto r = sd_bus_message_read_basic(m, 'o', &path);
+    if ((r < 0) || !isEntryPath(path))
+    {
+        return;
+    }
 
-    // Find the Logging.Entry interface with all of its properties
-    // to pass to create().
-    if (interfaces.find(LOGGING_IFACE) != interfaces.end())
+    DbusInterfaceMap interfaces;
+    r = readEntryInterfaces(m, interfaces);
+    if (r < 0)
+    {
+        log<level::ERR>("Failed reading an InterfacesAdded signal",
+                        entry("PATH=%s", path), entry("RC=%d", r));
+        return;
+    }
+
+    // Find the Logging.Entry interface with the properties
+    // used to pass to create().  A log read by createMissing()
+    // can still have its InterfacesAdded signal queued.
+    if ((interfaces.find(LOGGING_IFACE) != interfaces.end()) &&
+        !isKnown(getEntryID(path)))
     {
         create(path, interfaces);
     }
@@ -324,16 +590,6 @@ uint64_t Manager::getLogTimestamp(const DbusInterfaceMap& interfaces)
     return 0;
 }
 
-fs::path Manager::getSaveDir(EntryID id)
-{
-    return fs::path{ERRLOG_PERSIST_PATH} / std::to_string(id);
-}
-
-fs::path Manager::getCalloutSaveDir(EntryID id)
-{
-    return getSaveDir(id) / "callouts";
-}
-
 std::string Manager::getCalloutObjectPath(const std::string& objectPath,
                                           uint32_t calloutNum)
 {
@@ -347,6 +603,11 @@ void Manager::interfaceRemoved(sdbusplus::message_t& msg)
 
     msg.read(path, interfaces);
 
+    if (!isEntryPath(path.str))
+    {
+        return;
+    }
+
     // If the Logging.Entry interface was removed, then remove
     // our object
 
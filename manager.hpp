@@ -2,17 +2,31 @@
 
 #include "config.h"
 
+#include "callout.hpp"
+#include "callout_loader.hpp"
+#include "callout_store.hpp"
 #include "dbus.hpp"
+#include "entry_store.hpp"
 #include "interfaces.hpp"
+#include "inventory_cache.hpp"
+#include "persist_worker.hpp"
+
+#include <systemd/sd-event.h>
 
 #include <sdbusplus/bus.hpp>
 
-#include <any>
+#include <csignal>
 #include <experimental/filesystem>
 #include <map>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 #ifdef USE_POLICY_INTERFACE
-#include "policy_table.hpp"
+#include "modifier_rules.hpp"
+#include "policy_cache.hpp"
+#include "policy_reload.hpp"
+#include "policy_watch.hpp"
 #endif
 
 namespace ibm
@@ -47,13 +61,40 @@ class Manager
     explicit Manager(sdbusplus::bus_t& bus);
 
   private:
-    using EntryID = uint32_t;
-    using InterfaceMap = std::map<InterfaceType, std::any>;
-    using EntryMap = std::map<EntryID, InterfaceMap>;
+    /**
+     * The IBM objects for an error log.  Almost all logs have
+     * no more than a couple of callouts, so those are kept in
+     * the record itself.
+     */
+    struct Entry
+    {
+        std::unique_ptr<PolicyObject> policy;
+        InlineVector<std::unique_ptr<Callout>, 2> callouts;
+    };
 
-    using ObjectList = std::vector<std::any>;
-    using InterfaceMapMulti = std::map<InterfaceType, ObjectList>;
-    using EntryMapMulti = std::map<EntryID, InterfaceMapMulti>;
+    using EntryID = EntryStore<Entry>::ID;
+
+    /**
+     * The callouts of a new log, while their Asset
+     * properties are being read.
+     */
+    struct PendingCallouts
+    {
+        struct Item
+        {
+            std::string inventoryPath;
+            bool done = false;
+            std::optional<DbusPropertyMap> properties;
+        };
+
+        std::string objectPath;
+        uint64_t timestamp = 0;
+        std::vector<Item> callouts;
+
+        // The next callout to publish, and its number
+        size_t next = 0;
+        uint32_t calloutNum = 0;
+    };
 
     /**
      * Deletes the entry and any child entries with
@@ -63,11 +104,59 @@ class Manager
      */
     void erase(EntryID id);
 
+    /**
+     * The sd_event callback for SIGUSR1, which logs the statistics
+     */
+    static int handleStatsSignal(sd_event_source* source,
+                                 const struct signalfd_siginfo* info,
+                                 void* data);
+
+    /**
+     * Writes the entry count and the cache hit rates to the journal
+     */
+    void logStatistics();
+
+    /**
+     * Deletes the saved callouts for a log
+     *
+     * @param[in] id - the entry ID
+     */
+    void eraseSavedCallouts(EntryID id);
+
+    /**
+     * The callback for the results of saving callouts
+     *
+     * @param[in] results - the results of a batch
+     */
+    void persistDone(const PersistWorker::Results& results);
+
+    /**
+     * Points the interfaces added and removed matches at a new
+     * owner of the logging service, or removes them if it has
+     * no owner.
+     *
+     * @param[in] owner - the unique name of the owner
+     */
+    void watchLogging(const std::string& owner);
+
+    /**
+     * The callback for a NameOwnerChanged signal for
+     * the logging service.
+     *
+     * When the service gets a new owner, the entries it already
+     * has are read, since it can create them before it takes its
+     * name, and the ones that are new are created.
+     *
+     * @param[in] msg - the sdbusplus message
+     */
+    void loggingOwnerChanged(sdbusplus::message_t& msg);
+
     /**
      * The callback for an interfaces added signal
      *
      * Creates the IBM interfaces for the log entry
-     * that was just created.
+     * that was just created.  Only the properties that
+     * are used are read from the signal.
      *
      * @param[in] msg - the sdbusplus message
      */
@@ -89,6 +178,26 @@ class Manager
      */
     void createAll();
 
+    /**
+     * Creates the IBM interfaces for the existing error log
+     * entries that don't have them yet.  Only those entries
+     * are decoded from the GetManagedObjects reply.
+     */
+    void createMissing();
+
+    /**
+     * Says if the IBM interfaces for an error log have been, or
+     * are being, created.
+     *
+     * @param[in] id - the entry ID
+     *
+     * @return bool
+     */
+    inline bool isKnown(EntryID id)
+    {
+        return entries.find(id) || pendingCallouts.contains(id);
+    }
+
     /**
      * Creates the IBM interface(s) for a single new error log.
      *
@@ -106,8 +215,8 @@ class Manager
      * Creates the IBM interface(s) for a single error log after
      * the application is restarted.
      *
-     * Interfaces that were persisted will be restored from their
-     * previously saved filesystem data.
+     * Interfaces that were persisted are queued to be restored
+     * from their previously saved data by restoreQueuedCallouts().
      *
      * @param[in] objectPath - object path of the error log
      * @param[in] interfaces - map of all interfaces and properties
@@ -139,24 +248,6 @@ class Manager
      */
     uint64_t getLogTimestamp(const DbusInterfaceMap& interfaces);
 
-    /**
-     * Returns the filesystem directory to use for persisting
-     * information about a particular error log.
-     *
-     * @param[in] id - the error log ID
-     * @return path - the directory path
-     */
-    std::experimental::filesystem::path getSaveDir(EntryID id);
-
-    /**
-     * Returns the directory to use to save the callout information in
-     *
-     * @param[in] id - the error log ID
-     *
-     * @return path - the directory path
-     */
-    std::experimental::filesystem::path getCalloutSaveDir(EntryID id);
-
     /**
      * Returns the D-Bus object path to use for a callout D-Bus object.
      *
@@ -193,6 +284,9 @@ class Manager
      * Any objects created are serialized so the asset information
      * can always be restored.
      *
+     * The Asset properties are read asynchronously, so the objects
+     * may be created after this returns.
+     *
      * @param[in] objectPath - object path of the error log
      * @param[in] interfaces - map of all interfaces and properties
      *                         on a phosphor-logging error log.
@@ -201,16 +295,43 @@ class Manager
                               const DbusInterfaceMap& interfaces);
 
     /**
-     * Restores callout objects for a particular error log that
-     * have previously been saved by reading their data out of
-     * the filesystem using Cereal.
+     * Creates the objects for a log's callouts that have their
+     * Asset properties, in order, up to the first one that is
+     * still waiting for them.
+     *
+     * @param[in] pending - the log's callouts
+     */
+    void publishCallouts(PendingCallouts& pending);
+
+    /**
+     * Queues the callout objects for a particular error log to be
+     * restored from the callout store, if the store's index has
+     * callouts for it with the log's timestamp.
      *
      * @param[in] objectPath - object path of the error log
      * @param[in] interfaces - map of all interfaces and properties
      *                         on a phosphor-logging error log.
      */
-    void restoreCalloutObjects(const std::string& objectPath,
-                               const DbusInterfaceMap& interfaces);
+    void queueCalloutRestore(const std::string& objectPath,
+                             const DbusInterfaceMap& interfaces);
+
+    /**
+     * Creates the queued callout objects, in the order they were
+     * queued.  With more than one CPU, their saved data is read on
+     * a CalloutLoader's threads, and otherwise it is read inline.
+     */
+    void restoreQueuedCallouts();
+
+    /**
+     * Creates the callout objects for an error log from their
+     * saved data.
+     *
+     * @param[in] id - the error log's ID
+     * @param[in] objectPath - object path of the error log
+     * @param[in] records - the saved callouts
+     */
+    void restoreCallouts(EntryID id, const std::string& objectPath,
+                         const std::vector<CalloutRecord>& records);
 
     /**
      * Returns the entry ID for a log
@@ -226,67 +347,104 @@ class Manager
     }
 
     /**
-     * Adds an interface object to the entries map
-     *
-     * @param[in] objectPath - the object path of the log
-     * @param[in] type - the interface type being added
-     * @param[in] object - the interface object
+     * The sdbusplus bus object
      */
-    void addInterface(const std::string& objectPath, InterfaceType type,
-                      std::any& object);
+    sdbusplus::bus_t& bus;
 
     /**
-     * Adds an interface to a child object, which is an object that
-     * relates to the main ...logging/entry/X object but has a different path.
-     * The object is stored in the childEntries map.
-     *
-     * There can be multiple instances of a child object per type per
-     * logging object.
-     *
-     * @param[in] objectPath - the object path of the log
-     * @param[in] type - the interface type being added.
-     * @param[in] object - the interface object
+     * The match object for the logging service's NameOwnerChanged
      */
-    void addChildInterface(const std::string& objectPath, InterfaceType type,
-                           std::any& object);
+    sdbusplus::bus::match_t ownerMatch;
 
     /**
-     * The sdbusplus bus object
+     * The match object for interfacesAdded from the logging service
      */
-    sdbusplus::bus_t& bus;
+    std::unique_ptr<sdbusplus::bus::match_t> addMatch;
 
     /**
-     * The match object for interfacesAdded
+     * The match object for interfacesRemoved from the logging service
      */
-    sdbusplus::bus::match_t addMatch;
+    std::unique_ptr<sdbusplus::bus::match_t> removeMatch;
 
     /**
-     * The match object for interfacesRemoved
+     * The services hosting the Asset interface on inventory objects
      */
-    sdbusplus::bus::match_t removeMatch;
+#ifdef WARM_ASSET_CACHE
+    InventoryCache inventory{bus, true};
+#else
+    InventoryCache inventory{bus, false};
+#endif
 
     /**
-     * A map of the error log IDs to their IBM interface objects.
-     * There may be multiple interfaces per ID.
+     * The SIGUSR1 event source for the statistics
      */
-    EntryMap entries;
+    std::unique_ptr<sd_event_source, decltype(&sd_event_source_unref)>
+        statsSource{nullptr, sd_event_source_unref};
 
     /**
-     * A map of the error log IDs to their interface objects which
-     * are children of the logging objects.
-     *
-     * These objects have the same lifespan as their parent objects.
-     *
-     * There may be multiple interfaces per ID, and also multiple
-     * interface instances per interface type.
+     * The IBM objects for each error log, indexed on its ID.
+     * The callout objects are children of the logging objects,
+     * and have the same lifespan.
+     */
+    EntryStore<Entry> entries;
+
+    /**
+     * The persisted callouts
+     */
+    CalloutStore calloutStore{ERRLOG_PERSIST_PATH};
+
+    /**
+     * The logs with saved callouts found at startup that
+     * haven't been restored yet.
+     */
+    CalloutStore::Index savedCallouts;
+
+    /**
+     * The IDs and object paths of the logs to restore
+     * callouts for at startup.
+     */
+    std::vector<std::pair<EntryID, std::string>> calloutRestores;
+
+    /**
+     * The totals of the callout saving results, and the
+     * latest callout log sizes.
+     */
+    PersistWorker::Results persistTotals;
+
+    /**
+     * Saves the callouts off of the D-Bus thread.  Destroying it
+     * waits for everything it has queued to be saved.
+     */
+    PersistWorker persistWorker{calloutStore, sd_bus_get_event(bus.get()),
+                                std::bind(std::mem_fn(&Manager::persistDone),
+                                          this, std::placeholders::_1)};
+
+    /**
+     * The logs with callouts waiting on their Asset properties
      */
-    EntryMapMulti childEntries;
+    std::map<EntryID, std::shared_ptr<PendingCallouts>> pendingCallouts;
 
 #ifdef USE_POLICY_INTERFACE
     /**
-     * The class the wraps the IBM error logging policy table.
+     * The class the wraps the IBM error logging policy table,
+     * which is reloaded when its files change.
+     */
+    policy::Reloader policies;
+
+    /**
+     * Watches the policy files for changes
+     */
+    std::unique_ptr<policy::Watcher> policyWatcher;
+
+    /**
+     * The cache of policy table lookups
+     */
+    policy::Cache policyCache{POLICY_CACHE_SIZE};
+
+    /**
+     * The rules used to find the policy table search modifiers
      */
-    policy::Table policies;
+    policy::Rules modifierRules{MODIFIER_RULES_PATH};
 #endif
 };
 } // namespace logging
@@ -0,0 +1,347 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "modifier_rules.hpp"
+
+#include "pel.hpp"
+
+#include <nlohmann/json.hpp>
+#include <phosphor-logging/log.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <experimental/filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+namespace fs = std::experimental::filesystem;
+using namespace phosphor::logging;
+
+/**
+ * The rules IBM service defined for the policy table.
+ *
+ * The first try rules are more specific than the fallback ones, so
+ * that if the table doesn't have an entry for, say, a device path,
+ * the generic "Failed to read from an I2C device" entry can still
+ * be found.
+ */
+static constexpr auto defaultRules = R"(
+{
+    "firstTry": [
+        {"rule": "value", "field": "CALLOUT_DEVICE_PATH"},
+        {"rule": "pelSeverity", "field": "CALLOUT_INVENTORY_PATH",
+         "message": "org.open_power.Host.Error.Event"}
+    ],
+    "fallback": [
+        {"rule": "value", "field": "CALLOUT_INVENTORY_PATH"},
+        {"rule": "value", "field": "RAIL_NAME"},
+        {"rule": "value", "field": "INPUT_NAME"},
+        {"rule": "classify", "field": "CALLOUT_DEVICE_PATH",
+         "classes": [{"contains": "i2c", "modifier": "I2C"},
+                     {"contains": "fsi", "modifier": "FSI"}]},
+        {"rule": "hex", "field": "PROCEDURE"}
+    ]
+})";
+
+std::string_view
+    ModifierBuffer::assign(std::initializer_list<std::string_view> pieces)
+{
+    size_t size = 0;
+    for (const auto& piece : pieces)
+    {
+        size += piece.size();
+    }
+
+    char* out = buffer.data();
+    if (size > buffer.size())
+    {
+        overflow.resize(size);
+        out = overflow.data();
+    }
+
+    char* pos = out;
+    for (const auto& piece : pieces)
+    {
+        pos = std::copy(piece.begin(), piece.end(), pos);
+    }
+
+    return {out, size};
+}
+
+/**
+ * Returns the PEL headers for an error from the host.  The binary
+ * PEL file in the RAWPEL item is used if there is one, as that
+ * doesn't have to be decoded, otherwise the hex text of the PEL
+ * in the ESEL item is.
+ *
+ * @param[in] data - the indexed AdditionalData property for the error
+ *
+ * @return optional<pel::Header> - the headers, if found
+ */
+static std::optional<pel::Header> getPELHeader(const AdditionalData& data)
+{
+    auto file = data.get("RAWPEL");
+    if (file)
+    {
+        auto header = pel::parseFile(*file);
+        if (header)
+        {
+            return header;
+        }
+    }
+
+    auto selData = data.get("ESEL");
+    if (selData)
+    {
+        return pel::parseESEL(*selData);
+    }
+
+    return {};
+}
+
+Rules::Rules()
+{
+    compile(defaultRules);
+}
+
+Rules::Rules(const std::string& rulesFile)
+{
+    if (fs::exists(rulesFile))
+    {
+        try
+        {
+            std::ifstream file{rulesFile};
+            std::stringstream json;
+            json << file.rdbuf();
+
+            compile(json.str());
+            loaded = true;
+            return;
+        }
+        catch (const std::exception& e)
+        {
+            log<level::ERR>("Failed loading modifier rules, using defaults",
+                            entry("FILE=%s", rulesFile.c_str()),
+                            entry("ERROR=%s", e.what()));
+        }
+    }
+
+    compile(defaultRules);
+}
+
+const Rules& Rules::defaults()
+{
+    static const Rules rules;
+    return rules;
+}
+
+void Rules::compile(std::string_view text)
+{
+    fields.clear();
+    firstTryRules.clear();
+    fallbackRules.clear();
+
+    auto json = nlohmann::json::parse(text);
+
+    // Each field gets a slot, so it is only looked up once no
+    // matter how many rules use it.
+    auto slot = [this](const std::string& name) {
+        auto field = std::find(fields.begin(), fields.end(), name);
+        if (field == fields.end())
+        {
+            if (fields.size() == maxFields)
+            {
+                throw std::runtime_error{"Too many fields in the rules"};
+            }
+            field = fields.insert(fields.end(), name);
+        }
+        return static_cast<uint8_t>(field - fields.begin());
+    };
+
+    auto compileList = [&json, &slot](const char* name,
+                                      std::vector<Rule>& rules) {
+        if (!json.contains(name))
+        {
+            return;
+        }
+
+        for (const auto& r : json.at(name))
+        {
+            Rule rule;
+            rule.field = slot(r.at("field").get<std::string>());
+
+            auto op = r.at("rule").get<std::string>();
+            if (op == "value")
+            {
+                rule.op = Op::value;
+            }
+            else if (op == "pelSeverity")
+            {
+                rule.op = Op::pelSeverity;
+            }
+            else if (op == "classify")
+            {
+                rule.op = Op::classify;
+                for (const auto& c : r.at("classes"))
+                {
+                    rule.classes.push_back(
+                        {c.at("contains").get<std::string>(),
+                         c.at("modifier").get<std::string>()});
+                }
+            }
+            else if (op == "hex")
+            {
+                rule.op = Op::hex;
+            }
+            else
+            {
+                throw std::runtime_error{"Unknown rule " + op};
+            }
+
+            if (r.contains("message"))
+            {
+                rule.message = r["message"].get<std::string>();
+            }
+
+            rules.push_back(std::move(rule));
+        }
+    };
+
+    compileList("firstTry", firstTryRules);
+    compileList("fallback", fallbackRules);
+}
+
+std::string_view Rules::firstTry(Input& input, ModifierBuffer& buffer) const
+{
+    return run(firstTryRules, input, buffer);
+}
+
+std::string_view Rules::fallback(Input& input, ModifierBuffer& buffer) const
+{
+    return run(fallbackRules, input, buffer);
+}
+
+Modifiers Rules::evaluate(std::string_view message, const AdditionalData& data,
+                          ModifierBuffer& firstBuffer,
+                          ModifierBuffer& fallbackBuffer) const
+{
+    Input input{message, data};
+
+    return {firstTry(input, firstBuffer), fallback(input, fallbackBuffer)};
+}
+
+std::string_view Rules::run(const std::vector<Rule>& rules, Input& input,
+                            ModifierBuffer& buffer) const
+{
+    for (const auto& rule : rules)
+    {
+        if (rule.message && (*rule.message != input.message))
+        {
+            continue;
+        }
+
+        auto& cached = input.values[rule.field];
+        if (!cached)
+        {
+            cached = input.data.get(fields[rule.field]);
+        }
+        if (!*cached)
+        {
+            continue;
+        }
+        auto value = **cached;
+
+        switch (rule.op)
+        {
+            case Op::value:
+                return value;
+
+            case Op::pelSeverity:
+            {
+                if (!input.severity)
+                {
+                    auto header = getPELHeader(input.data);
+                    input.severity =
+                        header ? std::optional<std::string_view>{
+                                     pel::severityName(header->severity)}
+                               : std::nullopt;
+                }
+
+                if (*input.severity)
+                {
+                    return buffer.assign({value, "||", **input.severity});
+                }
+                break;
+            }
+
+            case Op::classify:
+            {
+                for (const auto& c : rule.classes)
+                {
+                    if (value.find(c.contains) != std::string_view::npos)
+                    {
+                        return c.modifier;
+                    }
+                }
+                break;
+            }
+
+            case Op::hex:
+            {
+                // Convert decimal (e.g. 109) to hex (e.g. 6D)
+                auto first = value.data();
+                auto last = first + value.size();
+                while ((first != last) &&
+                       std::isspace(static_cast<unsigned char>(*first)))
+                {
+                    first++;
+                }
+
+                unsigned long id = 0;
+                auto [end, ec] = std::from_chars(first, last, id);
+                if ((ec == std::errc{}) && (end != first))
+                {
+                    auto out = buffer.data();
+                    auto [outEnd, outEc] =
+                        std::to_chars(out, out + buffer.capacity, id, 16);
+
+                    std::transform(out, outEnd, out, toupper);
+                    return {out, static_cast<size_t>(outEnd - out)};
+                }
+
+                log<level::ERR>(
+                    "Invalid hex modifier value found",
+                    entry("FIELD=%s", fields[rule.field].c_str()),
+                    entry("VALUE=%s", std::string{value}.c_str()));
+                break;
+            }
+        }
+    }
+
+    return {};
+}
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
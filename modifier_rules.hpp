@@ -0,0 +1,299 @@
+#pragma once
+
+#include "additional_data.hpp"
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+/**
+ * @class ModifierBuffer
+ *
+ * Storage for a search modifier that has to be built up from
+ * pieces, which stays on the stack unless the modifier is
+ * unusually long.
+ */
+class ModifierBuffer
+{
+  public:
+    /**
+     * The size of the buffer returned by data()
+     */
+    static constexpr size_t capacity = 256;
+
+    /**
+     * Joins the pieces together into the buffer.
+     *
+     * @param[in] pieces - the strings to join
+     *
+     * @return string_view - the modifier, valid while this
+     *                       object is and until the next call.
+     */
+    std::string_view assign(std::initializer_list<std::string_view> pieces);
+
+    /**
+     * Provides space to format a modifier into directly.
+     *
+     * @return char* - the start of a buffer of capacity bytes
+     */
+    char* data()
+    {
+        return buffer.data();
+    }
+
+  private:
+    std::array<char, capacity> buffer;
+    std::string overflow;
+};
+
+/**
+ * The search modifiers found for an error:
+ * - firstTry - the modifier to look up first, may be empty
+ * - fallback - the modifier to use if the first one isn't in the
+ *              table, may be empty
+ */
+struct Modifiers
+{
+    std::string_view firstTry;
+    std::string_view fallback;
+};
+
+/**
+ * @class Rules
+ *
+ * The rules used to pick the policy table search modifier out of an
+ * error's AdditionalData property, compiled into a small program.
+ *
+ * The rules are described in JSON, as two ordered lists where the
+ * first rule that produces a modifier wins:
+ *
+ *  {
+ *    "firstTry": [ <rule>, ... ],
+ *    "fallback": [ <rule>, ... ]
+ *  }
+ *
+ * Each rule reads one AdditionalData field and is one of:
+ *  - {"rule": "value", "field": F} - F's value
+ *  - {"rule": "pelSeverity", "field": F} - F's value, then "||", then
+ *    the severity of the PEL in the RAWPEL or ESEL fields
+ *  - {"rule": "classify", "field": F,
+ *     "classes": [{"contains": S, "modifier": M}, ...]} - the M of the
+ *    first class whose S is in F's value
+ *  - {"rule": "hex", "field": F} - F's decimal value, in upper case hex
+ *
+ * Any rule can also have a "message" that the error's Message property
+ * must match for the rule to be used.
+ *
+ * Without a rules file the built-in rules that IBM service defined
+ * are used.
+ */
+class Rules
+{
+  public:
+    ~Rules() = default;
+    Rules(const Rules&) = default;
+    Rules& operator=(const Rules&) = default;
+    Rules(Rules&&) = default;
+    Rules& operator=(Rules&&) = default;
+
+    /**
+     * Constructor
+     *
+     * Uses the built-in rules.
+     */
+    Rules();
+
+    /**
+     * Constructor
+     *
+     * Uses the rules in the file if it exists and is valid, and
+     * otherwise the built-in rules.
+     *
+     * @param[in] rulesFile - the path to the rules JSON
+     */
+    explicit Rules(const std::string& rulesFile);
+
+    /**
+     * Returns the shared copy of the built-in rules
+     *
+     * @return const Rules&
+     */
+    static const Rules& defaults();
+
+    /**
+     * The most AdditionalData fields the rules can use
+     */
+    static constexpr size_t maxFields = 32;
+
+    /**
+     * @class Input
+     *
+     * An error's data as the rules see it.  A field is only read
+     * from the AdditionalData when a rule first uses it, so the
+     * firstTry and fallback rules can share one Input.
+     */
+    class Input
+    {
+      public:
+        /**
+         * Constructor
+         *
+         * @param[in] message - the error message, like xyz.A.Error.B
+         * @param[in] data - the indexed AdditionalData property
+         */
+        Input(std::string_view message, const AdditionalData& data) :
+            message(message), data(data)
+        {}
+
+      private:
+        friend class Rules;
+
+        std::string_view message;
+        const AdditionalData& data;
+
+        // Each field's value, once it's been read
+        std::array<std::optional<std::optional<std::string_view>>, maxFields>
+            values;
+
+        // The severity of the error's PEL, once it's been read
+        std::optional<std::optional<std::string_view>> severity;
+    };
+
+    /**
+     * Runs the firstTry rules
+     *
+     * @param[in] input - the error's data
+     * @param[in] buffer - storage for a modifier that has to be built
+     *
+     * @return string_view - the modifier, or empty if no rule matched,
+     *                       pointing into the data, the buffer, or
+     *                       this object.
+     */
+    std::string_view firstTry(Input& input, ModifierBuffer& buffer) const;
+
+    /**
+     * Runs the fallback rules.  Only needed if the firstTry modifier
+     * wasn't found.
+     *
+     * @param[in] input - the error's data
+     * @param[in] buffer - storage for a modifier that has to be built
+     *
+     * @return string_view - the modifier, or empty if no rule matched,
+     *                       pointing into the data, the buffer, or
+     *                       this object.
+     */
+    std::string_view fallback(Input& input, ModifierBuffer& buffer) const;
+
+    /**
+     * Runs both lists of rules against an error's data, reading each
+     * field from it once.
+     *
+     * @param[in] message - the error message, like xyz.A.Error.B
+     * @param[in] data - the indexed AdditionalData property for the error
+     * @param[in] firstBuffer - storage for a firstTry modifier that has
+     *                          to be built
+     * @param[in] fallbackBuffer - storage for a fallback modifier that
+     *                             has to be built
+     *
+     * @return Modifiers - the modifiers, pointing into data, the
+     *                     buffers, or this object.
+     */
+    Modifiers evaluate(std::string_view message, const AdditionalData& data,
+                       ModifierBuffer& firstBuffer,
+                       ModifierBuffer& fallbackBuffer) const;
+
+    /**
+     * Says if the rules came from the rules file
+     *
+     * @return bool
+     */
+    inline bool isLoaded() const
+    {
+        return loaded;
+    }
+
+  private:
+    enum class Op : uint8_t
+    {
+        value,
+        pelSeverity,
+        classify,
+        hex
+    };
+
+    /**
+     * A classify rule's substring and the modifier it gives
+     */
+    struct Class
+    {
+        std::string contains;
+        std::string modifier;
+    };
+
+    /**
+     * A compiled rule
+     */
+    struct Rule
+    {
+        Op op;
+        uint8_t field;
+        std::optional<std::string> message;
+        std::vector<Class> classes;
+    };
+
+    /**
+     * Compiles the rules from the JSON text
+     *
+     * Throws on invalid rules.
+     *
+     * @param[in] json - the rules JSON
+     */
+    void compile(std::string_view json);
+
+    /**
+     * Runs one list of rules
+     *
+     * @param[in] rules - the rules
+     * @param[in] input - the error's data
+     * @param[in] buffer - storage for a modifier that has to be built
+     *
+     * @return string_view - the modifier, or empty if no rule matched
+     */
+    std::string_view run(const std::vector<Rule>& rules, Input& input,
+                         ModifierBuffer& buffer) const;
+
+    /**
+     * If the rules came from the file
+     */
+    bool loaded = false;
+
+    /**
+     * The AdditionalData fields the rules use, indexed by Rule::field
+     */
+    std::vector<std::string> fields;
+
+    /**
+     * The firstTry rules, in order
+     */
+    std::vector<Rule> firstTryRules;
+
+    /**
+     * The fallback rules, in order
+     */
+    std::vector<Rule> fallbackRules;
+};
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,396 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "pel.hpp"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ibm
+{
+namespace logging
+{
+namespace pel
+{
+
+// The Private Header fields
+constexpr size_t phCreatorOffset = 24;
+constexpr size_t phPLIDOffset = 40;
+
+// The User Header fields, from the start of the section
+constexpr size_t uhSubsystemOffset = 8;
+constexpr size_t uhScopeOffset = 9;
+constexpr size_t uhSeverityOffset = 10;
+constexpr size_t uhEventTypeOffset = 11;
+
+// ESELs are sometimes cut off right after the severity, so
+// that is as far as a PEL has to go.
+constexpr size_t minimumSize = privateHeaderSize + uhSeverityOffset + 1;
+
+// Each byte in the text is "BB "
+constexpr size_t charsPerByte = 3;
+
+/**
+ * A table of hex digit values, where anything that
+ * isn't a hex digit is 0xF.
+ */
+constexpr auto nibbleTable = []() {
+    std::array<uint8_t, 256> table{};
+    for (size_t c = 0; c < table.size(); c++)
+    {
+        if ((c >= '0') && (c <= '9'))
+        {
+            table[c] = c - '0';
+        }
+        else if ((c >= 'a') && (c <= 'f'))
+        {
+            table[c] = c - 'a' + 10;
+        }
+        else if ((c >= 'A') && (c <= 'F'))
+        {
+            table[c] = c - 'A' + 10;
+        }
+        else
+        {
+            table[c] = 0xF;
+        }
+    }
+    return table;
+}();
+
+/**
+ * Returns the value of a hex digit
+ *
+ * @param[in] c - the character
+ *
+ * @return uint8_t - the value, 0xF if not a hex digit
+ */
+static inline uint8_t nibble(char c)
+{
+    return nibbleTable[static_cast<uint8_t>(c)];
+}
+
+/**
+ * The number of bytes that can be decoded from the text into
+ * the output.  A byte only needs its first digit to be there.
+ *
+ * @param[in] text - the hex text
+ * @param[in] bytes - the output
+ *
+ * @return size_t - the number of bytes
+ */
+static inline size_t decodeSize(std::string_view text,
+                                std::span<uint8_t> bytes)
+{
+    return std::min(bytes.size(),
+                    (text.size() + charsPerByte - 1) / charsPerByte);
+}
+
+size_t decodeHexScalar(std::string_view text, std::span<uint8_t> bytes)
+{
+    auto size = decodeSize(text, bytes);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        auto pos = i * charsPerByte;
+        uint8_t low = (pos + 1 < text.size()) ? nibble(text[pos + 1]) : 0xF;
+        bytes[i] = (nibble(text[pos]) << 4) | low;
+    }
+
+    return size;
+}
+
+#if defined(__SSSE3__)
+
+/**
+ * Converts 16 characters to their hex digit values, the
+ * same as nibble().
+ *
+ * @param[in] c - the characters
+ *
+ * @return __m128i - the values
+ */
+static inline __m128i nibbles(__m128i c)
+{
+    // Unsigned x <= max is min(x, max) == x
+    auto digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    auto isDigit =
+        _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+
+    auto alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)),
+                              _mm_set1_epi8('a'));
+    auto isAlpha =
+        _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+
+    auto value = _mm_or_si128(
+        _mm_and_si128(isDigit, digit),
+        _mm_and_si128(isAlpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+
+    return _mm_or_si128(value, _mm_andnot_si128(_mm_or_si128(isDigit, isAlpha),
+                                                _mm_set1_epi8(0xF)));
+}
+
+/**
+ * Decodes as many 16 byte blocks as there is text and room for.
+ *
+ * The 48 characters for a block are converted to digit values, and
+ * each one is combined with the one after it, so every third byte
+ * of the result is a decoded byte, which are then shuffled together.
+ * Plain SSE2 can't do that shuffle, and picking them out one at a
+ * time is slower than the scalar version, so it isn't used.
+ *
+ * @param[in] text - the hex text
+ * @param[out] bytes - where to write the decoded bytes
+ *
+ * @return size_t - the number of bytes decoded
+ */
+static size_t decodeBlocks(std::string_view text, std::span<uint8_t> bytes)
+{
+    constexpr size_t block = 16;
+    size_t i = 0;
+
+    for (; (i + block <= bytes.size()) &&
+           ((i + block) * charsPerByte <= text.size());
+         i += block)
+    {
+        const auto* in =
+            reinterpret_cast<const __m128i*>(text.data() + i * charsPerByte);
+
+        __m128i values[charsPerByte];
+        for (size_t v = 0; v < charsPerByte; v++)
+        {
+            values[v] = nibbles(_mm_loadu_si128(in + v));
+        }
+
+        // Digits are at most 0xF, so shifting the 16 bit lanes
+        // doesn't carry into the next byte.
+        __m128i pairs[charsPerByte];
+        for (size_t v = 0; v < charsPerByte; v++)
+        {
+            auto next = _mm_srli_si128(values[v], 1);
+            if (v + 1 < charsPerByte)
+            {
+                next = _mm_or_si128(next, _mm_slli_si128(values[v + 1], 15));
+            }
+            pairs[v] = _mm_or_si128(_mm_slli_epi16(values[v], 4), next);
+        }
+
+        // Bytes 0, 3, ... 15 of the first vector, 2, 5, ... 14 of the
+        // second, and 1, 4, ... 13 of the third.
+        const auto first = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1,
+                                         -1, -1, -1, -1, -1, -1);
+        const auto second = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11,
+                                          14, -1, -1, -1, -1, -1);
+        const auto third = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                         -1, -1, 1, 4, 7, 10, 13);
+
+        auto out = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(pairs[0], first),
+                         _mm_shuffle_epi8(pairs[1], second)),
+            _mm_shuffle_epi8(pairs[2], third));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes.data() + i), out);
+    }
+
+    return i;
+}
+
+#elif defined(__ARM_NEON)
+
+/**
+ * Converts 16 characters to their hex digit values, the
+ * same as nibble().
+ *
+ * @param[in] c - the characters
+ *
+ * @return uint8x16_t - the values
+ */
+static inline uint8x16_t nibbles(uint8x16_t c)
+{
+    auto digit = vsubq_u8(c, vdupq_n_u8('0'));
+    auto isDigit = vcleq_u8(digit, vdupq_n_u8(9));
+
+    auto alpha = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    auto isAlpha = vcleq_u8(alpha, vdupq_n_u8(5));
+
+    return vbslq_u8(isDigit, digit,
+                    vbslq_u8(isAlpha, vaddq_u8(alpha, vdupq_n_u8(10)),
+                             vdupq_n_u8(0xF)));
+}
+
+/**
+ * Decodes as many 16 byte blocks as there is text and room for.
+ *
+ * vld3q_u8 splits every third character out into its own vector,
+ * so the high digits, low digits, and spaces come out separately.
+ *
+ * @param[in] text - the hex text
+ * @param[out] bytes - where to write the decoded bytes
+ *
+ * @return size_t - the number of bytes decoded
+ */
+static size_t decodeBlocks(std::string_view text, std::span<uint8_t> bytes)
+{
+    constexpr size_t block = 16;
+    size_t i = 0;
+
+    for (; (i + block <= bytes.size()) &&
+           ((i + block) * charsPerByte <= text.size());
+         i += block)
+    {
+        auto chars = vld3q_u8(
+            reinterpret_cast<const uint8_t*>(text.data()) + i * charsPerByte);
+
+        auto high = nibbles(chars.val[0]);
+        auto low = nibbles(chars.val[1]);
+
+        vst1q_u8(bytes.data() + i, vorrq_u8(vshlq_n_u8(high, 4), low));
+    }
+
+    return i;
+}
+
+#else
+
+static size_t decodeBlocks(std::string_view /*text*/,
+                           std::span<uint8_t> /*bytes*/)
+{
+    return 0;
+}
+
+#endif
+
+size_t decodeHex(std::string_view text, std::span<uint8_t> bytes)
+{
+    auto size = decodeSize(text, bytes);
+    auto done = decodeBlocks(text, bytes.first(size));
+
+    return done + decodeHexScalar(text.substr(done * charsPerByte),
+                                  bytes.subspan(done, size - done));
+}
+
+std::optional<Header> parse(std::span<const uint8_t> data)
+{
+    if (data.size() < minimumSize)
+    {
+        return {};
+    }
+
+    auto uh = data.subspan(privateHeaderSize);
+    if ((uh[0] != 'U') || (uh[1] != 'H'))
+    {
+        return {};
+    }
+
+    Header header;
+
+    if ((data[0] == 'P') && (data[1] == 'H'))
+    {
+        header.creatorID = data[phCreatorOffset];
+
+        const auto* plid = &data[phPLIDOffset];
+        header.plid = (plid[0] << 24) | (plid[1] << 16) | (plid[2] << 8) |
+                      plid[3];
+    }
+
+    header.subsystem = uh[uhSubsystemOffset];
+    header.scope = uh[uhScopeOffset];
+    header.severity = uh[uhSeverityOffset];
+
+    if (uh.size() > uhEventTypeOffset)
+    {
+        header.eventType = uh[uhEventTypeOffset];
+    }
+
+    return header;
+}
+
+std::optional<Header> parseESEL(std::string_view esel)
+{
+    std::array<uint8_t, eselHeaderSize + headersSize> bytes;
+
+    auto size = decodeHex(esel, bytes);
+    if (size <= eselHeaderSize)
+    {
+        return {};
+    }
+
+    return parse(std::span{bytes}.subspan(eselHeaderSize,
+                                          size - eselHeaderSize));
+}
+
+std::optional<Header> parseFile(std::string_view path)
+{
+    // open() needs it null terminated
+    std::array<char, PATH_MAX> name;
+    if (path.empty() || (path.size() >= name.size()))
+    {
+        return {};
+    }
+    *std::copy(path.begin(), path.end(), name.begin()) = '\0';
+
+    int fd = open(name.data(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return {};
+    }
+
+    std::optional<Header> header;
+    struct stat st;
+
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+    {
+        auto size = std::min(static_cast<size_t>(st.st_size), headersSize);
+
+        auto* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            header = parse({static_cast<const uint8_t*>(data), size});
+            munmap(data, size);
+        }
+    }
+
+    close(fd);
+    return header;
+}
+
+std::string_view severityName(uint8_t severity)
+{
+    switch (severity >> 4)
+    {
+        case 0x1:
+            return "Informational";
+        case 0x2:
+            return "Warning";
+        default:
+            return "Critical";
+    }
+}
+
+} // namespace pel
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace ibm
+{
+namespace logging
+{
+namespace pel
+{
+
+/**
+ * The size of the SEL header that comes before the PEL in an ESEL
+ */
+constexpr size_t eselHeaderSize = 16;
+
+/**
+ * The size of the Private Header section, which the
+ * User Header section follows.
+ */
+constexpr size_t privateHeaderSize = 48;
+
+/**
+ * The size of the User Header section
+ */
+constexpr size_t userHeaderSize = 24;
+
+/**
+ * The number of bytes from the start of a PEL that parse() needs
+ */
+constexpr size_t headersSize = privateHeaderSize + userHeaderSize;
+
+/**
+ * @struct Header
+ *
+ * The fields from the Private Header and User Header sections
+ * of a PEL, which stands for 'Platform Event Log' and is an IBM
+ * standard for error logging that OpenPower host firmware uses.
+ *
+ * It's small and has no pointers into the PEL, so it can be
+ * kept around for a log after the PEL data is gone.
+ */
+struct Header
+{
+    /**
+     * From the Private Header
+     */
+    uint8_t creatorID = 0;
+    uint32_t plid = 0;
+
+    /**
+     * From the User Header
+     */
+    uint8_t subsystem = 0;
+    uint8_t scope = 0;
+    uint8_t severity = 0;
+    uint8_t eventType = 0;
+
+    bool operator==(const Header& other) const = default;
+};
+
+/**
+ * Decodes the space separated hex text form of a PEL, like
+ * "00 11 22 33 4e ff", into bytes.  Every byte is expected to be
+ * 3 characters apart.  A character that isn't a hex digit is
+ * decoded as 0xF, so a bad byte ends up looking like a critical
+ * severity instead of a valid one.
+ *
+ * Only as many bytes as fit in the output are decoded, so
+ * callers that only need the headers don't pay for the rest.
+ *
+ * Uses SSSE3 or NEON when the compiler targets them.
+ *
+ * @param[in] text - the hex text
+ * @param[out] bytes - where to write the decoded bytes
+ *
+ * @return size_t - the number of bytes decoded
+ */
+size_t decodeHex(std::string_view text, std::span<uint8_t> bytes);
+
+/**
+ * The portable version of decodeHex(), which it uses for
+ * whatever is left over after the vectorized part.
+ *
+ * @param[in] text - the hex text
+ * @param[out] bytes - where to write the decoded bytes
+ *
+ * @return size_t - the number of bytes decoded
+ */
+size_t decodeHexScalar(std::string_view text, std::span<uint8_t> bytes);
+
+/**
+ * Parses the headers out of a binary PEL.
+ *
+ * @param[in] data - the PEL, starting with the Private Header
+ *
+ * @return optional<Header> - the headers, or empty if the data is too
+ *                            short or the User Header isn't there.
+ */
+std::optional<Header> parse(std::span<const uint8_t> data);
+
+/**
+ * Parses the headers out of the hex text form of an ESEL, which is
+ * a 16 byte SEL header followed by the PEL.  Only the part of the
+ * text that holds the headers is decoded.
+ *
+ * @param[in] esel - the ESEL text, like "00 11 22 33 4e ff"
+ *
+ * @return optional<Header> - the headers, or empty if the data is too
+ *                            short or the User Header isn't there.
+ */
+std::optional<Header> parseESEL(std::string_view esel);
+
+/**
+ * Parses the headers out of a binary PEL file, like the ones
+ * the RAWPEL AdditionalData item points to.  Only the start of
+ * the file is mapped, and it is parsed in place.
+ *
+ * @param[in] path - the file path
+ *
+ * @return optional<Header> - the headers, or empty if the file can't
+ *                            be read or doesn't have them.
+ */
+std::optional<Header> parseFile(std::string_view path);
+
+/**
+ * Returns a string version of a User Header severity.  Only the
+ * first nibble is used, which signifies the type - 'Recovered',
+ * 'Predictive', 'Critical', etc.
+ *
+ *  type value   |   type     |  returned severity string
+ *  ------------------------------------
+ *  1                Recovered   Informational
+ *  2                Predictive  Warning
+ *  everything else  na          Critical
+ *
+ * @param[in] severity - the User Header severity byte
+ *
+ * @return string_view - the severity string as listed above
+ */
+std::string_view severityName(uint8_t severity);
+
+} // namespace pel
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,275 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "persist_worker.hpp"
+
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <csignal>
+#include <stdexcept>
+
+namespace ibm
+{
+namespace logging
+{
+
+using namespace phosphor::logging;
+
+PersistWorker::PersistWorker(CalloutStore& store, sd_event* event,
+                             Callback callback, size_t capacity) :
+    store(store), callback(std::move(callback)), capacity(capacity)
+{
+    if (event)
+    {
+        eventFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (eventFD < 0)
+        {
+            throw std::runtime_error{"eventfd failed"};
+        }
+
+        sd_event_source* eventSource = nullptr;
+        auto rc = sd_event_add_io(event, &eventSource, eventFD, EPOLLIN,
+                                  handleResults, this);
+        if (rc < 0)
+        {
+            close(eventFD);
+            throw std::runtime_error{"sd_event_add_io failed"};
+        }
+        source.reset(eventSource);
+    }
+
+    // The worker never handles signals, so start it with them all
+    // blocked, in case a signal the caller handles on its event
+    // loop isn't blocked yet.  The thread inherits the mask.
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    thread = std::thread{&PersistWorker::run, this};
+
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+}
+
+PersistWorker::~PersistWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    workReady.notify_one();
+    thread.join();
+
+    source.reset();
+    if (eventFD >= 0)
+    {
+        close(eventFD);
+    }
+}
+
+void PersistWorker::append(CalloutRecord record)
+{
+    submit({Change::Type::append, std::move(record)});
+}
+
+void PersistWorker::erase(uint32_t entryID)
+{
+    Change change{Change::Type::erase, {}};
+    change.record.entryID = entryID;
+    submit(std::move(change));
+}
+
+void PersistWorker::submit(Change change)
+{
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        spaceReady.wait(lock, [this] { return queue.size() < capacity; });
+
+        queue.push_back(std::move(change));
+        submitted++;
+    }
+    workReady.notify_one();
+}
+
+void PersistWorker::flush()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    auto target = submitted;
+    batchDone.wait(lock, [this, target] { return done >= target; });
+}
+
+void PersistWorker::run()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+
+    while (true)
+    {
+        workReady.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+        {
+            break;
+        }
+
+        // Everything queued goes in one batch
+        std::deque<Change> batch;
+        batch.swap(queue);
+        spaceReady.notify_all();
+
+        lock.unlock();
+        auto results = commit(batch);
+        lock.lock();
+
+        done += batch.size();
+        unreported.committed += results.committed;
+        unreported.failed += results.failed;
+        unreported.fileSize = results.fileSize;
+        unreported.liveSize = results.liveSize;
+        batchDone.notify_all();
+
+        if (eventFD >= 0)
+        {
+            uint64_t one = 1;
+            if (::write(eventFD, &one, sizeof(one)) < 0)
+            {
+                log<level::ERR>("Failed writing the persist eventfd",
+                                entry("ERRNO=%d", errno));
+            }
+        }
+
+        // Compact while there's nothing else to do
+        if (queue.empty() && !stopping && store.needsCompaction())
+        {
+            lock.unlock();
+            try
+            {
+                store.compact();
+            }
+            catch (const std::exception& e)
+            {
+                log<level::ERR>("Failed compacting the callout log",
+                                entry("ERROR=%s", e.what()));
+            }
+            lock.lock();
+        }
+
+        if (queue.empty() && (store.indexLag() >= CalloutStore::maxIndexLag))
+        {
+            lock.unlock();
+            saveIndex();
+            lock.lock();
+        }
+    }
+
+    // So the next startup has none of the log to read
+    // past the index.
+    lock.unlock();
+    if (store.indexLag() > 0)
+    {
+        saveIndex();
+    }
+}
+
+void PersistWorker::saveIndex()
+{
+    try
+    {
+        store.saveIndex();
+    }
+    catch (const std::exception& e)
+    {
+        log<level::ERR>("Failed saving the callout restore index",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+PersistWorker::Results PersistWorker::commit(const std::deque<Change>& batch)
+{
+    Results results;
+
+    for (const auto& change : batch)
+    {
+        try
+        {
+            if (change.type == Change::Type::append)
+            {
+                store.append(change.record);
+            }
+            else
+            {
+                store.erase(change.record.entryID);
+            }
+            results.committed++;
+        }
+        catch (const std::exception& e)
+        {
+            log<level::ERR>("Failed saving a callout change",
+                            entry("ENTRY_ID=%u", change.record.entryID),
+                            entry("ERROR=%s", e.what()));
+            results.failed++;
+        }
+    }
+
+    try
+    {
+        store.sync();
+    }
+    catch (const std::exception& e)
+    {
+        log<level::ERR>("Failed syncing callout changes",
+                        entry("COUNT=%zu", batch.size()),
+                        entry("ERROR=%s", e.what()));
+        results.failed += results.committed;
+        results.committed = 0;
+    }
+
+    results.fileSize = store.fileSize();
+    results.liveSize = store.liveSize();
+
+    return results;
+}
+
+int PersistWorker::handleResults(sd_event_source* /*source*/, int fd,
+                                 uint32_t /*revents*/, void* data)
+{
+    auto worker = static_cast<PersistWorker*>(data);
+
+    uint64_t count = 0;
+    if (::read(fd, &count, sizeof(count)) < 0)
+    {
+        return 0;
+    }
+
+    Results results;
+    {
+        std::lock_guard<std::mutex> lock{worker->mutex};
+        results = worker->unreported;
+        worker->unreported = Results{};
+    }
+
+    if (worker->callback)
+    {
+        worker->callback(results);
+    }
+
+    return 0;
+}
+
+} // namespace logging
+} // namespace ibm
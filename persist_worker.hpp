@@ -0,0 +1,239 @@
+#pragma once
+
+#include "callout_store.hpp"
+
+#include <systemd/sd-event.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * @class PersistWorker
+ *
+ * Writes to a CalloutStore from a thread of its own, so that saving
+ * and deleting callouts never blocks the D-Bus thread on the flash.
+ *
+ * Changes are queued in order, and the worker applies everything
+ * that is queued as one batch followed by a single sync, so a burst
+ * of changes, like deleting all logs, costs one sync instead of one
+ * per log.  The queue is bounded, and adding to a full queue waits
+ * for the worker to catch up.
+ *
+ * After each batch, the results are passed to a callback on the
+ * sd_event loop.  Compacting the store and saving its restore index
+ * are done by the worker too, when the queue is empty, and the index
+ * is saved once more when the worker stops.
+ *
+ * Once the first change is queued, the store must only be used
+ * through the worker.
+ */
+class PersistWorker
+{
+  public:
+    /**
+     * The outcome of a batch
+     */
+    struct Results
+    {
+        // The changes that were saved
+        uint64_t committed = 0;
+
+        // The changes that failed
+        uint64_t failed = 0;
+
+        // The store's file and live sizes afterwards
+        uint64_t fileSize = 0;
+        uint64_t liveSize = 0;
+    };
+
+    /**
+     * The function called on the event loop after a batch
+     */
+    using Callback = std::function<void(const Results&)>;
+
+    PersistWorker() = delete;
+    PersistWorker(const PersistWorker&) = delete;
+    PersistWorker& operator=(const PersistWorker&) = delete;
+    PersistWorker(PersistWorker&&) = delete;
+    PersistWorker& operator=(PersistWorker&&) = delete;
+
+    /**
+     * Constructor
+     *
+     * Starts the worker thread, with all signals blocked.
+     *
+     * @param[in] store - the store to write to
+     * @param[in] event - the event loop to report results on, or
+     *                    nullptr to not report them.
+     * @param[in] callback - the function to pass the results to
+     * @param[in] capacity - the most changes that can be queued
+     */
+    PersistWorker(CalloutStore& store, sd_event* event, Callback callback,
+                  size_t capacity = defaultCapacity);
+
+    /**
+     * Destructor
+     *
+     * Saves everything still queued, and the restore index,
+     * before stopping the thread.
+     */
+    ~PersistWorker();
+
+    /**
+     * Queues a callout to be saved
+     *
+     * @param[in] record - the callout
+     */
+    void append(CalloutRecord record);
+
+    /**
+     * Queues the deletion of an error log's callouts
+     *
+     * @param[in] entryID - the error log's ID
+     */
+    void erase(uint32_t entryID);
+
+    /**
+     * Waits until everything queued so far has been saved
+     */
+    void flush();
+
+    /**
+     * The default queue size
+     */
+    static constexpr size_t defaultCapacity = 1024;
+
+  private:
+    /**
+     * A queued change
+     */
+    struct Change
+    {
+        enum class Type
+        {
+            append,
+            erase
+        };
+
+        Type type;
+        CalloutRecord record; // Only the entry ID is used for erase
+    };
+
+    /**
+     * Adds a change to the queue, waiting for room if it's full
+     *
+     * @param[in] change - the change
+     */
+    void submit(Change change);
+
+    /**
+     * The worker thread
+     */
+    void run();
+
+    /**
+     * Applies and syncs a batch of changes
+     *
+     * @param[in] batch - the changes
+     *
+     * @return Results - how it went
+     */
+    Results commit(const std::deque<Change>& batch);
+
+    /**
+     * Saves the store's restore index, logging any failure
+     */
+    void saveIndex();
+
+    /**
+     * The sd_event callback for the worker's eventfd
+     */
+    static int handleResults(sd_event_source* source, int fd,
+                             uint32_t revents, void* data);
+
+    /**
+     * The store
+     */
+    CalloutStore& store;
+
+    /**
+     * The function to pass results to
+     */
+    Callback callback;
+
+    /**
+     * The most changes that can be queued
+     */
+    const size_t capacity;
+
+    /**
+     * Guards everything below that the threads share
+     */
+    std::mutex mutex;
+
+    /**
+     * Signalled when there are changes or it's time to stop
+     */
+    std::condition_variable workReady;
+
+    /**
+     * Signalled when a batch has been taken off the queue
+     */
+    std::condition_variable spaceReady;
+
+    /**
+     * Signalled when a batch has been committed
+     */
+    std::condition_variable batchDone;
+
+    /**
+     * The changes waiting for the worker
+     */
+    std::deque<Change> queue;
+
+    /**
+     * The number of changes queued and committed since the start,
+     * for flush().
+     */
+    uint64_t submitted = 0;
+    uint64_t done = 0;
+
+    /**
+     * The results not passed to the callback yet
+     */
+    Results unreported;
+
+    /**
+     * If the thread should stop once the queue is empty
+     */
+    bool stopping = false;
+
+    /**
+     * Wakes up the event loop when there are results
+     */
+    int eventFD = -1;
+
+    /**
+     * The event source for eventFD
+     */
+    std::unique_ptr<sd_event_source, decltype(&sd_event_source_unref)>
+        source{nullptr, sd_event_source_unref};
+
+    /**
+     * The worker thread, started last
+     */
+    std::thread thread;
+};
+
+} // namespace logging
+} // namespace ibm
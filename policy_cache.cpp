@@ -0,0 +1,162 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "policy_cache.hpp"
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+Cache::Cache(size_t capacity) : capacity(capacity)
+{
+    slots.reserve(capacity);
+    index.reserve(capacity);
+}
+
+FindResult Cache::find(const Table& table, std::string_view error,
+                       std::string_view modifier)
+{
+    if (capacity == 0)
+    {
+        missCount++;
+        return table.find(error, modifier);
+    }
+
+    if (table.id() != tableID)
+    {
+        clear();
+        tableID = table.id();
+    }
+
+    Key key{error, modifier};
+
+    auto entry = index.find(key);
+    if (entry != index.end())
+    {
+        hitCount++;
+        touch(entry->second);
+
+        return slots[entry->second].details;
+    }
+
+    missCount++;
+
+    auto result = table.find(error, modifier);
+    insert(key, result);
+
+    return result;
+}
+
+void Cache::clear()
+{
+    index.clear();
+    slots.clear();
+    head = none;
+    tail = none;
+}
+
+void Cache::unlink(uint32_t slot)
+{
+    auto& s = slots[slot];
+
+    if (s.prev != none)
+    {
+        slots[s.prev].next = s.next;
+    }
+    else
+    {
+        head = s.next;
+    }
+
+    if (s.next != none)
+    {
+        slots[s.next].prev = s.prev;
+    }
+    else
+    {
+        tail = s.prev;
+    }
+}
+
+void Cache::touch(uint32_t slot)
+{
+    if (head == slot)
+    {
+        return;
+    }
+
+    unlink(slot);
+
+    slots[slot].prev = none;
+    slots[slot].next = head;
+    if (head != none)
+    {
+        slots[head].prev = slot;
+    }
+    head = slot;
+
+    if (tail == none)
+    {
+        tail = slot;
+    }
+}
+
+void Cache::insert(const Key& key, const FindResult& details)
+{
+    uint32_t slot;
+
+    if (slots.size() < capacity)
+    {
+        slot = slots.size();
+        slots.push_back({std::string{key.error}, std::string{key.modifier},
+                         details, none, none});
+
+        // Link it in at the back, touch() moves it to the front
+        slots[slot].prev = tail;
+        if (tail != none)
+        {
+            slots[tail].next = slot;
+        }
+        tail = slot;
+        if (head == none)
+        {
+            head = slot;
+        }
+
+        index.emplace(slots[slot].key(), slot);
+    }
+    else
+    {
+        // Recycle the least recently used slot and its index node
+        slot = tail;
+        auto node = index.extract(slots[slot].key());
+
+        slots[slot].error.assign(key.error);
+        slots[slot].modifier.assign(key.modifier);
+        slots[slot].details = details;
+
+        node.key() = slots[slot].key();
+        index.insert(std::move(node));
+    }
+
+    touch(slot);
+}
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
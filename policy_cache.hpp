@@ -0,0 +1,195 @@
+#pragma once
+
+#include "policy_table.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+/**
+ * @class Cache
+ *
+ * A bounded, least recently used cache of policy table lookups,
+ * keyed on the error message and search modifier.  Lookups that
+ * didn't find anything are cached too.
+ *
+ * The cached results point into the table they came from, so the
+ * cache clears itself when it is used with a different table, such
+ * as after the table is reloaded.
+ *
+ * Once the cache is full, entries are recycled in place, so steady
+ * state lookups don't allocate.
+ */
+class Cache
+{
+  public:
+    Cache() = delete;
+    Cache(const Cache&) = delete;
+    Cache& operator=(const Cache&) = delete;
+    Cache(Cache&&) = delete;
+    Cache& operator=(Cache&&) = delete;
+    ~Cache() = default;
+
+    /**
+     * Constructor
+     *
+     * @param[in] capacity - the maximum number of entries.  0
+     *                       disables the cache.
+     */
+    explicit Cache(size_t capacity);
+
+    /**
+     * Finds an entry in the policy table, using the cached
+     * result if there is one.
+     *
+     * @param[in] table - the policy table
+     * @param[in] error - the error, like xyz.openbmc_project.Error.X
+     * @param[in] modifier - the search modifier
+     *
+     * @return FindResult - the same result as Table::find()
+     */
+    FindResult find(const Table& table, std::string_view error,
+                    std::string_view modifier);
+
+    /**
+     * Removes all entries
+     */
+    void clear();
+
+    /**
+     * The number of lookups found in the cache
+     *
+     * @return uint64_t
+     */
+    inline uint64_t hits() const
+    {
+        return hitCount;
+    }
+
+    /**
+     * The number of lookups that went to the table
+     *
+     * @return uint64_t
+     */
+    inline uint64_t misses() const
+    {
+        return missCount;
+    }
+
+    /**
+     * The number of entries in the cache
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return index.size();
+    }
+
+  private:
+    /**
+     * The cache key, pointing either at the caller's
+     * strings or the strings in a slot.
+     */
+    struct Key
+    {
+        std::string_view error;
+        std::string_view modifier;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            auto h = std::hash<std::string_view>{}(key.error);
+            return h ^ (std::hash<std::string_view>{}(key.modifier) +
+                        0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+        }
+    };
+
+    static constexpr uint32_t none = UINT32_MAX;
+
+    /**
+     * A cache entry, which is also a node in the LRU list
+     */
+    struct Slot
+    {
+        std::string error;
+        std::string modifier;
+        FindResult details; // empty if not in the table
+        uint32_t prev;
+        uint32_t next;
+
+        inline Key key() const
+        {
+            return {error, modifier};
+        }
+    };
+
+    /**
+     * Moves a slot to the front of the LRU list
+     *
+     * @param[in] slot - the slot index
+     */
+    void touch(uint32_t slot);
+
+    /**
+     * Removes a slot from the LRU list
+     *
+     * @param[in] slot - the slot index
+     */
+    void unlink(uint32_t slot);
+
+    /**
+     * Adds a lookup result to the cache, reusing the least
+     * recently used slot if the cache is full.
+     *
+     * @param[in] key - the lookup key
+     * @param[in] details - the lookup result
+     */
+    void insert(const Key& key, const FindResult& details);
+
+    /**
+     * The maximum number of entries
+     */
+    const size_t capacity;
+
+    /**
+     * The entries.  Reserved up front so the strings never move.
+     */
+    std::vector<Slot> slots;
+
+    /**
+     * The entries, keyed on views of their own strings
+     */
+    std::unordered_map<Key, uint32_t, KeyHash> index;
+
+    /**
+     * The most and least recently used slots
+     */
+    uint32_t head = none;
+    uint32_t tail = none;
+
+    /**
+     * The ID of the table the entries came from
+     */
+    uint64_t tableID = 0;
+
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+};
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
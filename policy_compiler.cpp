@@ -0,0 +1,93 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "policy_image.hpp"
+
+#include <getopt.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * Compiles the error policy table into the binary image that
+ * ibm-log-manager maps at startup.
+ *
+ * The input can either be the full service policy table or the
+ * output of condense_policy.py.  When there is more than one input,
+ * such as a base table and a platform overlay, they are merged with
+ * the later ones overriding the earlier ones.
+ */
+
+static void usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "Options:\n"
+              << "    -p, --policy <file>  Policy table in JSON.  Repeat to\n"
+              << "                         merge overlays onto it\n"
+              << "    -o, --output <file>  Compiled policy image output\n";
+}
+
+int main(int argc, char** argv)
+{
+    static const option options[] = {{"policy", required_argument, 0, 'p'},
+                                     {"output", required_argument, 0, 'o'},
+                                     {"help", no_argument, 0, 'h'},
+                                     {0, 0, 0, 0}};
+
+    std::vector<std::string> policyFiles;
+    std::string imageFile{"policy.bin"};
+
+    int arg;
+    while ((arg = getopt_long(argc, argv, "p:o:h", options, nullptr)) != -1)
+    {
+        switch (arg)
+        {
+            case 'p':
+                policyFiles.push_back(optarg);
+                break;
+            case 'o':
+                imageFile = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return (arg == 'h') ? 0 : 1;
+        }
+    }
+
+    if (policyFiles.empty())
+    {
+        policyFiles.push_back("policyTable.json");
+    }
+
+    try
+    {
+        auto overrides =
+            ibm::logging::policy::image::compile(policyFiles, imageFile);
+
+        if (policyFiles.size() > 1)
+        {
+            std::cout << "Merged " << policyFiles.size() << " files, "
+                      << overrides << " entries overridden\n";
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Failed compiling policy: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
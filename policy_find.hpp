@@ -1,6 +1,8 @@
 #pragma once
 
 #include "dbus.hpp"
+#include "modifier_rules.hpp"
+#include "policy_cache.hpp"
 #include "policy_table.hpp"
 
 #include <string>
@@ -28,6 +30,38 @@ using PolicyProps = std::tuple<std::string, std::string>;
  */
 PolicyProps find(const Table& policy,
                  const DbusPropertyMap& errorLogProperties);
+
+/**
+ * Finds the policy table details based on the properties
+ * in the xyz.openbmc_project.Logging.Entry interface, using
+ * and filling in a cache of table lookups.
+ *
+ * @param[in] policy - the policy table object
+ * @param[in] cache - the lookup cache
+ * @param[in] errorLogProperties - the map of the error log
+ *            properties for the xyz.openbmc_project.Logging.Entry
+ *            interface
+ * @return PolicyProps - a tuple of policy details.
+ */
+PolicyProps find(const Table& policy, Cache& cache,
+                 const DbusPropertyMap& errorLogProperties);
+
+/**
+ * Finds the policy table details based on the properties
+ * in the xyz.openbmc_project.Logging.Entry interface, using
+ * the passed in search modifier rules and a cache of table
+ * lookups.
+ *
+ * @param[in] policy - the policy table object
+ * @param[in] rules - the search modifier rules
+ * @param[in] cache - the lookup cache
+ * @param[in] errorLogProperties - the map of the error log
+ *            properties for the xyz.openbmc_project.Logging.Entry
+ *            interface
+ * @return PolicyProps - a tuple of policy details.
+ */
+PolicyProps find(const Table& policy, const Rules& rules, Cache& cache,
+                 const DbusPropertyMap& errorLogProperties);
 } // namespace policy
 } // namespace logging
 } // namespace ibm
@@ -0,0 +1,651 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "policy_image.hpp"
+
+#include "crc32.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <experimental/filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+namespace fs = std::experimental::filesystem;
+
+namespace image
+{
+
+/**
+ * Accumulates the strings section, only storing each
+ * unique string once.
+ */
+class StringSection
+{
+  public:
+    StringRef add(std::string_view value)
+    {
+        auto s = refs.find(value);
+        if (s != refs.end())
+        {
+            return s->second;
+        }
+
+        StringRef ref{static_cast<uint32_t>(data.size()),
+                      static_cast<uint32_t>(value.size())};
+        data.append(value);
+        refs.emplace(value, ref);
+        return ref;
+    }
+
+    const std::string& contents() const
+    {
+        return data;
+    }
+
+  private:
+    std::string data;
+
+    // The keys point into the caller's strings, which outlive this.
+    std::unordered_map<std::string_view, StringRef> refs;
+};
+
+/**
+ * Appends the raw bytes of a trivially copyable array to the image.
+ */
+template <typename T>
+void append(std::string& body, const std::vector<T>& values)
+{
+    body.append(reinterpret_cast<const char*>(values.data()),
+                values.size() * sizeof(T));
+}
+
+/**
+ * Returns the number of buckets to use for a hash table of count
+ * entries.  The load factor is kept at or under 50%, which also
+ * guarantees there is always an empty bucket to end a probe.
+ */
+static uint32_t bucketsFor(size_t count)
+{
+    uint32_t bucketCount = 1;
+    while (bucketCount <= count * 2)
+    {
+        bucketCount <<= 1;
+    }
+    return bucketCount;
+}
+
+/**
+ * Inserts a value into an open addressed hash table slice.
+ */
+static void insert(uint32_t* buckets, uint32_t bucketCount, uint64_t h,
+                   uint32_t value)
+{
+    auto b = h & (bucketCount - 1);
+    while (buckets[b] != emptyBucket)
+    {
+        b = (b + 1) & (bucketCount - 1);
+    }
+    buckets[b] = value;
+}
+
+void write(const std::string& imageFile, const PolicyMap& policies)
+{
+    StringSection strings;
+    std::vector<ErrorRecord> errors;
+    std::vector<DetailsRecord> details;
+    std::vector<uint32_t> modifierBuckets;
+
+    for (const auto& [error, detailsList] : policies)
+    {
+        ErrorRecord record;
+        record.name = strings.add(error);
+        record.firstDetails = details.size();
+        record.detailsCount = detailsList.size();
+        record.catchAll = emptyBucket;
+
+        // Only the first entry for a modifier is indexed, to match
+        // a front to back search.
+        std::unordered_map<std::string_view, uint32_t> modifiers;
+        for (const auto& d : detailsList)
+        {
+            uint32_t index = details.size();
+            details.push_back({strings.add(d.modifier), strings.add(d.msg),
+                               strings.add(d.ceid)});
+
+            if (d.modifier.empty())
+            {
+                if (record.catchAll == emptyBucket)
+                {
+                    record.catchAll = index;
+                }
+            }
+            else if (!modifierPrefix(d.modifier))
+            {
+                modifiers.emplace(d.modifier, index);
+            }
+        }
+
+        record.modifierBuckets = modifierBuckets.size();
+        record.modifierBucketCount = 0;
+        if (!modifiers.empty())
+        {
+            record.modifierBucketCount = bucketsFor(modifiers.size());
+            modifierBuckets.resize(modifierBuckets.size() +
+                                       record.modifierBucketCount,
+                                   emptyBucket);
+
+            for (const auto& [modifier, index] : modifiers)
+            {
+                insert(&modifierBuckets[record.modifierBuckets],
+                       record.modifierBucketCount, hash(modifier), index);
+            }
+        }
+
+        errors.push_back(record);
+    }
+
+    auto bucketCount = bucketsFor(errors.size());
+    std::vector<uint32_t> buckets(bucketCount, emptyBucket);
+    auto e = policies.begin();
+    for (uint32_t i = 0; i < errors.size(); i++, e++)
+    {
+        insert(buckets.data(), bucketCount, hash(e->first), i);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.errorCount = errors.size();
+    header.detailsCount = details.size();
+    header.bucketCount = bucketCount;
+    header.bucketsOffset = sizeof(Header);
+    header.modifierBucketCount = modifierBuckets.size();
+    header.modifierBucketsOffset = header.bucketsOffset +
+                                   bucketCount * sizeof(uint32_t);
+    header.errorsOffset = header.modifierBucketsOffset +
+                          modifierBuckets.size() * sizeof(uint32_t);
+    header.detailsOffset = header.errorsOffset +
+                           errors.size() * sizeof(ErrorRecord);
+    header.stringsOffset = header.detailsOffset +
+                           details.size() * sizeof(DetailsRecord);
+    header.stringsSize = strings.contents().size();
+    header.size = header.stringsOffset + header.stringsSize;
+
+    std::string body;
+    body.reserve(header.size - sizeof(Header));
+    append(body, buckets);
+    append(body, modifierBuckets);
+    append(body, errors);
+    append(body, details);
+    body.append(strings.contents());
+
+    header.checksum = crc32(body.data(), body.size());
+
+    auto tempFile = imageFile + ".tmp";
+    {
+        std::ofstream file{tempFile, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(body.data(), body.size());
+        file.close();
+
+        if (file.fail())
+        {
+            fs::remove(tempFile);
+            throw std::runtime_error{"Failed writing " + tempFile};
+        }
+    }
+
+    fs::rename(tempFile, imageFile);
+}
+
+/**
+ * Adds a details entry to an error in the policy map, after saving
+ * its text in the strings list.
+ */
+static void addDetails(std::deque<std::string>& text, PolicyMap& policies,
+                       const std::string& error, std::string&& modifier,
+                       std::string&& msg, std::string&& ceid)
+{
+    Details d;
+    d.modifier = text.emplace_back(std::move(modifier));
+    d.msg = text.emplace_back(std::move(msg));
+    d.ceid = text.emplace_back(std::move(ceid));
+
+    policies[error].push_back(d);
+}
+
+/**
+ * Reads a policy JSON file, in either format, into a policy map.
+ */
+static PolicyMap read(const std::string& jsonFile,
+                      std::deque<std::string>& text)
+{
+    std::ifstream file{jsonFile};
+    if (!file)
+    {
+        throw std::runtime_error{"Could not open " + jsonFile};
+    }
+
+    auto json = nlohmann::json::parse(file, nullptr, true);
+
+    PolicyMap policies;
+
+    if (json.is_object() && json.contains("events"))
+    {
+        // The full table, with entries keyed on error||modifier,
+        // where the modifier is optional.
+        for (const auto& [name, event] : json.at("events").items())
+        {
+            std::string error = name;
+            std::string modifier;
+
+            auto pos = name.find("||");
+            if (pos != std::string::npos)
+            {
+                error = name.substr(0, pos);
+                modifier = name.substr(pos + 2);
+            }
+
+            // The table has some non-BMC errors with spaces - skip them
+            if (error.find(' ') != std::string::npos)
+            {
+                continue;
+            }
+
+            addDetails(text, policies, error, std::move(modifier),
+                       event.at("Message").get<std::string>(),
+                       event.at("CommonEventID").get<std::string>());
+        }
+    }
+    else
+    {
+        // The condensed table.  Like Table::load(), only the
+        // first instance of an error is used.
+        for (const auto& policy : json)
+        {
+            auto error = policy.at("err").get<std::string>();
+            if (policies.find(error) != policies.end())
+            {
+                continue;
+            }
+
+            policies[error];
+            for (const auto& details : policy.at("dtls"))
+            {
+                addDetails(text, policies, error,
+                           details.at("mod").get<std::string>(),
+                           details.at("msg").get<std::string>(),
+                           details.at("CEID").get<std::string>());
+            }
+        }
+    }
+
+    return policies;
+}
+
+/**
+ * Merges an overlay's policies into the policies it overrides, the
+ * same way Table does.
+ *
+ * @return size_t - the number of entries that were replaced
+ */
+static size_t merge(PolicyMap& policies, PolicyMap&& overlay)
+{
+    size_t replaced = 0;
+
+    for (auto& [error, overlayDetails] : overlay)
+    {
+        auto& details = policies[error];
+        auto baseSize = details.size();
+        std::unordered_set<std::string_view> used;
+
+        for (const auto& d : overlayDetails)
+        {
+            auto base = std::find_if(
+                details.begin(), details.begin() + baseSize,
+                [&d](const auto& b) { return b.modifier == d.modifier; });
+
+            // Only the first overlay entry for a modifier replaces
+            // the base one, the rest are just kept in order.
+            if ((base != details.begin() + baseSize) &&
+                used.insert(d.modifier).second)
+            {
+                *base = d;
+                replaced++;
+            }
+            else
+            {
+                details.push_back(d);
+            }
+        }
+    }
+
+    return replaced;
+}
+
+void compile(const std::string& jsonFile, const std::string& imageFile)
+{
+    compile(std::vector<std::string>{jsonFile}, imageFile);
+}
+
+size_t compile(const std::vector<std::string>& jsonFiles,
+               const std::string& imageFile)
+{
+    std::deque<std::string> text;
+    PolicyMap policies;
+    size_t replaced = 0;
+
+    for (const auto& jsonFile : jsonFiles)
+    {
+        replaced += merge(policies, read(jsonFile, text));
+    }
+
+    write(imageFile, policies);
+
+    return replaced;
+}
+
+} // namespace image
+
+Image::Image(const std::string& imageFile)
+{
+    int fd = open(imageFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error{"Could not open policy image"};
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) ||
+        (static_cast<size_t>(st.st_size) < sizeof(image::Header)))
+    {
+        close(fd);
+        throw std::runtime_error{"Policy image is too small"};
+    }
+
+    size = st.st_size;
+    auto mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error{"Could not map policy image"};
+    }
+
+    data = static_cast<const uint8_t*>(mapping);
+
+    try
+    {
+        validate();
+    }
+    catch (const std::exception& e)
+    {
+        munmap(const_cast<uint8_t*>(data), size);
+        throw;
+    }
+}
+
+Image::~Image()
+{
+    munmap(const_cast<uint8_t*>(data), size);
+}
+
+/**
+ * Checks that an array of count elements of type T starting at
+ * offset fits in an image of the size passed in.
+ */
+template <typename T>
+static bool fits(uint32_t offset, uint32_t count, size_t size)
+{
+    return (offset % alignof(T) == 0) && (offset <= size) &&
+           (count <= (size - offset) / sizeof(T));
+}
+
+void Image::validate()
+{
+    header = reinterpret_cast<const image::Header*>(data);
+
+    if (std::memcmp(header->magic, image::magic, sizeof(image::magic)) ||
+        (header->version != image::version))
+    {
+        throw std::runtime_error{"Unsupported policy image version"};
+    }
+
+    if (header->size != size)
+    {
+        throw std::runtime_error{"Policy image size mismatch"};
+    }
+
+    if (header->checksum != crc32(data + sizeof(image::Header),
+                                  size - sizeof(image::Header)))
+    {
+        throw std::runtime_error{"Policy image checksum mismatch"};
+    }
+
+    if ((header->bucketCount == 0) ||
+        (header->bucketCount & (header->bucketCount - 1)) ||
+        (header->bucketCount <= header->errorCount) ||
+        !fits<uint32_t>(header->bucketsOffset, header->bucketCount, size) ||
+        !fits<uint32_t>(header->modifierBucketsOffset,
+                        header->modifierBucketCount, size) ||
+        !fits<image::ErrorRecord>(header->errorsOffset, header->errorCount,
+                                  size) ||
+        !fits<image::DetailsRecord>(header->detailsOffset,
+                                    header->detailsCount, size) ||
+        !fits<char>(header->stringsOffset, header->stringsSize, size))
+    {
+        throw std::runtime_error{"Invalid policy image layout"};
+    }
+
+    buckets = reinterpret_cast<const uint32_t*>(data + header->bucketsOffset);
+    modifierBuckets = reinterpret_cast<const uint32_t*>(
+        data + header->modifierBucketsOffset);
+    errors = reinterpret_cast<const image::ErrorRecord*>(
+        data + header->errorsOffset);
+    details = reinterpret_cast<const image::DetailsRecord*>(
+        data + header->detailsOffset);
+    strings = reinterpret_cast<const char*>(data + header->stringsOffset);
+
+    auto validString = [this](const image::StringRef& ref) {
+        return (ref.offset <= header->stringsSize) &&
+               (ref.size <= header->stringsSize - ref.offset);
+    };
+
+    for (uint32_t i = 0; i < header->bucketCount; i++)
+    {
+        if ((buckets[i] != image::emptyBucket) &&
+            (buckets[i] >= header->errorCount))
+        {
+            throw std::runtime_error{"Invalid policy image bucket"};
+        }
+    }
+
+    for (uint32_t i = 0; i < header->errorCount; i++)
+    {
+        const auto& error = errors[i];
+        if (!validString(error.name) ||
+            (error.firstDetails > header->detailsCount) ||
+            (error.detailsCount > header->detailsCount - error.firstDetails))
+        {
+            throw std::runtime_error{"Invalid policy image error record"};
+        }
+
+        auto inError = [&error](uint32_t index) {
+            return (index >= error.firstDetails) &&
+                   (index - error.firstDetails < error.detailsCount);
+        };
+
+        if ((error.catchAll != image::emptyBucket) && !inError(error.catchAll))
+        {
+            throw std::runtime_error{"Invalid policy image catch-all"};
+        }
+
+        const auto count = error.modifierBucketCount;
+        if ((count & (count - 1)) ||
+            (error.modifierBuckets > header->modifierBucketCount) ||
+            (count > header->modifierBucketCount - error.modifierBuckets))
+        {
+            throw std::runtime_error{"Invalid policy image modifier index"};
+        }
+
+        // There must be at least one empty bucket to end a probe
+        const auto* slice = modifierBuckets + error.modifierBuckets;
+        if (count && std::none_of(slice, slice + count, [](auto b) {
+                return b == image::emptyBucket;
+            }))
+        {
+            throw std::runtime_error{"Invalid policy image modifier index"};
+        }
+
+        for (auto b = 0U; b < count; b++)
+        {
+            if ((slice[b] != image::emptyBucket) && !inError(slice[b]))
+            {
+                throw std::runtime_error{"Invalid policy image modifier index"};
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < header->detailsCount; i++)
+    {
+        const auto& record = details[i];
+        if (!validString(record.modifier) || !validString(record.msg) ||
+            !validString(record.ceid))
+        {
+            throw std::runtime_error{"Invalid policy image details record"};
+        }
+    }
+
+    // Prefix modifiers aren't in the image's index, so build
+    // tries for the errors that have them.
+    for (uint32_t i = 0; i < header->errorCount; i++)
+    {
+        const auto& error = errors[i];
+        for (auto d = error.firstDetails;
+             d < error.firstDetails + error.detailsCount; d++)
+        {
+            auto prefix = modifierPrefix(string(details[d].modifier));
+            if (prefix)
+            {
+                prefixes[i].insert(*prefix, d);
+            }
+        }
+    }
+}
+
+std::optional<uint32_t> Image::findError(std::string_view error) const
+{
+    const uint32_t mask = header->bucketCount - 1;
+
+    for (auto b = image::hash(error) & mask; buckets[b] != image::emptyBucket;
+         b = (b + 1) & mask)
+    {
+        if (string(errors[buckets[b]].name) == error)
+        {
+            return buckets[b];
+        }
+    }
+
+    return {};
+}
+
+std::optional<Details> Image::find(std::string_view error,
+                                   std::string_view modifier) const
+{
+    auto index = findError(error);
+    if (index)
+    {
+        const auto& record = errors[*index];
+
+        if (!modifier.empty() && record.modifierBucketCount)
+        {
+            const auto* slice = modifierBuckets + record.modifierBuckets;
+            const uint32_t modMask = record.modifierBucketCount - 1;
+
+            for (auto m = image::hash(modifier) & modMask;
+                 slice[m] != image::emptyBucket; m = (m + 1) & modMask)
+            {
+                if (string(details[slice[m]].modifier) == modifier)
+                {
+                    return view(slice[m]);
+                }
+            }
+        }
+
+        if (!modifier.empty())
+        {
+            auto trie = prefixes.find(*index);
+            if (trie != prefixes.end())
+            {
+                auto prefix = trie->second.find(modifier);
+                if (prefix)
+                {
+                    return view(*prefix);
+                }
+            }
+        }
+
+        // If there is no exact modifier match, then use the entry with
+        // an empty modifier - it is the catch-all for that error.
+        if (record.catchAll != image::emptyBucket)
+        {
+            return view(record.catchAll);
+        }
+    }
+
+    return {};
+}
+
+DetailsList Image::errorDetails(std::string_view error) const
+{
+    DetailsList list;
+
+    auto index = findError(error);
+    if (index)
+    {
+        const auto& record = errors[*index];
+        list.reserve(record.detailsCount);
+
+        for (auto d = record.firstDetails;
+             d < record.firstDetails + record.detailsCount; d++)
+        {
+            list.push_back(view(d));
+        }
+    }
+
+    return list;
+}
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
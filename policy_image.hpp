@@ -0,0 +1,297 @@
+#pragma once
+
+#include "policy_table.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+namespace image
+{
+
+/**
+ * The layout of a compiled policy image.  All fields are in the
+ * byte order of the machine that compiled the image, which must
+ * match the BMC.  A mismatch shows up as a bad version and the
+ * image is rejected.
+ *
+ *   Header
+ *   uint32_t buckets[bucketCount]   - error hash index
+ *   uint32_t modifierBuckets[modifierBucketCount] - modifier hash indexes
+ *   ErrorRecord errors[errorCount]
+ *   DetailsRecord details[detailsCount]
+ *   char strings[stringsSize]
+ *
+ * The buckets are an open addressed (linear probing) hash table of
+ * indexes into the errors array, keyed by the FNV-1a hash of the
+ * error name.  Each error's details are contiguous in the details
+ * array and are kept in policy table order.
+ *
+ * Each error then has its own slice of modifierBuckets, which is a
+ * hash table of the same kind keyed on the modifier, holding the
+ * index into the details array of the first entry for each non-empty
+ * modifier.  The first entry with an empty modifier, the catch-all,
+ * is stored directly in the error record.
+ *
+ * Prefix modifiers, the ones ending in prefixWildcard, are left out
+ * of the modifier hash tables and indexed when the image is opened.
+ */
+constexpr char magic[8] = {'I', 'B', 'M', 'P', 'O', 'L', 'C', 'Y'};
+constexpr uint32_t version = 2;
+constexpr uint32_t emptyBucket = 0xFFFFFFFF;
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t checksum; // CRC-32 of everything after the header
+    uint32_t size;     // Size of the whole image
+    uint32_t errorCount;
+    uint32_t detailsCount;
+    uint32_t bucketCount; // Always a power of 2
+    uint32_t bucketsOffset;
+    uint32_t modifierBucketCount;
+    uint32_t modifierBucketsOffset;
+    uint32_t errorsOffset;
+    uint32_t detailsOffset;
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+};
+
+struct StringRef
+{
+    uint32_t offset; // From the start of the strings section
+    uint32_t size;
+};
+
+struct ErrorRecord
+{
+    StringRef name;
+    uint32_t firstDetails;
+    uint32_t detailsCount;
+    uint32_t catchAll;            // Details index, or emptyBucket
+    uint32_t modifierBuckets;     // First index into modifierBuckets
+    uint32_t modifierBucketCount; // 0, or a power of 2
+};
+
+struct DetailsRecord
+{
+    StringRef modifier;
+    StringRef msg;
+    StringRef ceid;
+};
+
+/**
+ * The hash used by the image index.  It must never change for
+ * a given image version.
+ *
+ * @param[in] value - the string to hash
+ *
+ * @return uint64_t - the FNV-1a hash
+ */
+inline uint64_t hash(std::string_view value)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (auto c : value)
+    {
+        h ^= static_cast<uint8_t>(c);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * Writes a compiled image of the policies to a file.
+ *
+ * The image is written to a temporary file first and then renamed,
+ * so a reader never sees a partial image.
+ *
+ * Throws std::runtime_error on failures.
+ *
+ * @param[in] imageFile - the file to write
+ * @param[in] policies - the policy table contents
+ */
+void write(const std::string& imageFile, const PolicyMap& policies);
+
+/**
+ * Compiles policy JSON files into a binary image.
+ *
+ * Accepts either the full service policy table, which has an
+ * "events" object keyed on "error||modifier", or the condensed
+ * format that condense_policy.py creates.
+ *
+ * Throws std::exception on failures.
+ *
+ * @param[in] jsonFile - the policy JSON file
+ * @param[in] imageFile - the image file to write
+ */
+void compile(const std::string& jsonFile, const std::string& imageFile);
+
+/**
+ * Merges policy JSON files, in either format, and compiles them
+ * into a binary image.  Entries in later files override earlier
+ * ones the same way as when Table merges them.
+ *
+ * Throws std::exception on failures.
+ *
+ * @param[in] jsonFiles - the policy JSON files, with the overrides
+ *                        after what they override
+ * @param[in] imageFile - the image file to write
+ *
+ * @return size_t - the number of entries that were overridden
+ */
+size_t compile(const std::vector<std::string>& jsonFiles,
+               const std::string& imageFile);
+
+} // namespace image
+
+/**
+ * @class Image
+ *
+ * A compiled policy image that is memory mapped read-only.  Lookups
+ * are done straight out of the mapping using the prebuilt index, so
+ * nothing has to be parsed or copied when it is opened beyond
+ * validating it.
+ */
+class Image
+{
+  public:
+    Image() = delete;
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+    Image(Image&&) = delete;
+    Image& operator=(Image&&) = delete;
+
+    /**
+     * Constructor
+     *
+     * Maps and validates the image.  Throws std::runtime_error if
+     * the file can't be mapped, or if it has the wrong version or
+     * a bad checksum.
+     *
+     * @param[in] imageFile - the path to the compiled image
+     */
+    explicit Image(const std::string& imageFile);
+
+    /**
+     * Destructor
+     *
+     * Unmaps the image.
+     */
+    ~Image();
+
+    /**
+     * Finds an entry in the image based on the error and the
+     * search modifier, using the same rules as Table::find().
+     *
+     * @param[in] error - the error, like xyz.openbmc_project.Error.X
+     * @param[in] modifier - the search modifier
+     *
+     * @return optional<Details> - views of the entry's strings
+     *                             in the image
+     */
+    std::optional<Details> find(std::string_view error,
+                                std::string_view modifier) const;
+
+    /**
+     * Returns all of an error's details entries, in policy
+     * table order.
+     *
+     * @param[in] error - the error, like xyz.openbmc_project.Error.X
+     *
+     * @return DetailsList - views of the entries' strings in the
+     *                       image, empty if the error isn't in it
+     */
+    DetailsList errorDetails(std::string_view error) const;
+
+    /**
+     * Returns the number of errors in the image
+     *
+     * @return size_t
+     */
+    inline size_t errorCount() const
+    {
+        return header->errorCount;
+    }
+
+  private:
+    /**
+     * Finds an error in the error hash index
+     *
+     * @param[in] error - the error
+     *
+     * @return optional<uint32_t> - the index into the errors array
+     */
+    std::optional<uint32_t> findError(std::string_view error) const;
+
+    /**
+     * Validates the header, the section bounds, and the bounds of
+     * every string reference.
+     */
+    void validate();
+
+    /**
+     * Returns a view of a string in the strings section
+     *
+     * @param[in] ref - the string reference
+     *
+     * @return string_view
+     */
+    inline std::string_view string(const image::StringRef& ref) const
+    {
+        return {strings + ref.offset, ref.size};
+    }
+
+    /**
+     * Returns the Details views of a details record
+     *
+     * @param[in] index - the index into the details array
+     *
+     * @return Details
+     */
+    inline Details view(uint32_t index) const
+    {
+        const auto& record = details[index];
+        return {string(record.modifier), string(record.msg),
+                string(record.ceid)};
+    }
+
+    /**
+     * The start of the mapping
+     */
+    const uint8_t* data = nullptr;
+
+    /**
+     * The size of the mapping
+     */
+    size_t size = 0;
+
+    /**
+     * The sections of the image
+     */
+    const image::Header* header = nullptr;
+    const uint32_t* buckets = nullptr;
+    const uint32_t* modifierBuckets = nullptr;
+    const image::ErrorRecord* errors = nullptr;
+    const image::DetailsRecord* details = nullptr;
+    const char* strings = nullptr;
+
+    /**
+     * The prefix modifiers of the errors that have any, keyed
+     * on the index into the errors array
+     */
+    std::unordered_map<uint32_t, PrefixTrie> prefixes;
+};
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
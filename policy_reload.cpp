@@ -0,0 +1,156 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "policy_reload.hpp"
+
+#include "crc32.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+#include <array>
+#include <fstream>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+using namespace phosphor::logging;
+
+Reloader::Reloader(const std::string& imageFile,
+                   const std::string& jsonFile) :
+    Reloader(imageFile, std::vector<std::string>{jsonFile})
+{}
+
+Reloader::Reloader(const std::string& imageFile,
+                   const std::vector<std::string>& jsonFiles) :
+    imageFile(imageFile), jsonFiles(jsonFiles),
+    table(std::make_shared<const Table>(imageFile, jsonFiles)),
+    hash(contentHash())
+{}
+
+Reloader::~Reloader()
+{
+    wait();
+}
+
+void Reloader::reload()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+
+    // If the worker is running, it will see this request
+    // before it stops.
+    requests++;
+    if (busy)
+    {
+        return;
+    }
+    busy = true;
+
+    // A previous worker may still be on its way out
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+
+    worker = std::thread{&Reloader::run, this};
+}
+
+void Reloader::wait()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+
+    // The worker only stops once it has handled every request
+    idle.wait(lock, [this] { return !busy; });
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+}
+
+void Reloader::run()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+
+    while (true)
+    {
+        auto handled = requests;
+        lock.unlock();
+
+        auto newHash = contentHash();
+        if (newHash != hash)
+        {
+            auto newTable =
+                std::make_shared<const Table>(imageFile, jsonFiles);
+
+            if (newTable->isLoaded())
+            {
+                table.store(std::move(newTable));
+                hash = newHash;
+                reloads++;
+
+                log<level::INFO>("Reloaded the policy table",
+                                 entry("GENERATION=%u", reloads.load()));
+            }
+            else
+            {
+                // Keep using the old table.  The hash isn't saved
+                // so the same contents are tried again next time.
+                log<level::ERR>("Failed reloading the policy table");
+            }
+        }
+
+        // Checked under the lock, so a request made while loading
+        // is either seen here or starts a new worker.
+        lock.lock();
+        if (requests == handled)
+        {
+            busy = false;
+            idle.notify_all();
+            break;
+        }
+    }
+}
+
+uint32_t Reloader::contentHash() const
+{
+    uint32_t crc = 0;
+    std::array<char, 65536> buffer;
+
+    std::vector<std::string> files{imageFile};
+    files.insert(files.end(), jsonFiles.begin(), jsonFiles.end());
+
+    for (const auto& file : files)
+    {
+        // Include the name so a file moving from one
+        // path to the other is a change.
+        crc = crc32(file.data(), file.size(), crc);
+
+        std::ifstream stream{file, std::ios::binary};
+        while (stream)
+        {
+            stream.read(buffer.data(), buffer.size());
+            crc = crc32(buffer.data(), stream.gcount(), crc);
+        }
+    }
+
+    return crc;
+}
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "policy_table.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+/**
+ * @class Reloader
+ *
+ * Holds the current policy table, and can rebuild it on a worker
+ * thread when its files change.
+ *
+ * A new table is fully loaded off to the side and then published
+ * with an atomic pointer swap, so lookups never block and never see
+ * a partially loaded table.  Anyone still using the old table keeps
+ * it alive through their shared_ptr until they are done with it.
+ */
+class Reloader
+{
+  public:
+    Reloader() = delete;
+    Reloader(const Reloader&) = delete;
+    Reloader& operator=(const Reloader&) = delete;
+    Reloader(Reloader&&) = delete;
+    Reloader& operator=(Reloader&&) = delete;
+
+    /**
+     * Constructor
+     *
+     * Loads the initial table on the calling thread.
+     *
+     * @param[in] imageFile - the path to the compiled policy image
+     * @param[in] jsonFile - the path to the policy JSON
+     */
+    Reloader(const std::string& imageFile, const std::string& jsonFile);
+
+    /**
+     * Constructor
+     *
+     * Loads the initial table on the calling thread.
+     *
+     * @param[in] imageFile - the path to the compiled policy image
+     * @param[in] jsonFiles - the paths to the policy JSON files to merge
+     */
+    Reloader(const std::string& imageFile,
+             const std::vector<std::string>& jsonFiles);
+
+    /**
+     * Destructor
+     *
+     * Waits for any reload in progress to finish.
+     */
+    ~Reloader();
+
+    /**
+     * Returns the current policy table
+     *
+     * @return shared_ptr<const Table>
+     */
+    inline std::shared_ptr<const Table> get() const
+    {
+        return table.load();
+    }
+
+    /**
+     * Starts reloading the table on a worker thread.  If a reload
+     * is already running, it will run again once it finishes.
+     *
+     * The table is only replaced if the contents of the files
+     * changed and the new table loaded successfully.
+     */
+    void reload();
+
+    /**
+     * Waits for any reload in progress, and any asked for
+     * while it was running, to finish.
+     */
+    void wait();
+
+    /**
+     * Returns the number of times a new table was published.
+     *
+     * @return uint32_t
+     */
+    inline uint32_t generation() const
+    {
+        return reloads;
+    }
+
+  private:
+    /**
+     * Does the reloading, on the worker thread.
+     */
+    void run();
+
+    /**
+     * Returns a hash of the contents of the policy files
+     *
+     * @return uint32_t - the CRC-32 of the files
+     */
+    uint32_t contentHash() const;
+
+    /**
+     * The path to the compiled policy image
+     */
+    const std::string imageFile;
+
+    /**
+     * The paths to the policy JSON
+     */
+    const std::vector<std::string> jsonFiles;
+
+    /**
+     * The published policy table
+     */
+    std::atomic<std::shared_ptr<const Table>> table;
+
+    /**
+     * The hash of the files the published table was loaded from.
+     * Only used by whichever thread is loading.
+     */
+    uint32_t hash;
+
+    /**
+     * The number of tables published after the first one
+     */
+    std::atomic<uint32_t> reloads{0};
+
+    /**
+     * Guards busy, requests, and starting and joining the worker
+     */
+    std::mutex mutex;
+
+    /**
+     * If the worker thread is running
+     */
+    bool busy = false;
+
+    /**
+     * Signalled when the worker is done with every request
+     */
+    std::condition_variable idle;
+
+    /**
+     * The number of reloads asked for.  The worker keeps going
+     * until it has loaded after the latest one.
+     */
+    uint64_t requests = 0;
+
+    /**
+     * The worker thread
+     */
+    std::thread worker;
+};
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
@@ -15,11 +15,19 @@
  */
 #include "policy_table.hpp"
 
+#include "policy_image.hpp"
+
 #include <nlohmann/json.hpp>
 #include <phosphor-logging/log.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <experimental/filesystem>
 #include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <unordered_set>
 
 namespace ibm
 {
@@ -31,40 +39,489 @@ namespace policy
 namespace fs = std::experimental::filesystem;
 using namespace phosphor::logging;
 
-Table::Table(const std::string& jsonFile)
+/**
+ * Returns the next unique table ID
+ */
+static uint64_t nextID()
+{
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+}
+
+Table::Table(const std::string& jsonFile) :
+    Table(std::vector<std::string>{jsonFile})
+{}
+
+Table::Table(const std::vector<std::string>& jsonFiles) :
+    tableID(nextID()), pool(std::make_shared<StringPool>())
+{
+    load(jsonFiles);
+}
+
+Table::Table(const std::string& imageFile, const std::string& jsonFile) :
+    Table(imageFile, std::vector<std::string>{jsonFile})
+{}
+
+Table::Table(const std::string& imageFile,
+             const std::vector<std::string>& jsonFiles) :
+    tableID(nextID()), pool(std::make_shared<StringPool>())
+{
+    if (fs::exists(imageFile) && loadImage(imageFile))
+    {
+        // The image takes the place of the first file, and the
+        // rest are merged over it.
+        if (jsonFiles.size() > 1)
+        {
+            load({jsonFiles.begin() + 1, jsonFiles.end()});
+        }
+        return;
+    }
+
+    load(jsonFiles);
+}
+
+bool Table::loadImage(const std::string& imageFile)
 {
-    if (fs::exists(jsonFile))
+    try
     {
-        load(jsonFile);
+        image = std::make_shared<const Image>(imageFile);
+        loaded = true;
     }
-    else
+    catch (const std::exception& e)
     {
-        log<level::INFO>("Policy table JSON file does not exist",
-                         entry("FILE=%s", jsonFile.c_str()));
+        log<level::ERR>("Failed loading policy image, using the JSON",
+                        entry("FILE=%s", imageFile.c_str()),
+                        entry("ERROR=%s", e.what()));
+        image.reset();
     }
+
+    return static_cast<bool>(image);
 }
 
-void Table::load(const std::string& jsonFile)
+/**
+ * @class PolicyReader
+ *
+ * Reads a policy table JSON file as a stream of SAX events, adding
+ * the strings straight to the string pool, so the document is never
+ * built in memory.  Once each policy's error and details have been
+ * read, they are passed to a callback.
+ *
+ * The file is an array of objects like:
+ *   {"err": <error>,
+ *    "dtls": [{"CEID": <ceid>, "mod": <modifier>, "msg": <message>}]}
+ *
+ * Anything else in the objects is skipped.
+ */
+class PolicyReader : public nlohmann::json_sax<nlohmann::json>
 {
+  public:
+    using Refs = std::array<StringPool::Ref, 3>;
+    using Callback = std::function<void(StringPool::Ref error,
+                                        const std::vector<Refs>& details)>;
+
+    PolicyReader(StringPool& pool, Callback callback) :
+        pool(pool), callback(std::move(callback))
+    {}
+
+    /**
+     * Reads the file, throwing on any errors.
+     *
+     * @param[in] file - the JSON file stream
+     */
+    void read(std::istream& file)
+    {
+        if (!nlohmann::json::sax_parse(file, this))
+        {
+            throw std::runtime_error{error};
+        }
+    }
+
+    bool null() override
+    {
+        return value();
+    }
+
+    bool boolean(bool) override
+    {
+        return value();
+    }
+
+    bool number_integer(number_integer_t) override
+    {
+        return value();
+    }
+
+    bool number_unsigned(number_unsigned_t) override
+    {
+        return value();
+    }
+
+    bool number_float(number_float_t, const string_t&) override
+    {
+        return value();
+    }
+
+    bool binary(binary_t&) override
+    {
+        return value();
+    }
+
+    bool string(string_t& val) override
+    {
+        if (field && !skip)
+        {
+            auto ref = pool.add(val);
+            if (depth == policyDepth)
+            {
+                policyError = ref;
+            }
+            else
+            {
+                refs[*field] = ref;
+                found[*field] = true;
+            }
+        }
+        return value();
+    }
+
+    bool start_object(std::size_t) override
+    {
+        depth++;
+        field.reset();
+
+        if (skip)
+        {
+            return true;
+        }
+
+        if (depth == policyDepth)
+        {
+            policyError.reset();
+            details.clear();
+        }
+        else if ((depth == detailsDepth) && inDetails)
+        {
+            found = {};
+        }
+        else if (depth < topDepth + 1)
+        {
+            error = "Policy table is not an array";
+            return false;
+        }
+        else
+        {
+            skip = depth;
+        }
+
+        return true;
+    }
+
+    bool key(string_t& val) override
+    {
+        field.reset();
+        if (skip)
+        {
+            return true;
+        }
+
+        if (depth == policyDepth)
+        {
+            if (val == "err")
+            {
+                field = 0;
+            }
+            inDetails = (val == "dtls");
+        }
+        else if (depth == detailsDepth)
+        {
+            if (val == "mod")
+            {
+                field = 0;
+            }
+            else if (val == "msg")
+            {
+                field = 1;
+            }
+            else if (val == "CEID")
+            {
+                field = 2;
+            }
+        }
+        return true;
+    }
+
+    bool end_object() override
+    {
+        if (skip == depth)
+        {
+            skip = 0;
+        }
+        else if (!skip && (depth == detailsDepth))
+        {
+            if (!std::all_of(found.begin(), found.end(),
+                             [](auto f) { return f; }))
+            {
+                error = "Policy details entry is missing a field";
+                return false;
+            }
+            details.push_back(refs);
+        }
+        else if (!skip && (depth == policyDepth))
+        {
+            if (!policyError)
+            {
+                error = "Policy entry is missing the error";
+                return false;
+            }
+            callback(*policyError, details);
+        }
+
+        depth--;
+        field.reset();
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        depth++;
+        field.reset();
+
+        // Only the top level and the details are arrays
+        if (!skip && (depth != topDepth) &&
+            !((depth == detailsArrayDepth) && inDetails))
+        {
+            skip = depth;
+        }
+        return true;
+    }
+
+    bool end_array() override
+    {
+        if (skip == depth)
+        {
+            skip = 0;
+        }
+        else if (!skip && (depth == detailsArrayDepth))
+        {
+            inDetails = false;
+        }
+
+        depth--;
+        field.reset();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&,
+                     const nlohmann::detail::exception& ex) override
+    {
+        error = ex.what();
+        return false;
+    }
+
+  private:
+    /**
+     * Handles the end of a scalar value
+     */
+    bool value()
+    {
+        if (depth < topDepth)
+        {
+            error = "Policy table is not an array";
+            return false;
+        }
+        field.reset();
+        return true;
+    }
+
+    /**
+     * The nesting levels of the top level array, each policy
+     * object, the details arrays, and each details object
+     */
+    static constexpr size_t topDepth = 1;
+    static constexpr size_t policyDepth = 2;
+    static constexpr size_t detailsArrayDepth = 3;
+    static constexpr size_t detailsDepth = 4;
+
+    StringPool& pool;
+    Callback callback;
+
+    size_t depth = 0;
+
+    /**
+     * The depth of a value being skipped, or 0
+     */
+    size_t skip = 0;
+
+    /**
+     * If inside the current policy's details
+     */
+    bool inDetails = false;
+
+    /**
+     * Which field the next string is for, as an index into refs
+     */
+    std::optional<size_t> field;
+
+    std::optional<StringPool::Ref> policyError;
+    Refs refs;
+    std::array<bool, 3> found{};
+    std::vector<Refs> details;
+
+    std::string error;
+};
+
+void Table::load(const std::vector<std::string>& jsonFiles)
+{
+    std::string current;
+
     try
     {
-        std::ifstream file{jsonFile};
+        // The pool's buffer can move until it is frozen, so keep
+        // offsets into it until everything is added.
+        using Refs = PolicyReader::Refs;
+        std::vector<std::pair<StringPool::Ref, std::vector<Refs>>> errors;
+
+        // Where each error is in errors, and where the entry that is
+        // used for each error and modifier pair is in its details,
+        // keyed on pool offsets.  The pool returns the same offset
+        // for the same string.
+        std::unordered_map<uint32_t, size_t> errorPos;
+        std::unordered_map<uint64_t, size_t> modifierPos;
+
+        size_t sources = 0;
+        size_t conflicts = 0;
+
+        std::unordered_set<uint32_t> seen;
+        std::unordered_set<uint64_t> seenModifiers;
+
+        // An empty string shares its offset with whatever is added
+        // next, so it gets its own key.
+        auto modifierKey = [](StringPool::Ref error,
+                              StringPool::Ref modifier) -> uint64_t {
+            return (static_cast<uint64_t>(error.offset) << 32) |
+                   (modifier.size ? modifier.offset : 0xFFFFFFFF);
+        };
+
+        auto addPolicy = [&](StringPool::Ref error,
+                             const std::vector<Refs>& policyDetails) {
+            // Only the first instance of an error in a file is used.
+            if (!seen.insert(error.offset).second)
+            {
+                return;
+            }
+
+            auto [pos, added] = errorPos.emplace(error.offset, errors.size());
+            if (added)
+            {
+                errors.emplace_back(error, std::vector<Refs>{});
+
+                // When merging over an image, start with its entries
+                // for the error, as if it were the first file.
+                if (image)
+                {
+                    auto& base = errors.back().second;
+                    std::string name{pool->view(error)};
+
+                    for (const auto& d : image->errorDetails(name))
+                    {
+                        Refs refs{pool->add(d.modifier), pool->add(d.msg),
+                                  pool->add(d.ceid)};
+                        modifierPos.emplace(modifierKey(error, refs[0]),
+                                            base.size());
+                        base.push_back(refs);
+                    }
+                }
+            }
+
+            auto& details = errors[pos->second].second;
+
+            for (const auto& refs : policyDetails)
+            {
+                auto key = modifierKey(error, refs[0]);
+
+                // Within a file only the first entry for a modifier
+                // is used, so later ones are just kept in order.
+                auto existing = modifierPos.find(key);
+                if ((existing != modifierPos.end()) &&
+                    seenModifiers.insert(key).second)
+                {
+                    details[existing->second] = refs;
+                    conflicts++;
+
+                    log<level::DEBUG>(
+                        "Policy table entry overridden",
+                        entry("ERROR=%s",
+                              std::string{pool->view(error)}.c_str()),
+                        entry("MODIFIER=%s",
+                              std::string{pool->view(refs[0])}.c_str()),
+                        entry("FILE=%s", current.c_str()));
+                    continue;
+                }
+
+                if (existing == modifierPos.end())
+                {
+                    modifierPos.emplace(key, details.size());
+                    seenModifiers.insert(key);
+                }
+
+                details.push_back(refs);
+            }
+        };
+
+        PolicyReader reader{*pool, addPolicy};
+
+        for (const auto& jsonFile : jsonFiles)
+        {
+            if (!fs::exists(jsonFile))
+            {
+                log<level::INFO>("Policy table JSON file does not exist",
+                                 entry("FILE=%s", jsonFile.c_str()));
+                continue;
+            }
+
+            current = jsonFile;
+            seen.clear();
+            seenModifiers.clear();
+
+            std::ifstream file{jsonFile};
+            reader.read(file);
+            sources++;
+        }
+
+        if (sources == 0)
+        {
+            return;
+        }
 
-        auto json = nlohmann::json::parse(file, nullptr, true);
+        pool->freeze();
 
-        for (const auto& policy : json)
+        size_t detailsCount = 0;
+        policies.reserve(errors.size());
+        for (const auto& [error, refs] : errors)
         {
-            DetailsList detailsList;
+            auto& entry = policies[pool->view(error)];
+            entry.details.reserve(refs.size());
 
-            for (const auto& details : policy["dtls"])
+            for (const auto& [modifier, msg, ceid] : refs)
             {
                 Details d;
-                d.modifier = details["mod"];
-                d.msg = details["msg"];
-                d.ceid = details["CEID"];
-                detailsList.emplace_back(std::move(d));
+                d.modifier = pool->view(modifier);
+                d.msg = pool->view(msg);
+                d.ceid = pool->view(ceid);
+                entry.details.push_back(d);
             }
-            policies.emplace(policy["err"], std::move(detailsList));
+
+            detailsCount += refs.size();
+            index(entry);
+        }
+
+        if ((sources > 1) || image)
+        {
+            log<level::INFO>("Merged policy table files",
+                             entry("FILES=%zu", sources),
+                             entry("ERRORS=%zu", errors.size()),
+                             entry("DETAILS=%zu", detailsCount),
+                             entry("OVERRIDES=%zu", conflicts));
         }
 
         loaded = true;
@@ -72,38 +529,86 @@ void Table::load(const std::string& jsonFile)
     catch (const std::exception& e)
     {
         log<level::ERR>("Failed loading policy table json file",
-                        entry("FILE=%s", jsonFile.c_str()),
+                        entry("FILE=%s", current.c_str()),
                         entry("ERROR=%s", e.what()));
-        loaded = false;
+        policies.clear();
+
+        // An image is still usable without the overlay
+        loaded = static_cast<bool>(image);
     }
 }
 
-FindResult Table::find(const std::string& error,
-                       const std::string& modifier) const
+void Table::index(ErrorPolicy& policy)
+{
+    // The modifier indexes and the catch-all all point to the first
+    // entry with that modifier, to match a front to back search.
+    for (uint32_t i = 0; i < policy.details.size(); i++)
+    {
+        const auto& modifier = policy.details[i].modifier;
+
+        if (modifier.empty())
+        {
+            if (!policy.catchAll)
+            {
+                policy.catchAll = i;
+            }
+        }
+        else if (auto prefix = modifierPrefix(modifier); prefix)
+        {
+            if (!policy.prefixes)
+            {
+                policy.prefixes.emplace();
+            }
+            policy.prefixes->insert(*prefix, i);
+        }
+        else
+        {
+            policy.modifiers.emplace(modifier, i);
+        }
+    }
+}
+
+FindResult Table::find(std::string_view error, std::string_view modifier) const
 {
     // First find the entry based on the error, and then find which
     // underlying details object it is with the help of the modifier.
+    // With an image, only the errors in the overlays are indexed
+    // here, already merged with their image entries.
 
     auto policy = policies.find(error);
 
+    if ((policy == policies.end()) && image)
+    {
+        return image->find(error, modifier);
+    }
+
     if (policy != policies.end())
     {
-        // If there is no exact modifier match, then look for an entry with
-        // an empty modifier - it is the catch-all for that error.
-        auto details = std::find_if(
-            policy->second.begin(), policy->second.end(),
-            [&modifier](const auto& d) { return modifier == d.modifier; });
+        const auto& entry = policy->second;
 
-        if ((details == policy->second.end()) && !modifier.empty())
+        if (!modifier.empty())
         {
-            details =
-                std::find_if(policy->second.begin(), policy->second.end(),
-                             [](const auto& d) { return d.modifier.empty(); });
+            auto details = entry.modifiers.find(modifier);
+            if (details != entry.modifiers.end())
+            {
+                return entry.details[details->second];
+            }
+
+            if (entry.prefixes)
+            {
+                auto prefix = entry.prefixes->find(modifier);
+                if (prefix)
+                {
+                    return entry.details[*prefix];
+                }
+            }
         }
 
-        if (details != policy->second.end())
+        // If there is no exact modifier match, then use the entry with
+        // an empty modifier - it is the catch-all for that error.
+        if (entry.catchAll)
         {
-            return DetailsReference(*details);
+            return entry.details[*entry.catchAll];
         }
     }
 
@@ -2,9 +2,16 @@
 
 #include "config.h"
 
+#include "prefix_trie.hpp"
+#include "string_pool.hpp"
+
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace ibm
@@ -19,20 +26,65 @@ namespace policy
  *  - search modifier
  *  - error message
  *  - common error event ID
+ *
+ *  The strings are owned by the Table, either in its string
+ *  pool or in its mapped policy image.
  */
 struct Details
 {
-    std::string modifier;
-    std::string msg;
-    std::string ceid;
+    std::string_view modifier;
+    std::string_view msg;
+    std::string_view ceid;
 };
 
 using DetailsList = std::vector<Details>;
-using DetailsReference = std::reference_wrapper<const Details>;
-using FindResult = std::optional<DetailsReference>;
+using FindResult = std::optional<Details>;
 
 using PolicyMap = std::map<std::string, DetailsList>;
 
+/**
+ * A modifier ending in this matches any search modifier that
+ * starts with the rest of it, like .../motherboard/dimm*
+ */
+constexpr char prefixWildcard = '*';
+
+/**
+ * Returns the prefix a modifier matches, if it is a prefix modifier
+ *
+ * @param[in] modifier - the policy table modifier
+ *
+ * @return optional<string_view> - the prefix, without the wildcard
+ */
+inline std::optional<std::string_view>
+    modifierPrefix(std::string_view modifier)
+{
+    if (modifier.ends_with(prefixWildcard))
+    {
+        modifier.remove_suffix(1);
+        return modifier;
+    }
+    return {};
+}
+
+/**
+ * The details for a single error, indexed for lookups:
+ * - modifiers - the first details entry for each exact modifier
+ * - prefixes - the first details entry for each prefix modifier,
+ *              only created for the few errors that have any
+ * - catchAll - the first details entry with an empty modifier
+ */
+struct ErrorPolicy
+{
+    DetailsList details;
+    std::unordered_map<std::string_view, uint32_t> modifiers;
+    std::optional<PrefixTrie> prefixes;
+    std::optional<uint32_t> catchAll;
+};
+
+using PolicyIndex = std::unordered_map<std::string_view, ErrorPolicy>;
+
+class Image;
+
 /**
  * @class Table
  *
@@ -40,6 +92,20 @@ using PolicyMap = std::map<std::string, DetailsList>;
  * ability to find a policy table entry based on the error and a
  * search modifier.  This data contains additional information
  * about error logs and may be system specific.
+ *
+ * The data comes from a compiled policy image if one is available,
+ * and otherwise from the policy JSON.
+ *
+ * The JSON can be split across an ordered list of files, such as a
+ * base table followed by a platform overlay, which are merged into
+ * one index when loaded.  An entry in a later file replaces the
+ * first entry for the same error and modifier from the earlier
+ * files, and otherwise is added after them.
+ *
+ * An image stands in for the first file, and the others are merged
+ * over it the same way.  Only the errors in those files are indexed
+ * from JSON, with their image entries copied in, and lookups of all
+ * other errors go to the image.
  */
 class Table
 {
@@ -59,7 +125,42 @@ class Table
     explicit Table(const std::string& jsonFile);
 
     /**
-     * Says if the JSON has been loaded successfully.
+     * Constructor
+     *
+     * Files that don't exist are skipped.
+     *
+     * @param[in] jsonFiles - the paths to the policy JSON, with the
+     *                        overrides after what they override.
+     */
+    explicit Table(const std::vector<std::string>& jsonFiles);
+
+    /**
+     * Constructor
+     *
+     * Uses the compiled policy image if it exists and is valid,
+     * and otherwise falls back to the JSON.
+     *
+     * @param[in] imageFile - the path to the compiled policy image
+     * @param[in] jsonFile - the path to the policy JSON.
+     */
+    Table(const std::string& imageFile, const std::string& jsonFile);
+
+    /**
+     * Constructor
+     *
+     * Uses the compiled policy image in place of the first JSON file
+     * if it exists and is valid, merging the other files over it, and
+     * otherwise falls back to merging all of the JSON files.
+     *
+     * @param[in] imageFile - the path to the compiled policy image
+     * @param[in] jsonFiles - the paths to the policy JSON, with the
+     *                        overrides after what they override.
+     */
+    Table(const std::string& imageFile,
+          const std::vector<std::string>& jsonFiles);
+
+    /**
+     * Says if the policy data has been loaded successfully.
      *
      * @return bool
      */
@@ -72,14 +173,28 @@ class Table
      * Finds an entry in the policy table based on the
      * error and the search modifier.
      *
+     * An entry with the exact modifier is used first, then the
+     * one with the longest prefix modifier that matches, and then
+     * the catch-all entry with an empty modifier.
+     *
      * @param[in] error - the error, like xyz.openbmc_project.Error.X
      * @param[in] modifier - the search modifier, used to find the entry
      *                   when multiple ones share the same error
      *
-     * @return optional<DetailsReference> - the details entry
+     * @return optional<Details> - the details entry
      */
-    FindResult find(const std::string& error,
-                    const std::string& modifier) const;
+    FindResult find(std::string_view error, std::string_view modifier) const;
+
+    /**
+     * Returns an ID that is unique to the policy data this table
+     * loaded.  Copies of a table share the same ID.
+     *
+     * @return uint64_t
+     */
+    inline uint64_t id() const
+    {
+        return tableID;
+    }
 
     /**
      * The default event ID to use when a match in the table
@@ -115,21 +230,55 @@ class Table
     const std::string defaultPolicyMessage{DEFAULT_POLICY_MSG};
 
     /**
-     * Loads the JSON data into the PolicyMap map
+     * Loads and merges the JSON files into the policy index
      *
-     * @param[in] jsonFile - the path to the .json file
+     * @param[in] jsonFiles - the paths to the .json files
      */
-    void load(const std::string& jsonFile);
+    void load(const std::vector<std::string>& jsonFiles);
 
     /**
-     * Reflects if the JSON was successfully loaded or not.
+     * Builds the modifier index for an error's details
+     *
+     * @param[in,out] policy - the error's policy entry
+     */
+    static void index(ErrorPolicy& policy);
+
+    /**
+     * Maps the compiled policy image
+     *
+     * @param[in] imageFile - the path to the image
+     *
+     * @return bool - if the image could be used
+     */
+    bool loadImage(const std::string& imageFile);
+
+    /**
+     * Reflects if the policy data was successfully loaded or not.
      */
     bool loaded = false;
 
     /**
-     * The policy table
+     * The unique ID of this table
+     */
+    uint64_t tableID;
+
+    /**
+     * The compiled policy image, if one is in use
+     */
+    std::shared_ptr<const Image> image;
+
+    /**
+     * Holds all of the text from the JSON that the policy table
+     * points to, with duplicates only stored once.  Shared so that
+     * copies of the Table stay valid.
+     */
+    std::shared_ptr<StringPool> pool;
+
+    /**
+     * The policy table, when loaded from JSON, keyed on the error.
+     * With an image, only the errors from the overlays.
      */
-    PolicyMap policies;
+    PolicyIndex policies;
 };
 } // namespace policy
 } // namespace logging
@@ -0,0 +1,139 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "policy_watch.hpp"
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <phosphor-logging/log.hpp>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <experimental/filesystem>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+namespace fs = std::experimental::filesystem;
+using namespace phosphor::logging;
+
+constexpr auto watchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                           IN_CREATE | IN_DELETE;
+
+Watcher::Watcher(sd_event* event, const std::vector<std::string>& files,
+                 Callback callback) :
+    callback(std::move(callback))
+{
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0)
+    {
+        log<level::ERR>("inotify_init1 failed, policy changes won't be seen",
+                        entry("ERRNO=%d", errno));
+        return;
+    }
+
+    for (const auto& file : files)
+    {
+        fs::path path{file};
+        auto dir = path.parent_path().string();
+
+        this->files.insert(path.string());
+
+        auto wd = inotify_add_watch(fd, dir.c_str(), watchMask);
+        if (wd < 0)
+        {
+            log<level::INFO>("Could not watch policy directory",
+                             entry("DIR=%s", dir.c_str()),
+                             entry("ERRNO=%d", errno));
+            continue;
+        }
+
+        dirs.emplace(wd, dir);
+    }
+
+    auto rc = sd_event_add_io(event, &source, fd, EPOLLIN, handle, this);
+    if (rc < 0)
+    {
+        log<level::ERR>("sd_event_add_io failed for the policy watch",
+                        entry("RC=%d", rc));
+    }
+}
+
+Watcher::~Watcher()
+{
+    sd_event_source_unref(source);
+
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+int Watcher::handle(sd_event_source* /*source*/, int /*fd*/,
+                    uint32_t /*revents*/, void* data)
+{
+    static_cast<Watcher*>(data)->read();
+    return 0;
+}
+
+void Watcher::read()
+{
+    alignas(inotify_event) std::array<char, 4096> buffer;
+    bool changed = false;
+
+    while (true)
+    {
+        auto size = ::read(fd, buffer.data(), buffer.size());
+        if (size <= 0)
+        {
+            break;
+        }
+
+        for (auto offset = 0; offset < size;)
+        {
+            auto event =
+                reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto dir = dirs.find(event->wd);
+            if ((dir == dirs.end()) || (event->len == 0))
+            {
+                continue;
+            }
+
+            auto path = (fs::path{dir->second} / event->name).string();
+            if (files.find(path) != files.end())
+            {
+                changed = true;
+            }
+        }
+    }
+
+    if (changed)
+    {
+        callback();
+    }
+}
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
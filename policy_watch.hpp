@@ -0,0 +1,96 @@
+#pragma once
+
+#include <systemd/sd-event.h>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+namespace policy
+{
+
+/**
+ * @class Watcher
+ *
+ * Uses inotify on an sd_event loop to watch for the policy files
+ * being written, created, moved, or deleted, and calls a callback
+ * when they are.
+ *
+ * The directories that hold the files are what is actually watched,
+ * so files that don't exist yet or that get replaced by a rename are
+ * still caught.
+ */
+class Watcher
+{
+  public:
+    using Callback = std::function<void()>;
+
+    Watcher() = delete;
+    Watcher(const Watcher&) = delete;
+    Watcher& operator=(const Watcher&) = delete;
+    Watcher(Watcher&&) = delete;
+    Watcher& operator=(Watcher&&) = delete;
+
+    /**
+     * Constructor
+     *
+     * @param[in] event - the sd_event loop to use
+     * @param[in] files - the files to watch
+     * @param[in] callback - the function to call when a file changes
+     */
+    Watcher(sd_event* event, const std::vector<std::string>& files,
+            Callback callback);
+
+    /**
+     * Destructor
+     */
+    ~Watcher();
+
+  private:
+    /**
+     * The sd_event IO callback for the inotify file descriptor
+     */
+    static int handle(sd_event_source* source, int fd, uint32_t revents,
+                      void* data);
+
+    /**
+     * Reads the inotify events, and calls the callback once if
+     * any of them were for a watched file.
+     */
+    void read();
+
+    /**
+     * The inotify file descriptor
+     */
+    int fd = -1;
+
+    /**
+     * The IO event source for the file descriptor
+     */
+    sd_event_source* source = nullptr;
+
+    /**
+     * The watched directories, keyed on watch descriptor
+     */
+    std::map<int, std::string> dirs;
+
+    /**
+     * The full paths of the watched files
+     */
+    std::set<std::string> files;
+
+    /**
+     * The function to call on a change
+     */
+    Callback callback;
+};
+
+} // namespace policy
+} // namespace logging
+} // namespace ibm
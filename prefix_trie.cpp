@@ -0,0 +1,123 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "prefix_trie.hpp"
+
+#include <algorithm>
+
+namespace ibm
+{
+namespace logging
+{
+
+PrefixTrie::PrefixTrie() : nodes(1) {}
+
+std::optional<uint32_t> PrefixTrie::child(const Node& node, char c) const
+{
+    for (auto index : node.children)
+    {
+        if (nodes[index].label.front() == c)
+        {
+            return index;
+        }
+    }
+    return {};
+}
+
+bool PrefixTrie::insert(std::string_view prefix, uint32_t value)
+{
+    uint32_t current = 0;
+
+    while (!prefix.empty())
+    {
+        auto next = child(nodes[current], prefix.front());
+        if (!next)
+        {
+            // Nothing shares this part of the prefix
+            Node leaf;
+            leaf.label = prefix;
+            nodes.push_back(std::move(leaf));
+            nodes[current].children.push_back(nodes.size() - 1);
+            current = nodes.size() - 1;
+            break;
+        }
+
+        auto label = nodes[*next].label;
+        auto [p, l] = std::mismatch(prefix.begin(), prefix.end(),
+                                    label.begin(), label.end());
+        size_t common = l - label.begin();
+
+        if (common < label.size())
+        {
+            // Split the edge where the prefix leaves it, with the
+            // new node taking over the rest of the label.
+            Node tail;
+            tail.label = label.substr(common);
+            tail.value = nodes[*next].value;
+            tail.children = std::move(nodes[*next].children);
+            nodes.push_back(std::move(tail));
+
+            auto& split = nodes[*next];
+            split.label = label.substr(0, common);
+            split.value = noValue;
+            split.children = {static_cast<uint32_t>(nodes.size() - 1)};
+        }
+
+        current = *next;
+        prefix.remove_prefix(common);
+    }
+
+    if (nodes[current].value != noValue)
+    {
+        return false;
+    }
+
+    nodes[current].value = value;
+    count++;
+    return true;
+}
+
+std::optional<uint32_t> PrefixTrie::find(std::string_view key) const
+{
+    std::optional<uint32_t> best;
+    const Node* node = &nodes.front();
+
+    while (true)
+    {
+        if (node->value != noValue)
+        {
+            best = node->value;
+        }
+
+        if (key.empty())
+        {
+            break;
+        }
+
+        auto next = child(*node, key.front());
+        if (!next || !key.starts_with(nodes[*next].label))
+        {
+            break;
+        }
+
+        node = &nodes[*next];
+        key.remove_prefix(node->label.size());
+    }
+
+    return best;
+}
+
+} // namespace logging
+} // namespace ibm
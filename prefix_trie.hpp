@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * @class PrefixTrie
+ *
+ * A compressed radix trie of string prefixes, each with a value,
+ * that finds the longest prefix of a key in one walk down the key.
+ *
+ * Each edge holds a run of characters instead of just one, so the
+ * trie has at most twice as many nodes as prefixes.  Views into the
+ * prefixes are kept, so they must outlive the trie.
+ */
+class PrefixTrie
+{
+  public:
+    PrefixTrie();
+    ~PrefixTrie() = default;
+    PrefixTrie(const PrefixTrie&) = default;
+    PrefixTrie& operator=(const PrefixTrie&) = default;
+    PrefixTrie(PrefixTrie&&) = default;
+    PrefixTrie& operator=(PrefixTrie&&) = default;
+
+    /**
+     * Adds a prefix, unless it is already there, in which case
+     * the original value is kept.
+     *
+     * @param[in] prefix - the prefix
+     * @param[in] value - the value for it
+     *
+     * @return bool - if it was added
+     */
+    bool insert(std::string_view prefix, uint32_t value);
+
+    /**
+     * Finds the longest prefix of the key in the trie.
+     *
+     * @param[in] key - the string to match
+     *
+     * @return optional<uint32_t> - the value of the longest prefix
+     */
+    std::optional<uint32_t> find(std::string_view key) const;
+
+    /**
+     * Says if there are no prefixes
+     *
+     * @return bool
+     */
+    inline bool empty() const
+    {
+        return count == 0;
+    }
+
+    /**
+     * The number of prefixes
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return count;
+    }
+
+  private:
+    static constexpr uint32_t noValue = 0xFFFFFFFF;
+
+    /**
+     * A node, which is reached through the characters in label
+     * from its parent.
+     */
+    struct Node
+    {
+        std::string_view label;
+        uint32_t value = noValue;
+        std::vector<uint32_t> children;
+    };
+
+    /**
+     * Returns the child of a node whose label starts with c
+     *
+     * @param[in] node - the parent node
+     * @param[in] c - the first character of the label
+     *
+     * @return optional<uint32_t> - the index of the child
+     */
+    std::optional<uint32_t> child(const Node& node, char c) const;
+
+    /**
+     * The nodes, with the root first
+     */
+    std::vector<Node> nodes;
+
+    /**
+     * The number of prefixes
+     */
+    size_t count = 0;
+};
+
+} // namespace logging
+} // namespace ibm
@@ -0,0 +1,57 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "string_pool.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace ibm
+{
+namespace logging
+{
+
+StringPool::StringPool() : index(0, Hash{this}, Equal{this}) {}
+
+StringPool::Ref StringPool::add(std::string_view value)
+{
+    auto existing = index.find(value);
+    if (existing != index.end())
+    {
+        return *existing;
+    }
+
+    if (value.size() > std::numeric_limits<uint32_t>::max() - data.size())
+    {
+        throw std::length_error{"String pool is full"};
+    }
+
+    Ref ref{static_cast<uint32_t>(data.size()),
+            static_cast<uint32_t>(value.size())};
+    data.append(value);
+    index.insert(ref);
+
+    return ref;
+}
+
+void StringPool::freeze()
+{
+    decltype(index) empty{0, Hash{this}, Equal{this}};
+    index.swap(empty);
+    data.shrink_to_fit();
+}
+
+} // namespace logging
+} // namespace ibm
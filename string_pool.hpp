@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+namespace ibm
+{
+namespace logging
+{
+
+/**
+ * @class StringPool
+ *
+ * Stores strings back to back in a single buffer, only keeping one
+ * copy of each unique string.
+ *
+ * Since the buffer may move while strings are being added, they are
+ * referred to by offset until freeze() is called.  After that the
+ * buffer never changes, and views into it stay valid for the life
+ * of the pool.
+ */
+class StringPool
+{
+  public:
+    /**
+     * The location of a string in the pool
+     */
+    struct Ref
+    {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    StringPool();
+    ~StringPool() = default;
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+    StringPool(StringPool&&) = delete;
+    StringPool& operator=(StringPool&&) = delete;
+
+    /**
+     * Adds a string to the pool, unless it is already there.
+     *
+     * Must not be called after freeze().
+     *
+     * @param[in] value - the string to add
+     *
+     * @return Ref - where the string is in the pool
+     */
+    Ref add(std::string_view value);
+
+    /**
+     * Returns a view of a string in the pool.  It is only stable
+     * once the pool is frozen.
+     *
+     * @param[in] ref - the string's location
+     *
+     * @return string_view
+     */
+    inline std::string_view view(Ref ref) const
+    {
+        return std::string_view{data}.substr(ref.offset, ref.size);
+    }
+
+    /**
+     * Stops any more strings from being added, and frees the
+     * memory only needed for adding them.
+     */
+    void freeze();
+
+    /**
+     * Returns the number of bytes of string data in the pool
+     *
+     * @return size_t
+     */
+    inline size_t size() const
+    {
+        return data.size();
+    }
+
+  private:
+    /**
+     * Hashes pool entries and strings the same way, so the
+     * interning index can be searched with a string_view.
+     */
+    struct Hash
+    {
+        using is_transparent = void;
+        const StringPool* pool;
+
+        size_t operator()(std::string_view value) const
+        {
+            return std::hash<std::string_view>{}(value);
+        }
+
+        size_t operator()(Ref ref) const
+        {
+            return (*this)(pool->view(ref));
+        }
+    };
+
+    /**
+     * Compares pool entries and strings
+     */
+    struct Equal
+    {
+        using is_transparent = void;
+        const StringPool* pool;
+
+        template <typename A, typename B>
+        bool operator()(const A& a, const B& b) const
+        {
+            return get(a) == get(b);
+        }
+
+        std::string_view get(std::string_view value) const
+        {
+            return value;
+        }
+
+        std::string_view get(Ref ref) const
+        {
+            return pool->view(ref);
+        }
+    };
+
+    /**
+     * The string data
+     */
+    std::string data;
+
+    /**
+     * The index of unique strings, only used while adding
+     */
+    std::unordered_set<Ref, Hash, Equal> index;
+};
+
+} // namespace logging
+} // namespace ibm
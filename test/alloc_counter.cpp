@@ -0,0 +1,148 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "alloc_counter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+std::atomic<size_t> allocCount{0};
+std::atomic<size_t> allocBytes{0};
+std::atomic<size_t> peakBytes{0};
+
+// Room in front of each allocation to remember its size,
+// which keeps the default new alignment.
+constexpr size_t headerSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void* allocate(size_t size)
+{
+    auto p = static_cast<char*>(std::malloc(size + headerSize));
+    if (!p)
+    {
+        throw std::bad_alloc{};
+    }
+
+    *reinterpret_cast<size_t*>(p) = size;
+
+    allocCount++;
+    auto current = allocBytes += size;
+    auto peak = peakBytes.load();
+    while ((current > peak) && !peakBytes.compare_exchange_weak(peak, current))
+    {}
+
+    return p + headerSize;
+}
+
+void deallocate(void* ptr)
+{
+    if (ptr)
+    {
+        auto p = static_cast<char*>(ptr) - headerSize;
+        allocBytes -= *reinterpret_cast<size_t*>(p);
+        std::free(p);
+    }
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return allocate(size);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void* ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    deallocate(ptr);
+}
+
+namespace ibm
+{
+namespace logging
+{
+namespace test
+{
+
+AllocCounter::AllocCounter() :
+    startAllocations(allocCount), startBytes(allocBytes)
+{
+    peakBytes = startBytes;
+}
+
+size_t AllocCounter::allocations() const
+{
+    return allocCount - startAllocations;
+}
+
+long AllocCounter::bytes() const
+{
+    return static_cast<long>(allocBytes) - static_cast<long>(startBytes);
+}
+
+size_t AllocCounter::peak() const
+{
+    return peakBytes - startBytes;
+}
+
+} // namespace test
+} // namespace logging
+} // namespace ibm
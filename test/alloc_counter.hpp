@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ibm
+{
+namespace logging
+{
+namespace test
+{
+
+/**
+ * @class AllocCounter
+ *
+ * Tracks heap allocations made through operator new, which the
+ * test binary replaces, from when the object is created.
+ */
+class AllocCounter
+{
+  public:
+    AllocCounter();
+
+    /**
+     * The number of allocations made
+     *
+     * @return size_t
+     */
+    size_t allocations() const;
+
+    /**
+     * The number of bytes currently allocated, minus what
+     * was allocated at the start.
+     *
+     * @return long
+     */
+    long bytes() const;
+
+    /**
+     * The highest number of bytes allocated at any point,
+     * minus what was allocated at the start.
+     *
+     * @return size_t
+     */
+    size_t peak() const;
+
+  private:
+    size_t startAllocations;
+    size_t startBytes;
+};
+
+} // namespace test
+} // namespace logging
+} // namespace ibm
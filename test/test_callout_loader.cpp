@@ -0,0 +1,139 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "callout_loader.hpp"
+#include "callout_store.hpp"
+
+#include <algorithm>
+#include <experimental/filesystem>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace ibm::logging;
+namespace fs = std::experimental::filesystem;
+
+class CalloutLoaderTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        char dir[] = {"./calloutloaderXXXXXX"};
+
+        persistDir = mkdtemp(dir);
+
+        store = std::make_unique<CalloutStore>(persistDir);
+        store->loadIndex();
+
+        // Every third log has no callouts
+        for (uint32_t id = 1; id <= numLogs; id++)
+        {
+            for (uint32_t num = 0; (id % 3) && (num < id % 3 + 1); num++)
+            {
+                CalloutRecord record;
+                record.entryID = id;
+                record.calloutNum = num;
+                record.timestamp = id * 10;
+                record.inventoryPath =
+                    "/xyz/openbmc_project/inventory/system/dimm" +
+                    std::to_string(num);
+                record.serialNumber = "YF11U78AZ0" + std::to_string(id);
+                store->append(record);
+            }
+        }
+    }
+
+    virtual void TearDown()
+    {
+        store.reset();
+        fs::remove_all(persistDir);
+    }
+
+    static constexpr uint32_t numLogs = 500;
+
+    fs::path persistDir;
+    std::unique_ptr<CalloutStore> store;
+};
+
+TEST_F(CalloutLoaderTest, TestOrder)
+{
+    // Newest first, to check the order isn't the file's
+    std::vector<uint32_t> ids;
+    for (uint32_t id = numLogs; id > 0; id--)
+    {
+        ids.push_back(id);
+    }
+
+    for (size_t threads : {1, 4})
+    {
+        CalloutLoader loader{*store, ids, threads, 7};
+        CalloutLoader::Batch batch;
+        size_t next = 0;
+
+        while (loader.next(batch))
+        {
+            EXPECT_LE(batch.size(), 7);
+
+            for (const auto& loaded : batch)
+            {
+                ASSERT_EQ(loaded.entryID, ids[next++]);
+
+                auto id = loaded.entryID;
+                ASSERT_EQ(loaded.records.size(), (id % 3) ? id % 3 + 1 : 0);
+
+                for (size_t num = 0; num < loaded.records.size(); num++)
+                {
+                    EXPECT_EQ(loaded.records[num].calloutNum, num);
+                    EXPECT_EQ(loaded.records[num].timestamp, id * 10);
+                    EXPECT_EQ(loaded.records[num].serialNumber,
+                              "YF11U78AZ0" + std::to_string(id));
+                }
+            }
+        }
+
+        EXPECT_EQ(next, ids.size());
+        EXPECT_FALSE(loader.next(batch));
+    }
+}
+
+TEST_F(CalloutLoaderTest, TestStopEarly)
+{
+    std::vector<uint32_t> ids;
+    for (uint32_t id = 1; id <= numLogs; id++)
+    {
+        ids.push_back(id);
+    }
+
+    // Destroying it with batches left over doesn't wait for them
+    CalloutLoader loader{*store, ids, 4, 1};
+    CalloutLoader::Batch batch;
+    ASSERT_TRUE(loader.next(batch));
+    EXPECT_EQ(batch[0].entryID, 1);
+}
+
+TEST_F(CalloutLoaderTest, TestNothingToLoad)
+{
+    CalloutLoader loader{*store, {}};
+    CalloutLoader::Batch batch;
+    EXPECT_FALSE(loader.next(batch));
+}
+
+TEST(CalloutLoaderThreadsTest, TestThreadCount)
+{
+    EXPECT_EQ(CalloutLoader::threadCount(3), 3);
+    EXPECT_EQ(CalloutLoader::threadCount(),
+              std::max(std::thread::hardware_concurrency(), 1u));
+}
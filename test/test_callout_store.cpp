@@ -0,0 +1,422 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+
+#include "callout_store.hpp"
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/tuple.hpp>
+
+#include <experimental/filesystem>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+using namespace ibm::logging;
+namespace fs = std::experimental::filesystem;
+
+/**
+ * Stands in for the Callout class when writing
+ * files in the old directory layout.
+ */
+struct OldCallout
+{
+    size_t id;
+    uint64_t timestamp;
+    std::string path;
+};
+
+CEREAL_CLASS_VERSION(OldCallout, CALLOUT_CLASS_VERSION);
+
+template <class Archive>
+void save(Archive& archive, const OldCallout& callout,
+          const std::uint32_t version)
+{
+    archive(callout.id, callout.timestamp, callout.path,
+            std::string{"Date42"}, std::string{"Mfg42"},
+            std::string{"Model42"}, std::string{"PN42"}, std::string{"SN42"});
+}
+
+class CalloutStoreTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        char dir[] = {"./calloutstoreXXXXXX"};
+
+        persistDir = mkdtemp(dir);
+    }
+
+    virtual void TearDown()
+    {
+        fs::remove_all(persistDir);
+    }
+
+    CalloutRecord makeRecord(uint32_t entryID, uint32_t calloutNum)
+    {
+        CalloutRecord record;
+        record.entryID = entryID;
+        record.calloutNum = calloutNum;
+        record.timestamp = 1000 + entryID;
+        record.inventoryPath = "/xyz/openbmc_project/inventory/system/dimm" +
+                               std::to_string(calloutNum);
+        record.partNumber = "01DH051";
+        record.serialNumber = "YF11U78AZ0" + std::to_string(entryID);
+        return record;
+    }
+
+    fs::path persistDir;
+};
+
+TEST_F(CalloutStoreTest, TestAppendErase)
+{
+    {
+        CalloutStore store{persistDir};
+        EXPECT_TRUE(store.load().empty());
+        EXPECT_TRUE(fs::exists(persistDir / CalloutStore::fileName));
+
+        store.append(makeRecord(1, 0));
+        store.append(makeRecord(1, 1));
+        store.append(makeRecord(2, 0));
+        store.append(makeRecord(3, 0));
+
+        EXPECT_TRUE(store.erase(2));
+        EXPECT_FALSE(store.erase(2));
+        EXPECT_FALSE(store.erase(4));
+        EXPECT_LT(store.liveSize(), store.fileSize());
+    }
+
+    CalloutStore store{persistDir};
+    auto records = store.load();
+
+    ASSERT_EQ(records.size(), 2);
+    ASSERT_EQ(records[1].size(), 2);
+    EXPECT_EQ(records[1][1].calloutNum, 1);
+    EXPECT_EQ(records[1][1].timestamp, 1001);
+    EXPECT_EQ(records[1][1].inventoryPath,
+              "/xyz/openbmc_project/inventory/system/dimm1");
+    EXPECT_EQ(records[1][1].partNumber, "01DH051");
+    EXPECT_EQ(records[1][1].manufacturer, "");
+    ASSERT_EQ(records[3].size(), 1);
+    EXPECT_EQ(records[3][0].serialNumber, "YF11U78AZ03");
+    EXPECT_EQ(records.count(2), 0);
+
+    // Deleting a log's callouts after a restart
+    EXPECT_TRUE(store.erase(1));
+}
+
+TEST_F(CalloutStoreTest, TestDamagedTail)
+{
+    auto path = persistDir / CalloutStore::fileName;
+    uint64_t goodSize = 0;
+    {
+        CalloutStore store{persistDir};
+        store.load();
+        store.append(makeRecord(1, 0));
+        goodSize = store.fileSize();
+        store.append(makeRecord(2, 0));
+    }
+
+    // Cut the last record short, like a power loss would
+    fs::resize_file(path, fs::file_size(path) - 3);
+
+    {
+        CalloutStore store{persistDir};
+        auto records = store.load();
+        EXPECT_EQ(records.size(), 1);
+        EXPECT_EQ(records.count(1), 1);
+        EXPECT_EQ(fs::file_size(path), goodSize);
+
+        // Appends carry on from the good records
+        store.append(makeRecord(3, 0));
+    }
+
+    // Corrupt a byte in the last record
+    {
+        std::fstream file{path.c_str(),
+                          std::ios::in | std::ios::out | std::ios::binary};
+        file.seekp(goodSize + sizeof(store::RecordHeader) + 2);
+        file.put(0x7F);
+    }
+
+    CalloutStore store{persistDir};
+    auto records = store.load();
+    EXPECT_EQ(records.size(), 1);
+    EXPECT_EQ(fs::file_size(path), goodSize);
+}
+
+TEST_F(CalloutStoreTest, TestBadHeader)
+{
+    auto path = persistDir / CalloutStore::fileName;
+    {
+        std::ofstream file{path.c_str()};
+        file << "not a callout log";
+    }
+
+    CalloutStore store{persistDir};
+    EXPECT_TRUE(store.load().empty());
+    EXPECT_TRUE(fs::exists(path.string() + ".bad"));
+
+    store.append(makeRecord(1, 0));
+    EXPECT_EQ(store.fileSize(), store.liveSize() + sizeof(store::FileHeader));
+}
+
+TEST_F(CalloutStoreTest, TestCompaction)
+{
+    auto path = persistDir / CalloutStore::fileName;
+    uint32_t numLogs = 1000;
+    {
+        CalloutStore store{persistDir};
+        store.load();
+
+        for (uint32_t id = 1; id <= numLogs; id++)
+        {
+            store.append(makeRecord(id, 0));
+            store.append(makeRecord(id, 1));
+        }
+        EXPECT_FALSE(store.needsCompaction());
+
+        // Delete the oldest 3/4 of them
+        for (uint32_t id = 1; id <= numLogs * 3 / 4; id++)
+        {
+            store.erase(id);
+        }
+        ASSERT_TRUE(store.needsCompaction());
+
+        auto live = store.liveSize();
+        store.compact();
+
+        EXPECT_FALSE(store.needsCompaction());
+        EXPECT_EQ(store.liveSize(), live);
+        EXPECT_EQ(store.fileSize(), live + sizeof(store::FileHeader));
+        EXPECT_EQ(fs::file_size(path), store.fileSize());
+        EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+
+        // It can still be added to and deleted from
+        store.erase(numLogs);
+        store.append(makeRecord(numLogs + 1, 0));
+    }
+
+    CalloutStore store{persistDir};
+    auto records = store.load();
+
+    ASSERT_EQ(records.size(), numLogs / 4);
+    EXPECT_EQ(records.begin()->first, numLogs * 3 / 4 + 1);
+    EXPECT_EQ(records.begin()->second.size(), 2);
+    EXPECT_EQ(records.count(numLogs), 0);
+    EXPECT_EQ(records.rbegin()->first, numLogs + 1);
+}
+
+TEST_F(CalloutStoreTest, TestMigration)
+{
+    // Logs 5 and 7 have callouts, 6 has an empty directory
+    for (auto [entryID, calloutNum] : {std::pair{5, 0}, {5, 1}, {7, 0}})
+    {
+        auto dir = persistDir / std::to_string(entryID) / "callouts";
+        fs::create_directories(dir);
+
+        std::ofstream stream(dir / std::to_string(calloutNum),
+                             std::ios::binary);
+        cereal::BinaryOutputArchive oarchive(stream);
+        oarchive(OldCallout{static_cast<size_t>(calloutNum),
+                            static_cast<uint64_t>(entryID * 10),
+                            "/inventory/" + std::to_string(calloutNum)});
+    }
+    fs::create_directories(persistDir / "6" / "callouts");
+
+    // Not a log directory, so left alone
+    fs::create_directories(persistDir / "other");
+
+    {
+        CalloutStore store{persistDir};
+        auto records = store.load();
+
+        ASSERT_EQ(records.size(), 2);
+        ASSERT_EQ(records[5].size(), 2);
+        EXPECT_EQ(records[5][0].entryID, 5);
+        EXPECT_EQ(records[5][1].calloutNum, 1);
+        EXPECT_EQ(records[5][1].timestamp, 50);
+        EXPECT_EQ(records[5][1].inventoryPath, "/inventory/1");
+        EXPECT_EQ(records[5][1].buildDate, "Date42");
+        EXPECT_EQ(records[5][1].serialNumber, "SN42");
+        EXPECT_EQ(records[7][0].timestamp, 70);
+
+        EXPECT_FALSE(fs::exists(persistDir / "5"));
+        EXPECT_FALSE(fs::exists(persistDir / "6"));
+        EXPECT_FALSE(fs::exists(persistDir / "7"));
+        EXPECT_TRUE(fs::exists(persistDir / "other"));
+    }
+
+    // Only done once
+    fs::create_directories(persistDir / "8" / "callouts");
+
+    CalloutStore store{persistDir};
+    EXPECT_EQ(store.load().size(), 2);
+    EXPECT_FALSE(fs::exists(persistDir / "8"));
+    EXPECT_TRUE(fs::exists(persistDir / "other"));
+}
+
+TEST_F(CalloutStoreTest, TestMigrationInterrupted)
+{
+    auto dir = persistDir / "5" / "callouts";
+    fs::create_directories(dir);
+    {
+        std::ofstream stream(dir / "0", std::ios::binary);
+        cereal::BinaryOutputArchive oarchive(stream);
+        oarchive(OldCallout{0, 50, "/inventory/0"});
+    }
+
+    // Save a copy of the old directory to put back after
+    // the migration, like a crash before it was removed
+    fs::copy(persistDir / "5", persistDir / "copy",
+             fs::copy_options::recursive);
+    {
+        CalloutStore store{persistDir};
+        EXPECT_EQ(store.load().size(), 1);
+    }
+    ASSERT_FALSE(fs::exists(persistDir / "5"));
+    fs::rename(persistDir / "copy", persistDir / "5");
+
+    // The callouts aren't migrated twice
+    CalloutStore store{persistDir};
+    auto records = store.load();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(records[5].size(), 1);
+    EXPECT_EQ(records[5][0].timestamp, 50);
+    EXPECT_FALSE(fs::exists(persistDir / "5"));
+}
+
+TEST_F(CalloutStoreTest, TestRestoreIndex)
+{
+    auto indexPath = persistDir / CalloutStore::indexName;
+    uint64_t indexed = 0;
+    {
+        CalloutStore store{persistDir};
+        store.loadIndex();
+
+        for (uint32_t id = 1; id <= 10; id++)
+        {
+            store.append(makeRecord(id, 0));
+            store.append(makeRecord(id, 1));
+        }
+        store.erase(3);
+        store.sync();
+        store.saveIndex();
+        EXPECT_EQ(store.indexLag(), 0);
+        indexed = store.fileSize();
+
+        // Changes made after it was saved
+        store.erase(4);
+        store.append(makeRecord(11, 0));
+        store.append(makeRecord(5, 2));
+        EXPECT_GT(store.indexLag(), 0);
+    }
+
+    CalloutStore store{persistDir};
+    auto index = store.loadIndex();
+
+    // Only what came after the index was read
+    EXPECT_EQ(store.scannedSize(), store.fileSize() - indexed);
+
+    ASSERT_EQ(index.size(), 9);
+    EXPECT_EQ(index.count(3), 0);
+    EXPECT_EQ(index.count(4), 0);
+    EXPECT_EQ(index[1].timestamp, 1001);
+    EXPECT_EQ(index[1].count, 2);
+    EXPECT_EQ(index[5].count, 3);
+    EXPECT_EQ(index[11].count, 1);
+
+    auto records = store.read(5);
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[2].calloutNum, 2);
+    EXPECT_EQ(records[2].inventoryPath,
+              "/xyz/openbmc_project/inventory/system/dimm2");
+    EXPECT_TRUE(store.read(4).empty());
+
+    // A damaged index is ignored, and the whole log is read
+    {
+        std::fstream file{indexPath.c_str(),
+                          std::ios::in | std::ios::out | std::ios::binary};
+        file.seekp(sizeof(store::IndexHeader) + 4);
+        file.put(0x7F);
+    }
+
+    CalloutStore reread{persistDir};
+    EXPECT_EQ(reread.loadIndex().size(), 9);
+    EXPECT_EQ(reread.scannedSize(),
+              reread.fileSize() - sizeof(store::FileHeader));
+    EXPECT_EQ(reread.read(5).size(), 3);
+}
+
+TEST_F(CalloutStoreTest, TestStaleIndex)
+{
+    auto indexPath = persistDir / CalloutStore::indexName;
+    uint32_t numLogs = 1000;
+    {
+        CalloutStore store{persistDir};
+        store.loadIndex();
+
+        for (uint32_t id = 1; id <= numLogs; id++)
+        {
+            store.append(makeRecord(id, 0));
+        }
+        store.sync();
+        store.saveIndex();
+    }
+
+    // Keep the index from before the compaction
+    fs::copy_file(indexPath, persistDir / "old.idx");
+    {
+        CalloutStore store{persistDir};
+        store.loadIndex();
+
+        for (uint32_t id = 1; id <= numLogs * 3 / 4; id++)
+        {
+            store.erase(id);
+        }
+        store.compact();
+
+        // Compacting saves a new one
+        EXPECT_EQ(store.indexLag(), 0);
+    }
+
+    {
+        CalloutStore store{persistDir};
+        auto index = store.loadIndex();
+        EXPECT_EQ(index.size(), numLogs / 4);
+        EXPECT_EQ(store.scannedSize(), 0);
+    }
+
+    // The old index is for the log before it was compacted,
+    // so it isn't used.
+    fs::copy_file(persistDir / "old.idx", indexPath,
+                  fs::copy_options::overwrite_existing);
+
+    CalloutStore store{persistDir};
+    auto index = store.loadIndex();
+    EXPECT_EQ(index.size(), numLogs / 4);
+    EXPECT_EQ(index.begin()->first, numLogs * 3 / 4 + 1);
+    EXPECT_GT(store.scannedSize(), 0);
+    EXPECT_EQ(store.read(numLogs)[0].serialNumber,
+              "YF11U78AZ0" + std::to_string(numLogs));
+
+    // A new log file makes any index useless
+    fs::remove(persistDir / CalloutStore::fileName);
+    CalloutStore recreated{persistDir};
+    EXPECT_TRUE(recreated.loadIndex().empty());
+    EXPECT_FALSE(fs::exists(indexPath));
+}
@@ -0,0 +1,286 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+
+#include "entry_reader.hpp"
+
+#include <sys/socket.h>
+#include <systemd/sd-bus.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace ibm::logging;
+
+/**
+ * Builds D-Bus messages without a bus daemon, using a bus
+ * connected to one end of a socket pair that nothing reads.
+ */
+class EntryReaderTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        ASSERT_GE(sd_bus_new(&bus), 0);
+        ASSERT_GE(sd_bus_set_fd(bus, fds[0], fds[0]), 0);
+        ASSERT_GE(sd_bus_start(bus), 0);
+    }
+
+    virtual void TearDown()
+    {
+        sd_bus_message_unref(msg);
+        sd_bus_close_unref(bus);
+        close(fds[1]);
+    }
+
+    /**
+     * Starts an InterfacesAdded signal for a path
+     */
+    void newSignal(const char* path)
+    {
+        ASSERT_GE(sd_bus_message_new_signal(
+                      bus, &msg, LOGGING_PATH,
+                      "org.freedesktop.DBus.ObjectManager", "InterfacesAdded"),
+                  0);
+        ASSERT_GE(sd_bus_message_append(msg, "o", path), 0);
+    }
+
+    /**
+     * Seals the message and rewinds it to after the path
+     */
+    void seal()
+    {
+        const char* path = nullptr;
+        ASSERT_GE(sd_bus_message_seal(msg, 1, 0), 0);
+        ASSERT_GE(sd_bus_message_rewind(msg, 1), 0);
+        ASSERT_GE(sd_bus_message_read_basic(msg, 'o', &path), 0);
+    }
+
+    int fds[2];
+    sd_bus* bus = nullptr;
+    sd_bus_message* msg = nullptr;
+};
+
+TEST_F(EntryReaderTest, TestReadEntry)
+{
+    newSignal(LOGGING_PATH "/entry/5");
+
+    ASSERT_GE(sd_bus_message_open_container(msg, 'a', "{sa{sv}}"), 0);
+
+    // An interface that is skipped
+    ASSERT_GE(sd_bus_message_append(msg, "{sa{sv}}",
+                                    "xyz.openbmc_project.Object.Delete", 0),
+              0);
+
+    ASSERT_GE(sd_bus_message_append(
+                  msg, "{sa{sv}}", LOGGING_IFACE, 6, "Id", "u", 5, "Message",
+                  "s", "xyz.openbmc_project.Error.Test", "Resolved", "b", 0,
+                  "Timestamp", "t", UINT64_C(1500000000000), "AdditionalData",
+                  "as", 2, "ESEL=00 00 DF 00", "CALLOUT_INVENTORY_PATH=/a/b",
+                  "Severity", "s",
+                  "xyz.openbmc_project.Logging.Entry.Level.Error"),
+              0);
+
+    ASSERT_GE(sd_bus_message_append(msg, "{sa{sv}}", ASSOC_IFACE, 1,
+                                    "Associations", "a(sss)", 2, "callout",
+                                    "fault", "/a/b", "callout", "fault", "/c"),
+              0);
+
+    // A wanted property with the wrong type is skipped
+    ASSERT_GE(sd_bus_message_append(msg, "{sa{sv}}", LOGGING_IFACE, 1,
+                                    "Message", "i", 4),
+              0);
+
+    ASSERT_GE(sd_bus_message_close_container(msg), 0);
+    seal();
+
+    DbusInterfaceMap interfaces;
+    ASSERT_GE(readEntryInterfaces(msg, interfaces), 0);
+
+    ASSERT_EQ(interfaces.size(), 2);
+    const auto& entry = interfaces.at(LOGGING_IFACE);
+    ASSERT_EQ(entry.size(), 3);
+    EXPECT_EQ(std::get<std::string>(entry.at("Message")),
+              "xyz.openbmc_project.Error.Test");
+    EXPECT_EQ(std::get<uint64_t>(entry.at("Timestamp")), 1500000000000);
+
+    std::vector<std::string> data{"ESEL=00 00 DF 00",
+                                  "CALLOUT_INVENTORY_PATH=/a/b"};
+    EXPECT_EQ(std::get<std::vector<std::string>>(entry.at("AdditionalData")),
+              data);
+
+    const auto& assocs = interfaces.at(ASSOC_IFACE);
+    ASSERT_EQ(assocs.size(), 1);
+    AssociationsPropertyType expected{{"callout", "fault", "/a/b"},
+                                      {"callout", "fault", "/c"}};
+    EXPECT_EQ(std::get<AssociationsPropertyType>(assocs.at("Associations")),
+              expected);
+
+    // The whole array was read
+    EXPECT_EQ(sd_bus_message_at_end(msg, 0), 1);
+}
+
+TEST_F(EntryReaderTest, TestNoEntry)
+{
+    newSignal(LOGGING_PATH "/entry/5");
+
+    ASSERT_GE(sd_bus_message_open_container(msg, 'a', "{sa{sv}}"), 0);
+    ASSERT_GE(sd_bus_message_append(msg, "{sa{sv}}",
+                                    "xyz.openbmc_project.Object.Delete", 0),
+              0);
+    ASSERT_GE(sd_bus_message_close_container(msg), 0);
+    seal();
+
+    DbusInterfaceMap interfaces;
+    ASSERT_GE(readEntryInterfaces(msg, interfaces), 0);
+    EXPECT_TRUE(interfaces.empty());
+}
+
+TEST_F(EntryReaderTest, TestReadEntries)
+{
+    // Carries the body of a GetManagedObjects reply
+    ASSERT_GE(sd_bus_message_new_signal(bus, &msg, LOGGING_PATH,
+                                        "org.freedesktop.DBus.ObjectManager",
+                                        "InterfacesAdded"),
+              0);
+
+    ASSERT_GE(sd_bus_message_open_container(msg, 'a', "{oa{sa{sv}}}"), 0);
+
+    ASSERT_GE(sd_bus_message_append(msg, "{oa{sa{sv}}}",
+                                    LOGGING_PATH "/internal/manager", 1,
+                                    "xyz.openbmc_project.Logging.Internal."
+                                    "Manager",
+                                    0),
+              0);
+
+    ASSERT_GE(sd_bus_message_append(msg, "{oa{sa{sv}}}",
+                                    LOGGING_PATH "/entry/1", 1, LOGGING_IFACE,
+                                    2, "Message", "s", "Error.One",
+                                    "Timestamp", "t", UINT64_C(1)),
+              0);
+
+    // An entry's callout isn't an entry
+    ASSERT_GE(sd_bus_message_append(msg, "{oa{sa{sv}}}",
+                                    LOGGING_PATH "/entry/1/callouts/0", 1,
+                                    LOGGING_IFACE, 1, "Message", "s", "No"),
+              0);
+
+    // An entry without the entry interface is skipped
+    ASSERT_GE(sd_bus_message_append(msg, "{oa{sa{sv}}}",
+                                    LOGGING_PATH "/entry/2", 1,
+                                    "xyz.openbmc_project.Object.Delete", 0),
+              0);
+
+    ASSERT_GE(sd_bus_message_append(msg, "{oa{sa{sv}}}",
+                                    LOGGING_PATH "/entry/3", 1, LOGGING_IFACE,
+                                    1, "Message", "s", "Error.Three"),
+              0);
+
+    ASSERT_GE(sd_bus_message_close_container(msg), 0);
+    ASSERT_GE(sd_bus_message_seal(msg, 1, 0), 0);
+    ASSERT_GE(sd_bus_message_rewind(msg, 1), 0);
+
+    std::vector<std::pair<std::string, std::string>> entries;
+    ASSERT_GE(readEntries(msg,
+                          [&entries](const std::string& path,
+                                     const DbusInterfaceMap& interfaces) {
+        const auto& props = interfaces.at(LOGGING_IFACE);
+        entries.emplace_back(path, std::get<std::string>(props.at("Message")));
+    }),
+              0);
+
+    std::vector<std::pair<std::string, std::string>> expected{
+        {LOGGING_PATH "/entry/1", "Error.One"},
+        {LOGGING_PATH "/entry/3", "Error.Three"}};
+    EXPECT_EQ(entries, expected);
+    EXPECT_EQ(sd_bus_message_at_end(msg, 1), 1);
+}
+
+TEST_F(EntryReaderTest, TestReadNewEntries)
+{
+    // The reply from a new owner of the logging service, which
+    // has both the entries already seen and ones created while
+    // the signals weren't being watched.
+    ASSERT_GE(sd_bus_message_new_signal(bus, &msg, LOGGING_PATH,
+                                        "org.freedesktop.DBus.ObjectManager",
+                                        "InterfacesAdded"),
+              0);
+
+    ASSERT_GE(sd_bus_message_open_container(msg, 'a', "{oa{sa{sv}}}"), 0);
+
+    for (auto id : {1, 2, 3, 4})
+    {
+        auto path = LOGGING_PATH "/entry/" + std::to_string(id);
+        auto message = "Error." + std::to_string(id);
+        ASSERT_GE(sd_bus_message_append(msg, "{oa{sa{sv}}}", path.c_str(), 1,
+                                        LOGGING_IFACE, 1, "Message", "s",
+                                        message.c_str()),
+                  0);
+    }
+
+    ASSERT_GE(sd_bus_message_close_container(msg), 0);
+    ASSERT_GE(sd_bus_message_seal(msg, 1, 0), 0);
+    ASSERT_GE(sd_bus_message_rewind(msg, 1), 0);
+
+    std::vector<std::string> known{LOGGING_PATH "/entry/1",
+                                   LOGGING_PATH "/entry/3"};
+    std::vector<std::string> asked;
+    std::vector<std::pair<std::string, std::string>> entries;
+
+    ASSERT_GE(readEntries(
+                  msg,
+                  [&entries](const std::string& path,
+                             const DbusInterfaceMap& interfaces) {
+        const auto& props = interfaces.at(LOGGING_IFACE);
+        entries.emplace_back(path, std::get<std::string>(props.at("Message")));
+    },
+                  [&known, &asked](std::string_view path) {
+        asked.emplace_back(path);
+        return std::find(known.begin(), known.end(), path) == known.end();
+    }),
+              0);
+
+    std::vector<std::string> allPaths{
+        LOGGING_PATH "/entry/1", LOGGING_PATH "/entry/2",
+        LOGGING_PATH "/entry/3", LOGGING_PATH "/entry/4"};
+    EXPECT_EQ(asked, allPaths);
+
+    // Only the new ones are passed on, and the rest are
+    // skipped over.
+    std::vector<std::pair<std::string, std::string>> expected{
+        {LOGGING_PATH "/entry/2", "Error.2"},
+        {LOGGING_PATH "/entry/4", "Error.4"}};
+    EXPECT_EQ(entries, expected);
+    EXPECT_EQ(sd_bus_message_at_end(msg, 1), 1);
+}
+
+TEST(EntryPathTest, TestEntryPath)
+{
+    EXPECT_TRUE(isEntryPath(LOGGING_PATH "/entry/5"));
+    EXPECT_TRUE(isEntryPath(LOGGING_PATH "/entry/123456"));
+
+    EXPECT_FALSE(isEntryPath(LOGGING_PATH "/entry/"));
+    EXPECT_FALSE(isEntryPath(LOGGING_PATH "/entry/5/callouts/0"));
+    EXPECT_FALSE(isEntryPath(LOGGING_PATH "/internal/manager"));
+    EXPECT_FALSE(isEntryPath(LOGGING_PATH));
+    EXPECT_FALSE(isEntryPath("/xyz/openbmc_project/inventory/entry/5"));
+    EXPECT_FALSE(isEntryPath(LOGGING_PATH "/entry/5\xe9"));
+}
@@ -0,0 +1,261 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "alloc_counter.hpp"
+#include "entry_store.hpp"
+
+#include <algorithm>
+#include <any>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+using namespace ibm::logging;
+
+/**
+ * Stands in for the D-Bus objects a log has
+ */
+struct Object
+{
+    explicit Object(uint32_t id) : id(id)
+    {
+    }
+    uint32_t id;
+    char data[60] = {};
+};
+
+/**
+ * The same shape as the Manager's records
+ */
+struct Record
+{
+    std::unique_ptr<Object> policy;
+    InlineVector<std::unique_ptr<Object>, 2> callouts;
+};
+
+TEST(InlineVectorTest, TestVector)
+{
+    auto object = std::make_shared<int>(5);
+    InlineVector<std::shared_ptr<int>, 2> objects;
+    EXPECT_TRUE(objects.empty());
+
+    for (int i = 0; i < 4; i++)
+    {
+        objects.push_back(object);
+    }
+    objects.push_back(std::make_shared<int>(6));
+
+    EXPECT_EQ(objects.size(), 5);
+    EXPECT_EQ(object.use_count(), 5);
+    EXPECT_EQ(*objects[1], 5);
+    EXPECT_EQ(*objects[3], 5);
+    EXPECT_EQ(*objects[4], 6);
+
+    objects.clear();
+    EXPECT_TRUE(objects.empty());
+    EXPECT_EQ(object.use_count(), 1);
+
+    // Nothing is allocated for the inline elements
+    test::AllocCounter counter;
+    InlineVector<std::unique_ptr<Object>, 2> small;
+    small.push_back(nullptr);
+    small.push_back(nullptr);
+    EXPECT_EQ(counter.allocations(), 0);
+}
+
+TEST(EntryStoreTest, TestInsertErase)
+{
+    EntryStore<Record> store;
+    EXPECT_EQ(store.find(1), nullptr);
+    EXPECT_FALSE(store.erase(1));
+
+    for (uint32_t id = 5; id < 10; id++)
+    {
+        auto& record = store.insert(id);
+        record.policy = std::make_unique<Object>(id);
+    }
+    store.insert(7).callouts.push_back(std::make_unique<Object>(70));
+
+    EXPECT_EQ(store.size(), 5);
+    EXPECT_EQ(store.slotCount(), 5);
+    ASSERT_NE(store.find(7), nullptr);
+    EXPECT_EQ(store.find(7)->policy->id, 7);
+    EXPECT_EQ(store.find(7)->callouts[0]->id, 70);
+    EXPECT_EQ(store.find(4), nullptr);
+    EXPECT_EQ(store.find(10), nullptr);
+
+    // A record in the middle leaves an empty slot
+    auto record8 = store.find(8);
+    EXPECT_TRUE(store.erase(7));
+    EXPECT_FALSE(store.erase(7));
+    EXPECT_EQ(store.find(7), nullptr);
+    EXPECT_EQ(store.size(), 4);
+    EXPECT_EQ(store.slotCount(), 5);
+
+    // The others stay where they were
+    EXPECT_EQ(store.find(8), record8);
+
+    // Removing the oldest frees the slots up to the next record
+    EXPECT_TRUE(store.erase(5));
+    EXPECT_TRUE(store.erase(6));
+    EXPECT_EQ(store.slotCount(), 2);
+    EXPECT_EQ(store.find(8)->policy->id, 8);
+
+    EXPECT_TRUE(store.erase(9));
+    EXPECT_TRUE(store.erase(8));
+    EXPECT_EQ(store.size(), 0);
+    EXPECT_EQ(store.slotCount(), 0);
+
+    // Starts over at the next ID
+    store.insert(100);
+    EXPECT_EQ(store.slotCount(), 1);
+    EXPECT_NE(store.find(100), nullptr);
+}
+
+TEST(EntryStoreTest, TestOutOfOrder)
+{
+    // The order the logs are restored in, sorted by path
+    EntryStore<Record> store;
+    for (uint32_t id : {10, 11, 2, 3, 9})
+    {
+        store.insert(id).policy = std::make_unique<Object>(id);
+    }
+
+    EXPECT_EQ(store.size(), 5);
+    EXPECT_EQ(store.slotCount(), 10);
+    for (uint32_t id : {2, 3, 9, 10, 11})
+    {
+        ASSERT_NE(store.find(id), nullptr);
+        EXPECT_EQ(store.find(id)->policy->id, id);
+    }
+    EXPECT_EQ(store.find(5), nullptr);
+    EXPECT_EQ(store.find(1), nullptr);
+
+    EXPECT_TRUE(store.erase(2));
+    EXPECT_TRUE(store.erase(3));
+    EXPECT_EQ(store.slotCount(), 3);
+}
+
+TEST(EntryStoreTest, TestOldSurvivor)
+{
+    // One old log is kept while thousands of newer ones come and go,
+    // like an informational log that outlives the error logs.
+    constexpr uint32_t window = 50;
+    EntryStore<Record> store;
+    store.insert(1).policy = std::make_unique<Object>(1);
+
+    size_t mostSlots = 0;
+    for (uint32_t id = 2; id <= 20000; id++)
+    {
+        store.insert(id).policy = std::make_unique<Object>(id);
+        if (id > window + 1)
+        {
+            ASSERT_TRUE(store.erase(id - window));
+        }
+        mostSlots = std::max(mostSlots, store.slotCount());
+    }
+
+    EXPECT_EQ(store.size(), window + 1);
+    EXPECT_LE(mostSlots, EntryStore<Record>::minSpan + 1);
+    EXPECT_EQ(store.sparseCount(), 1);
+
+    ASSERT_NE(store.find(1), nullptr);
+    EXPECT_EQ(store.find(1)->policy->id, 1);
+    EXPECT_EQ(store.insert(1).policy->id, 1);
+    for (uint32_t id = 20000 - window + 1; id <= 20000; id++)
+    {
+        ASSERT_NE(store.find(id), nullptr);
+        EXPECT_EQ(store.find(id)->policy->id, id);
+    }
+    EXPECT_EQ(store.find(2), nullptr);
+
+    // A log restored far before the others goes straight to
+    // the sparse map
+    store.insert(1000).policy = std::make_unique<Object>(1000);
+    EXPECT_EQ(store.sparseCount(), 2);
+    EXPECT_EQ(store.find(1000)->policy->id, 1000);
+
+    EXPECT_TRUE(store.erase(1));
+    EXPECT_FALSE(store.erase(1));
+    EXPECT_EQ(store.find(1), nullptr);
+    EXPECT_TRUE(store.erase(1000));
+    EXPECT_EQ(store.sparseCount(), 0);
+    EXPECT_EQ(store.size(), window);
+}
+
+TEST(EntryStoreTest, TestFootprint)
+{
+    // The layout the Manager used before, with the objects
+    // type erased in maps of maps.
+    enum class InterfaceType
+    {
+        CALLOUT,
+        POLICY
+    };
+    using InterfaceMap = std::map<InterfaceType, std::any>;
+    using InterfaceMapMulti = std::map<InterfaceType, std::vector<std::any>>;
+
+    constexpr uint32_t numLogs = 1000;
+    long before = 0;
+    long after = 0;
+    size_t allocationsBefore = 0;
+    size_t allocationsAfter = 0;
+
+    {
+        std::map<uint32_t, InterfaceMap> entries;
+        std::map<uint32_t, InterfaceMapMulti> childEntries;
+
+        test::AllocCounter counter;
+        for (uint32_t id = 1; id <= numLogs; id++)
+        {
+            std::any policy = std::make_shared<Object>(id);
+            entries[id].emplace(InterfaceType::POLICY, policy);
+
+            std::any callout = std::make_shared<Object>(id);
+            childEntries[id][InterfaceType::CALLOUT].emplace_back(callout);
+        }
+        before = counter.bytes();
+        allocationsBefore = counter.allocations();
+    }
+
+    {
+        EntryStore<Record> store;
+
+        test::AllocCounter counter;
+        for (uint32_t id = 1; id <= numLogs; id++)
+        {
+            auto& record = store.insert(id);
+            record.policy = std::make_unique<Object>(id);
+            record.callouts.push_back(std::make_unique<Object>(id));
+        }
+        after = counter.bytes();
+        allocationsAfter = counter.allocations();
+    }
+
+    std::cout << "Heap used per log with a policy and a callout: "
+              << before / numLogs << " bytes in " << allocationsBefore / numLogs
+              << " allocations before, " << after / numLogs << " bytes in "
+              << allocationsAfter / numLogs << " allocations after\n";
+    RecordProperty("BytesPerLogBefore", std::to_string(before / numLogs));
+    RecordProperty("BytesPerLogAfter", std::to_string(after / numLogs));
+
+    EXPECT_LT(after, before);
+
+    // Only the objects themselves are allocated, plus the
+    // occasional deque block.
+    EXPECT_LT(allocationsAfter, 2 * numLogs + numLogs / 4);
+}
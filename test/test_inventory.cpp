@@ -0,0 +1,290 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "inventory_cache.hpp"
+
+#include <sys/socket.h>
+#include <systemd/sd-bus.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+using namespace ibm::logging;
+
+static constexpr auto assetIface =
+    "xyz.openbmc_project.Inventory.Decorator.Asset";
+static constexpr auto invManager = "xyz.openbmc_project.Inventory.Manager";
+static constexpr auto dimm0 =
+    "/xyz/openbmc_project/inventory/system/chassis/motherboard/dimm0";
+static constexpr auto dimm1 =
+    "/xyz/openbmc_project/inventory/system/chassis/motherboard/dimm1";
+static constexpr auto cpu0 =
+    "/xyz/openbmc_project/inventory/system/chassis/motherboard/cpu0";
+
+TEST(ServiceMapTest, TestFill)
+{
+    DbusSubtree tree{
+        {dimm0, {{invManager, {"xyz.openbmc_project.Inventory.Item",
+                               assetIface}}}},
+        {dimm1,
+         {{"xyz.openbmc_project.ObjectMapper", {"org.freedesktop.DBus.Peer"}},
+          {invManager, {assetIface}}}},
+        {cpu0, {{invManager, {"xyz.openbmc_project.Inventory.Item"}}}}};
+
+    ServiceMap services;
+    services.add("/some/old/path", "some.old.service");
+    services.fill(tree, assetIface);
+
+    EXPECT_EQ(services.size(), 2);
+    ASSERT_NE(services.find(dimm0), nullptr);
+    EXPECT_EQ(*services.find(dimm0), invManager);
+    ASSERT_NE(services.find(dimm1), nullptr);
+    EXPECT_EQ(*services.find(dimm1), invManager);
+
+    // Doesn't have the interface
+    EXPECT_EQ(services.find(cpu0), nullptr);
+
+    // Cleared by the fill
+    EXPECT_EQ(services.find("/some/old/path"), nullptr);
+    EXPECT_EQ(services.removeService("some.old.service"), 0);
+}
+
+TEST(ServiceMapTest, TestUpdates)
+{
+    ServiceMap services;
+
+    services.add(dimm0, invManager);
+    services.add(dimm1, invManager);
+    services.add(cpu0, ":1.42");
+    EXPECT_EQ(services.size(), 3);
+
+    // Moving a path to a different service
+    services.add(dimm1, ":1.42");
+    EXPECT_EQ(*services.find(dimm1), ":1.42");
+    EXPECT_EQ(services.size(), 3);
+
+    EXPECT_TRUE(services.remove(dimm0));
+    EXPECT_FALSE(services.remove(dimm0));
+    EXPECT_EQ(services.find(dimm0), nullptr);
+
+    // The manager doesn't have any paths left
+    EXPECT_EQ(services.removeService(invManager), 0);
+
+    EXPECT_EQ(services.removeService(":1.42"), 2);
+    EXPECT_EQ(services.size(), 0);
+    EXPECT_EQ(services.find(cpu0), nullptr);
+    EXPECT_EQ(services.find(dimm1), nullptr);
+
+    // Counts start over when a service comes back
+    services.add(cpu0, ":1.42");
+    EXPECT_EQ(services.removeService(":1.42"), 1);
+}
+
+TEST(AssetCacheTest, TestCache)
+{
+    AssetCache cache;
+    DbusPropertyMap properties{{"PartNumber", std::string{"01DH051"}},
+                               {"SerialNumber", std::string{"YF11U78AZ00"}}};
+
+    EXPECT_EQ(cache.find(dimm0), nullptr);
+    EXPECT_EQ(cache.hits(), 0);
+    EXPECT_EQ(cache.misses(), 1);
+
+    const auto& entry = cache.insert(dimm0, properties);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(*entry, properties);
+
+    auto found = cache.find(dimm0);
+    ASSERT_NE(found, nullptr);
+    ASSERT_TRUE(*found);
+    EXPECT_EQ(std::get<std::string>((*found)->at("PartNumber")), "01DH051");
+    EXPECT_EQ(cache.hits(), 1);
+
+    // A path without an Asset interface is remembered too
+    EXPECT_EQ(cache.find(cpu0), nullptr);
+    cache.insert(cpu0, std::nullopt);
+    found = cache.find(cpu0);
+    ASSERT_NE(found, nullptr);
+    EXPECT_FALSE(*found);
+    EXPECT_EQ(cache.hits(), 2);
+    EXPECT_EQ(cache.misses(), 2);
+    EXPECT_EQ(cache.size(), 2);
+
+    // Invalidating one path
+    EXPECT_TRUE(cache.erase(dimm0));
+    EXPECT_FALSE(cache.erase(dimm0));
+    EXPECT_EQ(cache.find(dimm0), nullptr);
+    EXPECT_NE(cache.find(cpu0), nullptr);
+
+    cache.clear();
+    EXPECT_EQ(cache.size(), 0);
+    EXPECT_EQ(cache.find(cpu0), nullptr);
+    EXPECT_EQ(cache.hits(), 3);
+    EXPECT_EQ(cache.misses(), 4);
+}
+
+/**
+ * Builds the inventory manager's GetManagedObjects reply without a
+ * bus daemon, using a bus connected to one end of a socket pair that
+ * nothing reads.
+ */
+class InventoryReplyTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        ASSERT_GE(sd_bus_new(&bus), 0);
+        ASSERT_GE(sd_bus_set_fd(bus, fds[0], fds[0]), 0);
+        ASSERT_GE(sd_bus_start(bus), 0);
+    }
+
+    virtual void TearDown()
+    {
+        sd_bus_message_unref(msg);
+        sd_bus_close_unref(bus);
+        close(fds[1]);
+    }
+
+    /**
+     * Starts a message to carry the body of the reply
+     */
+    void newReply()
+    {
+        msg = sd_bus_message_unref(msg);
+        ASSERT_GE(sd_bus_message_new_signal(
+                      bus, &msg, "/xyz/openbmc_project/inventory",
+                      "org.freedesktop.DBus.ObjectManager", "InterfacesAdded"),
+                  0);
+        ASSERT_GE(sd_bus_message_open_container(msg, 'a', "{oa{sa{sv}}}"), 0);
+    }
+
+    /**
+     * Adds a FRU, with its Asset interface between two others
+     */
+    void addFRU(const char* path, const char* pn, const char* sn)
+    {
+        ASSERT_GE(sd_bus_message_append(
+                      msg, "{oa{sa{sv}}}", path, 3,
+                      "xyz.openbmc_project.Inventory.Item", 2, "Present", "b",
+                      1, "PrettyName", "s", "DIMM",
+                      assetIface, 3, "PartNumber", "s", pn, "BuildDate", "t",
+                      UINT64_C(1520000000), "SerialNumber", "s", sn,
+                      "xyz.openbmc_project.Inventory.Decorator.Compatible",
+                      1, "Names", "as", 2, "a", "b"),
+                  0);
+    }
+
+    /**
+     * Adds an object without an Asset interface
+     */
+    void addItem(const char* path)
+    {
+        ASSERT_GE(sd_bus_message_append(msg, "{oa{sa{sv}}}", path, 1,
+                                        "xyz.openbmc_project.Inventory.Item",
+                                        1, "Present", "b", 1),
+                  0);
+    }
+
+    /**
+     * Seals the reply and reads it like the warming does
+     */
+    void readReply(ObjectValueTree& objects)
+    {
+        ASSERT_GE(sd_bus_message_close_container(msg), 0);
+        ASSERT_GE(sd_bus_message_seal(msg, 1, 0), 0);
+        ASSERT_GE(sd_bus_message_rewind(msg, 1), 0);
+
+        ASSERT_GE(readInterface(msg, assetIface, objects), 0);
+
+        // The whole reply was read
+        EXPECT_EQ(sd_bus_message_at_end(msg, 1), 1);
+    }
+
+    int fds[2];
+    sd_bus* bus = nullptr;
+    sd_bus_message* msg = nullptr;
+};
+
+TEST_F(InventoryReplyTest, TestWarm)
+{
+    newReply();
+    addFRU(dimm0, "01DH051", "YF11U78AZ00");
+    addItem(cpu0);
+    addFRU(dimm1, "01DH051", "YF11U78AZ01");
+
+    ObjectValueTree objects;
+    readReply(objects);
+
+    // Only the Asset interface and its string properties are kept
+    ASSERT_EQ(objects.size(), 2);
+    const auto& dimm0Ifaces =
+        objects.at(sdbusplus::message::object_path{dimm0});
+    ASSERT_EQ(dimm0Ifaces.size(), 1);
+    const auto& asset = dimm0Ifaces.at(assetIface);
+    ASSERT_EQ(asset.size(), 2);
+    EXPECT_EQ(std::get<std::string>(asset.at("PartNumber")), "01DH051");
+    EXPECT_EQ(std::get<std::string>(asset.at("SerialNumber")), "YF11U78AZ00");
+    EXPECT_EQ(asset.count("BuildDate"), 0);
+
+    ServiceMap services;
+    services.add(objects, invManager);
+    EXPECT_EQ(services.size(), 2);
+    ASSERT_NE(services.find(dimm0), nullptr);
+    EXPECT_EQ(*services.find(dimm0), invManager);
+    ASSERT_NE(services.find(dimm1), nullptr);
+    EXPECT_EQ(*services.find(dimm1), invManager);
+    EXPECT_EQ(services.find(cpu0), nullptr);
+
+    AssetCache cache;
+    EXPECT_EQ(cache.insert(objects, assetIface), 2);
+    EXPECT_EQ(cache.size(), 2);
+
+    auto found = cache.find(dimm1);
+    ASSERT_NE(found, nullptr);
+    ASSERT_TRUE(*found);
+    EXPECT_EQ(std::get<std::string>((*found)->at("SerialNumber")),
+              "YF11U78AZ01");
+    EXPECT_EQ((*found)->size(), 2);
+
+    // Not known to be missing, as another service may have it
+    EXPECT_EQ(cache.find(cpu0), nullptr);
+
+    // Warming again after a restart replaces the old values
+    newReply();
+    addFRU(dimm0, "01DH052", "YF11U78AZ02");
+    addFRU(dimm1, "01DH051", "YF11U78AZ01");
+
+    objects.clear();
+    readReply(objects);
+
+    EXPECT_EQ(cache.insert(objects, assetIface), 2);
+    found = cache.find(dimm0);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(std::get<std::string>((*found)->at("PartNumber")), "01DH052");
+}
+
+TEST_F(InventoryReplyTest, TestBadReply)
+{
+    // Not a GetManagedObjects reply at all
+    ASSERT_GE(sd_bus_message_new_signal(bus, &msg, "/", "a.b", "C"), 0);
+    ASSERT_GE(sd_bus_message_append(msg, "a{sv}", 1, "Present", "b", 1), 0);
+    ASSERT_GE(sd_bus_message_seal(msg, 1, 0), 0);
+    ASSERT_GE(sd_bus_message_rewind(msg, 1), 0);
+
+    ObjectValueTree objects;
+    EXPECT_LT(readInterface(msg, assetIface, objects), 0);
+    EXPECT_TRUE(objects.empty());
+}
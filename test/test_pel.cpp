@@ -0,0 +1,308 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "pel.hpp"
+
+#include <experimental/filesystem>
+#include <climits>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace ibm::logging;
+namespace fs = std::experimental::filesystem;
+
+/**
+ * Makes the start of a PEL with a Private Header and User Header
+ *
+ * @param[in] severity - the User Header severity
+ *
+ * @return the PEL data
+ */
+std::vector<uint8_t> makePEL(uint8_t severity)
+{
+    std::vector<uint8_t> data(pel::headersSize, 0);
+
+    data[0] = 'P';
+    data[1] = 'H';
+    data[3] = pel::privateHeaderSize;
+    data[24] = 'B'; // Creator
+    data[40] = 0x50; // PLID
+    data[41] = 0x00;
+    data[42] = 0x12;
+    data[43] = 0x34;
+
+    auto* uh = &data[pel::privateHeaderSize];
+    uh[0] = 'U';
+    uh[1] = 'H';
+    uh[3] = pel::userHeaderSize;
+    uh[8] = 0x10; // Subsystem
+    uh[9] = 0x03; // Scope
+    uh[10] = severity;
+    uh[11] = 0x01; // Event type
+
+    return data;
+}
+
+/**
+ * Converts bytes to the ESEL hex text form
+ *
+ * @param[in] data - the bytes
+ *
+ * @return the text, like "00 11 22"
+ */
+std::string toHex(const std::vector<uint8_t>& data)
+{
+    static constexpr auto hex = "0123456789abcdef";
+    std::string text;
+
+    for (auto byte : data)
+    {
+        if (!text.empty())
+        {
+            text += ' ';
+        }
+        text += hex[byte >> 4];
+        text += hex[byte & 0xF];
+    }
+
+    return text;
+}
+
+TEST(PELTest, TestDecodeHex)
+{
+    std::vector<uint8_t> bytes(8);
+
+    auto size = pel::decodeHex("00 11 22 ab CD ff", bytes);
+    ASSERT_EQ(size, 6);
+    EXPECT_EQ(bytes[0], 0x00);
+    EXPECT_EQ(bytes[1], 0x11);
+    EXPECT_EQ(bytes[2], 0x22);
+    EXPECT_EQ(bytes[3], 0xab);
+    EXPECT_EQ(bytes[4], 0xcd);
+    EXPECT_EQ(bytes[5], 0xff);
+
+    // Bad digits are 0xF, and a missing second digit is too
+    size = pel::decodeHex("1Z Z2 4", bytes);
+    ASSERT_EQ(size, 3);
+    EXPECT_EQ(bytes[0], 0x1f);
+    EXPECT_EQ(bytes[1], 0xf2);
+    EXPECT_EQ(bytes[2], 0x4f);
+
+    // Only what fits is decoded
+    size = pel::decodeHex("00 11 22 33", std::span{bytes}.first(2));
+    EXPECT_EQ(size, 2);
+
+    EXPECT_EQ(pel::decodeHex("", bytes), 0);
+}
+
+TEST(PELTest, TestDecodeMatchesScalar)
+{
+    // The vectorized path must decode exactly like the scalar one,
+    // for any length and with bad characters mixed in.
+    std::mt19937 random{42};
+    std::uniform_int_distribution<int> chars{0, 255};
+
+    for (size_t length = 0; length < 300; length++)
+    {
+        std::vector<uint8_t> data(length);
+        for (auto& byte : data)
+        {
+            byte = chars(random);
+        }
+
+        auto text = toHex(data);
+        for (size_t i = 0; i < text.size(); i += 1 + chars(random) % 40)
+        {
+            text[i] = static_cast<char>(chars(random));
+        }
+
+        for (auto outSize : {length, length / 2, length + 5})
+        {
+            std::vector<uint8_t> vector(outSize);
+            std::vector<uint8_t> scalar(outSize);
+
+            auto vectorSize = pel::decodeHex(text, vector);
+            auto scalarSize = pel::decodeHexScalar(text, scalar);
+
+            ASSERT_EQ(vectorSize, scalarSize) << length;
+            ASSERT_EQ(vector, scalar) << length;
+        }
+    }
+
+    std::vector<uint8_t> data(1000);
+    for (auto& byte : data)
+    {
+        byte = chars(random);
+    }
+
+    std::vector<uint8_t> bytes(data.size());
+    ASSERT_EQ(pel::decodeHex(toHex(data), bytes), data.size());
+    EXPECT_EQ(bytes, data);
+}
+
+TEST(PELTest, TestParse)
+{
+    auto data = makePEL(0x20);
+
+    auto header = pel::parse(data);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->creatorID, 'B');
+    EXPECT_EQ(header->plid, 0x50001234);
+    EXPECT_EQ(header->subsystem, 0x10);
+    EXPECT_EQ(header->scope, 0x03);
+    EXPECT_EQ(header->severity, 0x20);
+    EXPECT_EQ(header->eventType, 0x01);
+
+    // Cut off after the severity still works
+    auto cutoff = pel::privateHeaderSize + 11;
+    header = pel::parse(std::span{data}.first(cutoff));
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->severity, 0x20);
+    EXPECT_EQ(header->eventType, 0);
+
+    // But not before it
+    EXPECT_FALSE(pel::parse(std::span{data}.first(cutoff - 1)));
+
+    // The User Header has to be there
+    data[pel::privateHeaderSize] = 'X';
+    EXPECT_FALSE(pel::parse(data));
+
+    // The Private Header doesn't
+    data = makePEL(0x40);
+    data[0] = 'X';
+    header = pel::parse(data);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->plid, 0);
+    EXPECT_EQ(header->severity, 0x40);
+}
+
+TEST(PELTest, TestParseESEL)
+{
+    auto data = makePEL(0x10);
+    auto pel = data;
+
+    // The SEL header in front of it
+    data.insert(data.begin(), pel::eselHeaderSize, 0xAA);
+
+    // And a long tail
+    data.resize(16 * 1024, 0x55);
+
+    auto header = pel::parseESEL(toHex(data));
+    ASSERT_TRUE(header);
+    EXPECT_EQ(*header, *pel::parse(pel));
+
+    EXPECT_FALSE(pel::parseESEL(""));
+    EXPECT_FALSE(pel::parseESEL("00 11 22"));
+}
+
+TEST(PELTest, TestSeverityName)
+{
+    EXPECT_EQ(pel::severityName(0x10), "Informational");
+    EXPECT_EQ(pel::severityName(0x1F), "Informational");
+    EXPECT_EQ(pel::severityName(0x20), "Warning");
+    EXPECT_EQ(pel::severityName(0x00), "Critical");
+    EXPECT_EQ(pel::severityName(0x40), "Critical");
+    EXPECT_EQ(pel::severityName(0x50), "Critical");
+    EXPECT_EQ(pel::severityName(0xFF), "Critical");
+}
+
+class PELFileTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        char dir[] = {"./pelTestXXXXXX"};
+
+        pelDir = mkdtemp(dir);
+    }
+
+    virtual void TearDown()
+    {
+        fs::remove_all(pelDir);
+    }
+
+    /**
+     * Writes a PEL fixture file
+     *
+     * @param[in] name - the file name
+     * @param[in] data - the file contents
+     *
+     * @return the file path
+     */
+    std::string write(const std::string& name,
+                      const std::vector<uint8_t>& data)
+    {
+        auto path = (pelDir / name).string();
+        std::ofstream f{path, std::ios::binary};
+        f.write(reinterpret_cast<const char*>(data.data()), data.size());
+        return path;
+    }
+
+    fs::path pelDir;
+};
+
+TEST_F(PELFileTest, TestParseFile)
+{
+    // A full PEL, with more sections after the headers
+    auto data = makePEL(0x20);
+    data.resize(2048, 0x55);
+    auto path = write("full", data);
+
+    auto header = pel::parseFile(path);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(*header, *pel::parse(data));
+
+    // Just the headers
+    data = makePEL(0x10);
+    path = write("headers", data);
+
+    header = pel::parseFile(path);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->severity, 0x10);
+
+    // Cut off after the severity
+    data.resize(pel::privateHeaderSize + 11);
+    path = write("cutoff", data);
+
+    header = pel::parseFile(path);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->severity, 0x10);
+
+    // Too short
+    data.resize(20);
+    EXPECT_FALSE(pel::parseFile(write("short", data)));
+
+    // Empty
+    EXPECT_FALSE(pel::parseFile(write("empty", {})));
+
+    // No User Header
+    data = makePEL(0x10);
+    data[pel::privateHeaderSize + 1] = 0;
+    EXPECT_FALSE(pel::parseFile(write("nouh", data)));
+
+    // Missing, a directory, and nonsense paths
+    EXPECT_FALSE(pel::parseFile((pelDir / "missing").string()));
+    EXPECT_FALSE(pel::parseFile(pelDir.string()));
+    EXPECT_FALSE(pel::parseFile(""));
+    EXPECT_FALSE(pel::parseFile(std::string(PATH_MAX + 1, 'a')));
+
+    // The path doesn't have to be null terminated
+    std::string paths = path + "xyz";
+    EXPECT_TRUE(pel::parseFile(std::string_view{paths}.substr(0, path.size())));
+}
@@ -0,0 +1,282 @@
+/**
+ * Copyright © 2018 IBM Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "callout_store.hpp"
+#include "persist_worker.hpp"
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+using namespace ibm::logging;
+namespace fs = std::experimental::filesystem;
+
+class PersistWorkerTest : public ::testing::Test
+{
+  protected:
+    virtual void SetUp()
+    {
+        char dir[] = {"./persistXXXXXX"};
+
+        persistDir = mkdtemp(dir);
+    }
+
+    virtual void TearDown()
+    {
+        fs::remove_all(persistDir);
+    }
+
+    static CalloutRecord makeRecord(uint32_t entryID)
+    {
+        CalloutRecord record;
+        record.entryID = entryID;
+        record.timestamp = entryID * 10;
+        record.inventoryPath = "/xyz/openbmc_project/inventory/system/dimm0";
+        record.partNumber = "01DH051";
+        record.serialNumber = "YF11U78AZ0" + std::to_string(entryID);
+        return record;
+    }
+
+    fs::path persistDir;
+};
+
+TEST_F(PersistWorkerTest, TestGroupCommit)
+{
+    constexpr uint32_t numLogs = 500;
+    CalloutStore store{persistDir};
+    store.load();
+
+    sd_event* event = nullptr;
+    ASSERT_GE(sd_event_new(&event), 0);
+
+    PersistWorker::Results totals;
+    {
+        PersistWorker worker{store, event,
+                             [&totals](const PersistWorker::Results& results) {
+            totals.committed += results.committed;
+            totals.failed += results.failed;
+            totals.fileSize = results.fileSize;
+        }};
+
+        for (uint32_t id = 1; id <= numLogs; id++)
+        {
+            worker.append(makeRecord(id));
+        }
+
+        // Like a DeleteAll
+        for (uint32_t id = 1; id <= numLogs / 2; id++)
+        {
+            worker.erase(id);
+        }
+        worker.flush();
+
+        // The results come in on the event loop
+        while (totals.committed < numLogs + numLogs / 2)
+        {
+            ASSERT_GE(sd_event_run(event, 1000000), 0);
+        }
+    }
+
+    EXPECT_EQ(totals.failed, 0);
+    EXPECT_GT(totals.fileSize, 0);
+
+    // The changes were synced in batches, not one at a time
+    std::cout << numLogs + numLogs / 2 << " changes took " << store.syncs()
+              << " syncs\n";
+    EXPECT_GE(store.syncs(), 1);
+    EXPECT_LT(store.syncs(), numLogs + numLogs / 2);
+
+    sd_event_unref(event);
+
+    // The index was saved when the worker stopped
+    EXPECT_EQ(store.indexLag(), 0);
+
+    CalloutStore reopened{persistDir};
+    auto records = reopened.load();
+    EXPECT_EQ(reopened.scannedSize(), 0);
+    EXPECT_EQ(records.size(), numLogs / 2);
+    EXPECT_EQ(records.begin()->first, numLogs / 2 + 1);
+}
+
+TEST_F(PersistWorkerTest, TestBoundedQueue)
+{
+    CalloutStore store{persistDir};
+    store.load();
+
+    // Without an event loop, and with room for only a few changes
+    {
+        PersistWorker worker{store, nullptr, nullptr, 4};
+        for (uint32_t id = 1; id <= 100; id++)
+        {
+            worker.append(makeRecord(id));
+        }
+
+        // Destroying it saves what's still queued
+    }
+
+    CalloutStore reopened{persistDir};
+    EXPECT_EQ(reopened.load().size(), 100);
+}
+
+TEST_F(PersistWorkerTest, TestSignalNotDeliveredToWorker)
+{
+    // In a child, because if the worker takes the signal its default
+    // action kills the process.
+    auto pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0)
+    {
+        CalloutStore store{persistDir};
+        store.load();
+        PersistWorker worker{store, nullptr, nullptr};
+
+        // Block SIGUSR1 only after the worker started, so the
+        // worker is the only thread that could take it.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        worker.append(makeRecord(1));
+        kill(getpid(), SIGUSR1);
+        worker.append(makeRecord(2));
+        worker.flush();
+
+        // It has to still be pending for this thread to take
+        timespec timeout{5, 0};
+        if (sigtimedwait(&signals, nullptr, &timeout) != SIGUSR1)
+        {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    CalloutStore store{persistDir};
+    EXPECT_EQ(store.load().size(), 2);
+}
+
+TEST_F(PersistWorkerTest, TestLeftoverTempFile)
+{
+    {
+        CalloutStore store{persistDir};
+        store.load();
+        store.append(makeRecord(1));
+        store.sync();
+    }
+
+    // A compaction that didn't get to its rename
+    auto path = persistDir / CalloutStore::fileName;
+    {
+        std::ofstream temp{path.string() + ".tmp"};
+        temp << "half of a new file";
+    }
+
+    CalloutStore store{persistDir};
+    auto records = store.load();
+    EXPECT_EQ(records.size(), 1);
+    EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+}
+
+TEST_F(PersistWorkerTest, TestCrashConsistency)
+{
+    // A child process saves logs through the worker, keeping the
+    // newest `window` of them and deleting the older ones, so the
+    // log keeps getting compacted.  It reports each log once it's
+    // been saved, and is killed partway through.
+    constexpr uint32_t window = 100;
+    constexpr uint32_t killAfter = 1500;
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    auto pid = fork();
+    ASSERT_GE(pid, 0);
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+
+        CalloutStore store{persistDir};
+        store.load();
+        PersistWorker worker{store, nullptr, nullptr};
+
+        for (uint32_t id = 1;; id++)
+        {
+            worker.append(makeRecord(id));
+            if (id > window)
+            {
+                worker.erase(id - window);
+            }
+            worker.flush();
+
+            if (write(fds[1], &id, sizeof(id)) != sizeof(id))
+            {
+                _exit(1);
+            }
+        }
+    }
+
+    close(fds[1]);
+
+    uint32_t saved = 0;
+    while (saved < killAfter)
+    {
+        ASSERT_EQ(read(fds[0], &saved, sizeof(saved)), sizeof(saved));
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+
+    // Catch up on what it reported before it was killed
+    uint32_t id = 0;
+    while (read(fds[0], &id, sizeof(id)) == sizeof(id))
+    {
+        saved = id;
+    }
+    close(fds[0]);
+
+    // Whatever it reported as saved must be there, and it can only
+    // have gotten as far as the next log and the delete that goes
+    // with it.
+    CalloutStore store{persistDir};
+    auto records = store.load();
+
+    ASSERT_FALSE(records.empty());
+    EXPECT_GE(records.begin()->first, saved - window);
+    EXPECT_LE(records.rbegin()->first, saved + 1);
+
+    for (id = saved - window + 2; id <= saved; id++)
+    {
+        ASSERT_EQ(records.count(id), 1) << id;
+        EXPECT_EQ(records[id][0].serialNumber,
+                  "YF11U78AZ0" + std::to_string(id));
+    }
+
+    EXPECT_FALSE(fs::exists(persistDir / (std::string{CalloutStore::fileName} +
+                                          ".tmp")));
+}
@@ -13,11 +13,22 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include "additional_data.hpp"
+#include "alloc_counter.hpp"
+#include "pel.hpp"
 #include "policy_find.hpp"
+#include "policy_image.hpp"
+#include "policy_reload.hpp"
 #include "policy_table.hpp"
+#include "prefix_trie.hpp"
+
+#include <nlohmann/json.hpp>
 
 #include <experimental/filesystem>
 #include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
 
 #include <gtest/gtest.h>
 
@@ -240,8 +251,8 @@ TEST_F(PolicyTableTest, TestTable)
     ASSERT_EQ(static_cast<bool>(details), true);
     if (details)
     {
-        ASSERT_EQ((*details).get().ceid, "XYZ222");
-        ASSERT_EQ((*details).get().msg, "Error XYZ222");
+        ASSERT_EQ(details->ceid, "XYZ222");
+        ASSERT_EQ(details->msg, "Error XYZ222");
     }
 
     /////////////////////////////////////
@@ -259,8 +270,57 @@ TEST_F(PolicyTableTest, TestTable)
     ASSERT_EQ(static_cast<bool>(details), true);
     if (details)
     {
-        ASSERT_EQ((*details).get().ceid, "CCCCCC");
-        ASSERT_EQ((*details).get().msg, "Error CCCCCC");
+        ASSERT_EQ(details->ceid, "CCCCCC");
+        ASSERT_EQ(details->msg, "Error CCCCCC");
+    }
+}
+
+/**
+ * Test that unknown fields in the policy JSON are skipped, and that
+ * entries missing a field fail the load.
+ */
+TEST_F(PolicyTableTest, TestTableFormat)
+{
+    {
+        std::ofstream f{jsonFile};
+        f << R"([
+            {"comment": {"err": "not.this", "dtls": [{"mod": "x"}]},
+             "dtls": [
+               {"CEID": "AAAA", "mod": "", "msg": "A", "extra": [1, {}]},
+               "junk",
+               {"notes": {"CEID": "BBBB"}, "mod": "b", "msg": "B",
+                "CEID": "BBBB"}
+             ],
+             "err": "xyz.openbmc_project.Error.Format",
+             "tags": ["dtls", ["err"]], "count": 2.5, "flag": null}
+        ])";
+    }
+
+    policy::Table policy{jsonFile};
+    ASSERT_TRUE(policy.isLoaded());
+
+    auto details = policy.find("xyz.openbmc_project.Error.Format", "");
+    ASSERT_TRUE(details);
+    EXPECT_EQ(details->ceid, "AAAA");
+
+    details = policy.find("xyz.openbmc_project.Error.Format", "b");
+    ASSERT_TRUE(details);
+    EXPECT_EQ(details->ceid, "BBBB");
+
+    EXPECT_FALSE(policy.find("not.this", ""));
+
+    for (const auto& contents :
+         {R"([{"err": "e", "dtls": [{"mod": "", "msg": "m"}]}])",
+          R"([{"dtls": [{"mod": "", "msg": "m", "CEID": "c"}]}])",
+          R"({"err": "e", "dtls": []})", R"("policy")", R"([{"err": )"})
+    {
+        {
+            std::ofstream f{jsonFile};
+            f << contents;
+        }
+
+        policy::Table bad{jsonFile};
+        EXPECT_FALSE(bad.isLoaded()) << contents;
     }
 }
 
@@ -392,6 +452,19 @@ TEST_F(PolicyTableTest, TestFinder)
         ASSERT_EQ(std::get<policy::MsgField>(values), "Error IIIIIII");
     }
 
+    // Test a key name inside of another item isn't used as the modifier
+    {
+        std::vector<std::string> ad{
+            "FOO=CALLOUT_DEVICE_PATH=/match/this/path"s};
+        DbusPropertyMap testProperties{
+            {"Message"s, Value{"xyz.openbmc_project.Error.Test8"s}},
+            {"AdditionalData"s, ad}};
+
+        auto values = policy::find(policy, testProperties);
+        ASSERT_EQ(std::get<policy::EIDField>(values), policy.defaultEID());
+        ASSERT_EQ(std::get<policy::MsgField>(values), policy.defaultMsg());
+    }
+
     // Test a predictive SEL matches on 'callout||Warning'
     {
         std::vector<std::string> ad{eSELBase + SEV_PREDICTIVE,
@@ -496,3 +569,1032 @@ TEST_F(PolicyTableTest, TestFinder)
         ASSERT_EQ(std::get<policy::MsgField>(values), "Error PPPPPPPP");
     }
 }
+
+/**
+ * Test getting the severity from a binary PEL file
+ */
+TEST_F(PolicyTableTest, TestRawPEL)
+{
+    using namespace std::literals::string_literals;
+
+    policy::Table policy{jsonFile};
+    ASSERT_EQ(policy.isLoaded(), true);
+
+    // Make a PEL file out of the predictive ESEL, minus the SEL header
+    auto esel = eSELBase.substr(5) + SEV_PREDICTIVE;
+    std::vector<uint8_t> bytes(esel.size());
+    bytes.resize(pel::decodeHex(esel, bytes));
+
+    auto pelFile = jsonDir / "pel";
+    {
+        std::ofstream f{pelFile, std::ios::binary};
+        f.write(reinterpret_cast<const char*>(bytes.data()) +
+                    pel::eselHeaderSize,
+                bytes.size() - pel::eselHeaderSize);
+    }
+
+    // The file alone, 'callout||Warning'
+    {
+        std::vector<std::string> ad{"RAWPEL="s + pelFile.string(),
+                                    "CALLOUT_INVENTORY_PATH=/inventory/core0"s};
+        DbusPropertyMap testProperties{
+            {"Message"s, Value{"org.open_power.Host.Error.Event"s}},
+            {"AdditionalData"s, ad}};
+
+        auto values = policy::find(policy, testProperties);
+        ASSERT_EQ(std::get<policy::EIDField>(values), "JJJJJJJJ");
+    }
+
+    // The file is used over the ESEL
+    {
+        std::vector<std::string> ad{eSELBase + SEV_RECOVERED,
+                                    "RAWPEL="s + pelFile.string(),
+                                    "CALLOUT_INVENTORY_PATH=/inventory/core0"s};
+        DbusPropertyMap testProperties{
+            {"Message"s, Value{"org.open_power.Host.Error.Event"s}},
+            {"AdditionalData"s, ad}};
+
+        auto values = policy::find(policy, testProperties);
+        ASSERT_EQ(std::get<policy::EIDField>(values), "JJJJJJJJ");
+    }
+
+    // Falls back to the ESEL when the file is missing,
+    // 'callout||Informational'
+    {
+        std::vector<std::string> ad{
+            eSELBase + SEV_RECOVERED,
+            "RAWPEL="s + (jsonDir / "missing").string(),
+            "CALLOUT_INVENTORY_PATH=/inventory/core1"s};
+        DbusPropertyMap testProperties{
+            {"Message"s, Value{"org.open_power.Host.Error.Event"s}},
+            {"AdditionalData"s, ad}};
+
+        auto values = policy::find(policy, testProperties);
+        ASSERT_EQ(std::get<policy::EIDField>(values), "KKKKKKKK");
+    }
+}
+
+/**
+ * Test the AdditionalData index
+ */
+TEST(AdditionalDataTest, TestGet)
+{
+    using namespace std::literals::string_literals;
+
+    std::vector<std::string> ad{"B=2"s,       "A=1"s,      "NOEQUALS"s,
+                                "EMPTY="s,    "B=3"s,      "C=x=y"s,
+                                "D=A=wrong"s, "PREFIX_A=4"s};
+    AdditionalData data{ad};
+
+    EXPECT_EQ(data.size(), 7);
+    EXPECT_EQ(*data.get("A"), "1");
+
+    // The first of a duplicate wins
+    EXPECT_EQ(*data.get("B"), "2");
+
+    // Only the first '=' separates the name
+    EXPECT_EQ(*data.get("C"), "x=y");
+
+    // An empty value is still found
+    ASSERT_TRUE(data.get("EMPTY"));
+    EXPECT_EQ(*data.get("EMPTY"), "");
+
+    EXPECT_FALSE(data.get("NOEQUALS"));
+    EXPECT_FALSE(data.get("PREFIX"));
+    EXPECT_FALSE(data.get("E"));
+
+    AdditionalData empty;
+    EXPECT_EQ(empty.size(), 0);
+    EXPECT_FALSE(empty.get("A"));
+}
+
+/**
+ * Test finding entries in a compiled policy image
+ */
+TEST_F(PolicyTableTest, TestImage)
+{
+    using namespace std::literals::string_literals;
+
+    auto imageFile = jsonDir / "policy.bin";
+    policy::image::compile(jsonFile, imageFile);
+    ASSERT_EQ(fs::exists(imageFile), true);
+
+    // Use a JSON path that doesn't exist to prove the image is used
+    policy::Table policy{imageFile, jsonDir / "missing.json"};
+    ASSERT_EQ(policy.isLoaded(), true);
+
+    auto details = policy.find("xyz.openbmc_project.Error.Test2", "");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "XYZ222");
+    EXPECT_EQ(details->msg, "Error XYZ222");
+
+    details = policy.find("xyz.openbmc_project.Error.Test3", "mod3");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "CCCCCC");
+
+    // Not found, and no catch-all
+    details = policy.find("xyz.openbmc_project.Error.Test3", "mod4");
+    EXPECT_EQ(static_cast<bool>(details), false);
+    details = policy.find("foo", "");
+    EXPECT_EQ(static_cast<bool>(details), false);
+
+    // Catch-all when the modifier isn't found
+    details = policy.find("xyz.openbmc_project.Error.Test1", "nomatch");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "ABCD1234");
+
+    std::vector<std::string> ad{eSELBase + SEV_PREDICTIVE,
+                                "CALLOUT_INVENTORY_PATH=/inventory/core0"s};
+    DbusPropertyMap testProperties{
+        {"Message"s, Value{"org.open_power.Host.Error.Event"s}},
+        {"AdditionalData"s, ad}};
+
+    auto values = policy::find(policy, testProperties);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "JJJJJJJJ");
+    EXPECT_EQ(std::get<policy::MsgField>(values), "Error JJJJJJJJ");
+}
+
+/**
+ * Test the longest prefix matching of the prefix trie
+ */
+TEST(PrefixTrieTest, TestFind)
+{
+    PrefixTrie trie;
+    EXPECT_TRUE(trie.empty());
+    EXPECT_FALSE(trie.find("anything"));
+
+    EXPECT_TRUE(trie.insert("/inventory/dimm", 1));
+    EXPECT_TRUE(trie.insert("/inventory/dimm1", 2));
+    EXPECT_TRUE(trie.insert("/inventory/cpu", 3));
+    EXPECT_TRUE(trie.insert("/inv", 4));
+
+    // The first value for a prefix is kept
+    EXPECT_FALSE(trie.insert("/inventory/cpu", 5));
+    EXPECT_EQ(trie.size(), 4);
+
+    EXPECT_EQ(*trie.find("/inventory/dimm12"), 2);
+    EXPECT_EQ(*trie.find("/inventory/dimm1"), 2);
+    EXPECT_EQ(*trie.find("/inventory/dimm2"), 1);
+    EXPECT_EQ(*trie.find("/inventory/cpu0"), 3);
+    EXPECT_EQ(*trie.find("/inventory/fan0"), 4);
+    EXPECT_EQ(*trie.find("/inv"), 4);
+    EXPECT_FALSE(trie.find("/in"));
+    EXPECT_FALSE(trie.find("/system"));
+    EXPECT_FALSE(trie.find(""));
+
+    // Splitting an edge keeps what was below it
+    EXPECT_TRUE(trie.insert("/inventory/d", 6));
+    EXPECT_EQ(*trie.find("/inventory/dimm12"), 2);
+    EXPECT_EQ(*trie.find("/inventory/dimm"), 1);
+    EXPECT_EQ(*trie.find("/inventory/disk"), 6);
+
+    // The empty prefix matches everything
+    EXPECT_TRUE(trie.insert("", 7));
+    EXPECT_EQ(*trie.find("/system"), 7);
+    EXPECT_EQ(*trie.find(""), 7);
+    EXPECT_EQ(*trie.find("/inventory/cpu0"), 3);
+}
+
+/**
+ * Test prefix modifiers, from JSON and from an image
+ */
+TEST_F(PolicyTableTest, TestPrefixModifiers)
+{
+    auto prefixFile = jsonDir / "prefix.json";
+    auto imageFile = jsonDir / "prefix.bin";
+
+    {
+        std::ofstream f{prefixFile};
+        f << R"([
+            {"err": "xyz.openbmc_project.Error.Prefix",
+             "dtls": [
+               {"CEID": "CATCHALL", "mod": "", "msg": "Catch-all"},
+               {"CEID": "DIMM", "mod": "/motherboard/dimm*", "msg": "DIMM"},
+               {"CEID": "DIMM1X", "mod": "/motherboard/dimm1*",
+                "msg": "DIMM 1x"},
+               {"CEID": "DIMM12", "mod": "/motherboard/dimm12",
+                "msg": "DIMM 12"},
+               {"CEID": "DUP", "mod": "/motherboard/dimm*", "msg": "Dup"},
+               {"CEID": "ALL", "mod": "/motherboard/*", "msg": "All"}
+             ]},
+            {"err": "xyz.openbmc_project.Error.NoCatchAll",
+             "dtls": [
+               {"CEID": "CPU", "mod": "/motherboard/cpu*", "msg": "CPU"}
+             ]}
+        ])";
+    }
+
+    policy::image::compile(prefixFile, imageFile);
+
+    policy::Table json{prefixFile};
+    ASSERT_TRUE(json.isLoaded());
+    policy::Table image{imageFile, jsonDir / "missing.json"};
+    ASSERT_TRUE(image.isLoaded());
+
+    std::vector<std::tuple<std::string, std::string, std::string>> tests{
+        // The exact match is first
+        {"xyz.openbmc_project.Error.Prefix", "/motherboard/dimm12", "DIMM12"},
+        // Then the longest prefix
+        {"xyz.openbmc_project.Error.Prefix", "/motherboard/dimm13", "DIMM1X"},
+        {"xyz.openbmc_project.Error.Prefix", "/motherboard/dimm2", "DIMM"},
+        {"xyz.openbmc_project.Error.Prefix", "/motherboard/dimm", "DIMM"},
+        {"xyz.openbmc_project.Error.Prefix", "/motherboard/fan0", "ALL"},
+        // Then the catch-all
+        {"xyz.openbmc_project.Error.Prefix", "/chassis/fan0", "CATCHALL"},
+        {"xyz.openbmc_project.Error.Prefix", "", "CATCHALL"},
+        {"xyz.openbmc_project.Error.NoCatchAll", "/motherboard/cpu0", "CPU"},
+        {"xyz.openbmc_project.Error.NoCatchAll", "/motherboard/dimm0", ""},
+        {"xyz.openbmc_project.Error.NoCatchAll", "", ""}};
+
+    for (const auto& table : {&json, &image})
+    {
+        for (const auto& [error, modifier, ceid] : tests)
+        {
+            auto details = table->find(error, modifier);
+            EXPECT_EQ(static_cast<bool>(details), !ceid.empty()) << modifier;
+            if (details)
+            {
+                EXPECT_EQ(details->ceid, ceid) << modifier;
+            }
+        }
+    }
+}
+
+/**
+ * Test merging a base policy table with an overlay, from JSON,
+ * from an image, and over an image.
+ */
+TEST_F(PolicyTableTest, TestOverlay)
+{
+    auto overlayFile = jsonDir / "overlay.json";
+    auto imageFile = jsonDir / "merged.bin";
+    auto baseImageFile = jsonDir / "base.bin";
+
+    {
+        std::ofstream f{overlayFile};
+        f << R"([
+            {"err": "xyz.openbmc_project.Error.Test3",
+             "dtls": [
+               {"CEID": "NEW222", "mod": "mod2", "msg": "New mod2"},
+               {"CEID": "DUP222", "mod": "mod2", "msg": "Dup mod2"},
+               {"CEID": "NEW444", "mod": "mod4", "msg": "New mod4"},
+               {"CEID": "NEWALL", "mod": "", "msg": "New catch-all"}
+             ]},
+            {"err": "xyz.openbmc_project.Error.Test1",
+             "dtls": [
+               {"CEID": "NEW111", "mod": "", "msg": "New Test1"}
+             ]},
+            {"err": "xyz.openbmc_project.Error.Overlay",
+             "dtls": [
+               {"CEID": "OVERLAY", "mod": "", "msg": "Overlay only"}
+             ]}
+        ])";
+    }
+
+    std::vector<std::string> files{jsonFile, overlayFile};
+    EXPECT_EQ(policy::image::compile(files, imageFile), 2);
+    policy::image::compile(jsonFile, baseImageFile);
+
+    // Missing files are skipped when loading
+    files.push_back(jsonDir / "missing.json");
+    policy::Table json{files};
+    ASSERT_TRUE(json.isLoaded());
+    policy::Table image{imageFile, jsonDir / "missing.json"};
+    ASSERT_TRUE(image.isLoaded());
+
+    // The overlay merged over the base image, which the first file
+    // isn't needed for
+    policy::Table overImage{baseImageFile,
+                            {jsonDir / "missing.json", overlayFile}};
+    ASSERT_TRUE(overImage.isLoaded());
+
+    // Merging it again over an image that already has it
+    policy::Table twice{imageFile, files};
+    ASSERT_TRUE(twice.isLoaded());
+
+    std::vector<std::tuple<std::string, std::string, std::string>> tests{
+        // Overridden
+        {"xyz.openbmc_project.Error.Test3", "mod2", "NEW222"},
+        {"xyz.openbmc_project.Error.Test1", "", "NEW111"},
+        // Added
+        {"xyz.openbmc_project.Error.Test3", "mod4", "NEW444"},
+        {"xyz.openbmc_project.Error.Test3", "nomatch", "NEWALL"},
+        {"xyz.openbmc_project.Error.Overlay", "", "OVERLAY"},
+        // From the base
+        {"xyz.openbmc_project.Error.Test3", "mod1", "AAAAAA"},
+        {"xyz.openbmc_project.Error.Test2", "", "XYZ222"}};
+
+    for (const auto& table : {&json, &image, &overImage, &twice})
+    {
+        for (const auto& [error, modifier, ceid] : tests)
+        {
+            auto details = table->find(error, modifier);
+            ASSERT_TRUE(details) << error << " " << modifier;
+            EXPECT_EQ(details->ceid, ceid) << error << " " << modifier;
+        }
+    }
+
+    // Nothing from the overlay is lost by copying its table
+    auto copy = overImage;
+    auto details = copy.find("xyz.openbmc_project.Error.Test3", "mod2");
+    ASSERT_TRUE(details);
+    EXPECT_EQ(details->ceid, "NEW222");
+    EXPECT_EQ(details->msg, "New mod2");
+
+    // A bad overlay fails the whole load
+    {
+        std::ofstream f{overlayFile};
+        f << "[{";
+    }
+
+    policy::Table bad{files};
+    EXPECT_FALSE(bad.isLoaded());
+
+    // Except with an image, which is still used without it
+    policy::Table badOverImage{baseImageFile, files};
+    ASSERT_TRUE(badOverImage.isLoaded());
+    details = badOverImage.find("xyz.openbmc_project.Error.Test3", "mod2");
+    ASSERT_TRUE(details);
+    EXPECT_EQ(details->ceid, "BBBBBB");
+    EXPECT_THROW(policy::image::compile({jsonFile, overlayFile}, imageFile),
+                 std::exception);
+
+    // Only missing files
+    policy::Table none{std::vector<std::string>{jsonDir / "missing.json"}};
+    EXPECT_FALSE(none.isLoaded());
+}
+
+/**
+ * Test that a corrupted image isn't used, and that the
+ * JSON is used instead.
+ */
+TEST_F(PolicyTableTest, TestBadImage)
+{
+    auto imageFile = jsonDir / "policy.bin";
+    policy::image::compile(jsonFile, imageFile);
+
+    // Flip a byte in the strings section at the end of the file
+    {
+        std::fstream f{imageFile, std::ios::in | std::ios::out |
+                                      std::ios::binary};
+        f.seekp(-1, std::ios::end);
+        f.put('~');
+    }
+
+    policy::Table noJSON{imageFile, jsonDir / "missing.json"};
+    EXPECT_EQ(noJSON.isLoaded(), false);
+
+    policy::Table policy{imageFile, jsonFile};
+    ASSERT_EQ(policy.isLoaded(), true);
+
+    auto details = policy.find("xyz.openbmc_project.Error.Test3", "mod1");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "AAAAAA");
+}
+
+/**
+ * Test compiling the full service policy table format
+ */
+TEST_F(PolicyTableTest, TestCompileFullTable)
+{
+    auto fullFile = jsonDir / "full.json";
+    auto imageFile = jsonDir / "full.bin";
+
+    {
+        std::ofstream f{fullFile};
+        f << R"({"events": {
+            "xyz.openbmc_project.Error.A": {
+                "CommonEventID": "A0", "Message": "Error A"},
+            "xyz.openbmc_project.Error.A||/inventory/dimm0": {
+                "CommonEventID": "A1", "Message": "Error A DIMM 0"},
+            "Not a BMC error": {
+                "CommonEventID": "X", "Message": "Skipped"}
+        }})";
+    }
+
+    policy::image::compile(fullFile, imageFile);
+
+    policy::Table policy{imageFile, jsonDir / "missing.json"};
+    ASSERT_EQ(policy.isLoaded(), true);
+
+    auto details = policy.find("xyz.openbmc_project.Error.A",
+                               "/inventory/dimm0");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "A1");
+
+    details = policy.find("xyz.openbmc_project.Error.A", "/inventory/dimm1");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "A0");
+
+    details = policy.find("Not a BMC error", "");
+    EXPECT_EQ(static_cast<bool>(details), false);
+}
+
+/**
+ * Test reloading the policy table when its contents change
+ */
+TEST_F(PolicyTableTest, TestReload)
+{
+    policy::Reloader reloader{jsonDir / "missing.bin", jsonFile};
+
+    auto table = reloader.get();
+    ASSERT_EQ(table->isLoaded(), true);
+
+    // Rewriting the same contents doesn't publish a new table
+    {
+        std::ofstream f{jsonFile};
+        f << json;
+    }
+    reloader.reload();
+    reloader.wait();
+    EXPECT_EQ(reloader.get(), table);
+    EXPECT_EQ(reloader.generation(), 0);
+
+    // New contents do
+    {
+        std::ofstream f{jsonFile};
+        f << R"([{"err":"xyz.openbmc_project.Error.Test1",
+                  "dtls":[{"CEID":"NEW1234","mod":"","msg":"New"}]}])";
+    }
+    reloader.reload();
+    reloader.wait();
+
+    auto newTable = reloader.get();
+    EXPECT_NE(newTable, table);
+    EXPECT_EQ(reloader.generation(), 1);
+
+    auto details = newTable->find("xyz.openbmc_project.Error.Test1", "");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "NEW1234");
+
+    // Anyone holding the old table can still use it
+    details = table->find("xyz.openbmc_project.Error.Test1", "");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "ABCD1234");
+
+    // A table that fails to load isn't published
+    {
+        std::ofstream f{jsonFile};
+        f << "[{";
+    }
+    reloader.reload();
+    reloader.wait();
+    EXPECT_EQ(reloader.get(), newTable);
+    EXPECT_EQ(reloader.generation(), 1);
+}
+
+/**
+ * Test that a reload asked for while one is running isn't lost,
+ * like when a file is written just after it was created.
+ */
+TEST_F(PolicyTableTest, TestReloadWhileBusy)
+{
+    policy::Reloader reloader{jsonDir / "missing.bin", jsonFile};
+
+    constexpr size_t versions = 200;
+    for (size_t i = 0; i < versions; i++)
+    {
+        {
+            std::ofstream f{jsonFile};
+            f << R"([{"err":"xyz.openbmc_project.Error.Test1",
+                      "dtls":[{"CEID":"V)"
+              << i << R"(","mod":"","msg":"New"}]}])";
+        }
+
+        // Most of these come in while the last one is loading
+        reloader.reload();
+    }
+    reloader.wait();
+
+    // The last contents are always published
+    auto details =
+        reloader.get()->find("xyz.openbmc_project.Error.Test1", "");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "V" + std::to_string(versions - 1));
+    EXPECT_GE(reloader.generation(), 1);
+}
+
+/**
+ * Test the policy lookup cache
+ */
+TEST_F(PolicyTableTest, TestCache)
+{
+    using namespace std::literals::string_literals;
+
+    policy::Table policy{jsonFile};
+    ASSERT_EQ(policy.isLoaded(), true);
+
+    policy::Cache cache{2};
+
+    DbusPropertyMap test1{
+        {"Message"s, Value{"xyz.openbmc_project.Error.Test1"s}}};
+
+    auto values = policy::find(policy, cache, test1);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "ABCD1234");
+    EXPECT_EQ(cache.hits(), 0);
+    EXPECT_EQ(cache.misses(), 1);
+
+    values = policy::find(policy, cache, test1);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "ABCD1234");
+    EXPECT_EQ(cache.hits(), 1);
+    EXPECT_EQ(cache.misses(), 1);
+
+    // Misses in the table are cached too
+    auto details = cache.find(policy, "foo", "");
+    EXPECT_EQ(static_cast<bool>(details), false);
+    details = cache.find(policy, "foo", "");
+    EXPECT_EQ(static_cast<bool>(details), false);
+    EXPECT_EQ(cache.hits(), 2);
+    EXPECT_EQ(cache.misses(), 2);
+    EXPECT_EQ(cache.size(), 2);
+
+    // The least recently used entry, Test1, gets evicted
+    details = cache.find(policy, "xyz.openbmc_project.Error.Test3", "mod2");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(details->ceid, "BBBBBB");
+    EXPECT_EQ(cache.size(), 2);
+
+    details = cache.find(policy, "foo", "");
+    EXPECT_EQ(cache.hits(), 3);
+
+    values = policy::find(policy, cache, test1);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "ABCD1234");
+    EXPECT_EQ(cache.hits(), 3);
+    EXPECT_EQ(cache.misses(), 4);
+
+    // Host event lookups, which try 2 modifiers
+    std::vector<std::string> ad{eSELBase + SEV_RECOVERED,
+                                "CALLOUT_INVENTORY_PATH=/inventory/core5"s};
+    DbusPropertyMap hostEvent{
+        {"Message"s, Value{"org.open_power.Host.Error.Event"s}},
+        {"AdditionalData"s, ad}};
+
+    policy::Cache bigCache{16};
+    for (auto i = 0; i < 3; i++)
+    {
+        values = policy::find(policy, bigCache, hostEvent);
+        EXPECT_EQ(std::get<policy::EIDField>(values), "OOOOOOOO");
+    }
+    EXPECT_EQ(bigCache.misses(), 2);
+    EXPECT_EQ(bigCache.hits(), 4);
+
+    // A different table clears the cache
+    policy::Table newPolicy{jsonFile};
+    details = bigCache.find(newPolicy, "xyz.openbmc_project.Error.Test1", "");
+    ASSERT_EQ(static_cast<bool>(details), true);
+    EXPECT_EQ(bigCache.size(), 1);
+    EXPECT_EQ(bigCache.misses(), 3);
+
+    // A capacity of 0 disables it
+    policy::Cache noCache{0};
+    values = policy::find(policy, noCache, test1);
+    values = policy::find(policy, noCache, test1);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "ABCD1234");
+    EXPECT_EQ(noCache.hits(), 0);
+    EXPECT_EQ(noCache.size(), 0);
+}
+
+/**
+ * Test search modifier rules loaded from a file
+ */
+TEST_F(PolicyTableTest, TestModifierRules)
+{
+    using namespace std::literals::string_literals;
+
+    policy::Table policy{jsonFile};
+    ASSERT_EQ(policy.isLoaded(), true);
+
+    auto rulesFile = jsonDir / "rules.json";
+    {
+        std::ofstream f{rulesFile};
+        f << R"({
+            "firstTry": [
+                {"rule": "value", "field": "FRU",
+                 "message": "xyz.openbmc_project.Error.Test3"}
+            ],
+            "fallback": [
+                {"rule": "classify", "field": "BUS",
+                 "classes": [{"contains": "fsi", "modifier": "FSI"},
+                             {"contains": "i2c", "modifier": "I2C"}]},
+                {"rule": "hex", "field": "FRU"}
+            ]
+        })";
+    }
+
+    policy::Rules rules{rulesFile};
+    EXPECT_TRUE(rules.isLoaded());
+
+    policy::Cache cache{16};
+
+    // The message condition
+    std::vector<std::string> ad{"FRU=mod3"s};
+    DbusPropertyMap test3{
+        {"Message"s, Value{"xyz.openbmc_project.Error.Test3"s}},
+        {"AdditionalData"s, ad}};
+    auto values = policy::find(policy, rules, cache, test3);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "CCCCCC");
+
+    // Only the new rules are used
+    ad = {"CALLOUT_INVENTORY_PATH=mod3"s};
+    test3["AdditionalData"s] = ad;
+    values = policy::find(policy, rules, cache, test3);
+    EXPECT_EQ(std::get<policy::EIDField>(values), policy.defaultEID());
+
+    // Falls through the classify rule to the hex rule
+    ad = {"BUS=/sys/bus/spi"s, "FRU=109"s};
+    DbusPropertyMap test5{
+        {"Message"s, Value{"xyz.openbmc_project.Error.Test5"s}},
+        {"AdditionalData"s, ad}};
+    values = policy::find(policy, rules, cache, test5);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "FFFFFFFF");
+
+    // The first class that matches wins
+    ad = {"BUS=/sys/bus/i2c/fsi"s};
+    DbusPropertyMap test4{
+        {"Message"s, Value{"xyz.openbmc_project.Error.Test4"s}},
+        {"AdditionalData"s, ad}};
+    values = policy::find(policy, rules, cache, test4);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "EEEEEEEE");
+
+    // Both modifiers come out of one evaluation
+    ad = {"FRU=12"s, "BUS=i2c"s};
+    AdditionalData data{ad};
+    policy::ModifierBuffer first;
+    policy::ModifierBuffer fallback;
+    auto modifiers = rules.evaluate("xyz.openbmc_project.Error.Test3", data,
+                                    first, fallback);
+    EXPECT_EQ(modifiers.firstTry, "12");
+    EXPECT_EQ(modifiers.fallback, "I2C");
+
+    modifiers = rules.evaluate("xyz.openbmc_project.Error.Test1", data, first,
+                               fallback);
+    EXPECT_EQ(modifiers.firstTry, "");
+    EXPECT_EQ(modifiers.fallback, "I2C");
+
+    // Or one list at a time, sharing the fields read
+    policy::Rules::Input input{"xyz.openbmc_project.Error.Test3", data};
+    EXPECT_EQ(rules.firstTry(input, first), "12");
+    EXPECT_EQ(rules.fallback(input, fallback), "I2C");
+
+    // A bad hex value gives no modifier
+    ad = {"FRU=x109"s, "BUS=/sys/bus/spi"s};
+    AdditionalData badHex{ad};
+    policy::Rules::Input badInput{"xyz.openbmc_project.Error.Test5", badHex};
+    EXPECT_EQ(rules.fallback(badInput, fallback), "");
+
+    // Including one that isn't ASCII
+    ad = {"FRU=\xe9" "109"s, "BUS=/sys/bus/spi"s};
+    AdditionalData notASCII{ad};
+    policy::Rules::Input notASCIIInput{"xyz.openbmc_project.Error.Test5",
+                                       notASCII};
+    EXPECT_EQ(rules.fallback(notASCIIInput, fallback), "");
+
+    // Bad and missing files use the built-in rules
+    for (const auto& contents :
+         {R"({"fallback": [{"rule": "foo", "field": "FRU"}]})"s,
+          R"({"fallback": [{"rule": "value"}]})"s, "{"s})
+    {
+        std::ofstream{rulesFile} << contents;
+
+        policy::Rules badRules{rulesFile};
+        EXPECT_FALSE(badRules.isLoaded()) << contents;
+
+        ad = {"CALLOUT_INVENTORY_PATH=mod3"s};
+        test3["AdditionalData"s] = ad;
+        values = policy::find(policy, badRules, cache, test3);
+        EXPECT_EQ(std::get<policy::EIDField>(values), "CCCCCC");
+    }
+
+    policy::Rules noRules{jsonDir / "missing.json"};
+    EXPECT_FALSE(noRules.isLoaded());
+    values = policy::find(policy, noRules, cache, test3);
+    EXPECT_EQ(std::get<policy::EIDField>(values), "CCCCCC");
+}
+
+/**
+ * Test that finding the policy for typical logs stays within a
+ * fixed allocation budget, with and without the cache.
+ */
+TEST_F(PolicyTableTest, TestFindAllocations)
+{
+    using namespace std::literals::string_literals;
+
+    // At most the two returned strings may need the heap
+    constexpr size_t allocationBudget = 2;
+
+    policy::Table policy{jsonFile};
+    ASSERT_EQ(policy.isLoaded(), true);
+
+    policy::Cache cache{16};
+
+    std::vector<DbusPropertyMap> logs{
+        {{"Message"s, Value{"xyz.openbmc_project.Error.Test1"s}}},
+        {{"Message"s, Value{"xyz.openbmc_project.Error.Test3"s}},
+         {"AdditionalData"s,
+          std::vector<std::string>{"_PID=1234"s, "FOO=BAR"s,
+                                   "CALLOUT_INVENTORY_PATH=mod2"s}}},
+        {{"Message"s, Value{"xyz.openbmc_project.Error.Test5"s}},
+         {"AdditionalData"s,
+          std::vector<std::string>{"_PID=1234"s, "PROCEDURE=109"s}}},
+        {{"Message"s, Value{"org.open_power.Host.Error.Event"s}},
+         {"AdditionalData"s,
+          std::vector<std::string>{
+              eSELBase + SEV_PREDICTIVE,
+              "CALLOUT_INVENTORY_PATH=/inventory/core0"s}}}};
+
+    // Fill the cache
+    for (const auto& log : logs)
+    {
+        policy::find(policy, cache, log);
+    }
+
+    for (const auto& log : logs)
+    {
+        test::AllocCounter counter;
+        auto values = policy::find(policy, cache, log);
+        EXPECT_LE(counter.allocations(), allocationBudget)
+            << std::get<std::string>(log.at("Message"s));
+        EXPECT_NE(std::get<policy::EIDField>(values), policy.defaultEID());
+    }
+
+    for (const auto& log : logs)
+    {
+        test::AllocCounter counter;
+        auto values = policy::find(policy, log);
+        EXPECT_LE(counter.allocations(), allocationBudget)
+            << std::get<std::string>(log.at("Message"s));
+        EXPECT_NE(std::get<policy::EIDField>(values), policy.defaultEID());
+    }
+}
+
+/**
+ * A generated policy table, along with a copy of it in the
+ * original std::map and linear search implementation of
+ * Table::find() to compare results against.
+ */
+class GeneratedTable
+{
+  public:
+    using Entry = std::tuple<std::string, std::string, std::string>;
+    using ReferenceMap = std::map<std::string, std::vector<Entry>>;
+
+    /**
+     * Generates a table with about the number of details entries
+     * passed in, and writes it to the JSON file.
+     */
+    GeneratedTable(const fs::path& jsonFile, size_t entries)
+    {
+        std::mt19937 rng{42};
+        std::uniform_int_distribution<size_t> count{1, 100};
+        std::uniform_int_distribution<size_t> dimm{0, 200};
+        std::uniform_int_distribution<size_t> percent{0, 99};
+
+        std::ostringstream json;
+        json << "[";
+
+        size_t total = 0;
+        for (size_t e = 0; total < entries; e++)
+        {
+            // Every 50th group is a duplicate of an earlier error,
+            // which must be ignored.
+            auto error = "xyz.openbmc_project.Error.Gen" +
+                         std::to_string((e % 50 == 49) ? e - 10 : e);
+            errors.push_back(error);
+
+            std::vector<Entry> details;
+            auto num = count(rng);
+            for (size_t d = 0; d < num; d++, total++)
+            {
+                // Some catch-alls, and some repeated modifiers
+                std::string mod;
+                if (percent(rng) >= 10)
+                {
+                    mod = "/xyz/openbmc_project/inventory/system/chassis/"
+                          "motherboard/dimm" +
+                          std::to_string(dimm(rng));
+                }
+                queries.emplace_back(error, mod);
+
+                auto ceid = "CEID" + std::to_string(total);
+                details.emplace_back(mod, "Message " + ceid, ceid);
+            }
+
+            json << ((e == 0) ? "" : ",") << R"({"err":")" << error
+                 << R"(","dtls":[)";
+            for (size_t d = 0; d < details.size(); d++)
+            {
+                const auto& [mod, msg, ceid] = details[d];
+                json << ((d == 0) ? "" : ",") << R"({"mod":")" << mod
+                     << R"(","msg":")" << msg << R"(","CEID":")" << ceid
+                     << R"("})";
+            }
+            json << "]}";
+
+            reference.emplace(error, std::move(details));
+        }
+
+        json << "]";
+
+        std::ofstream f{jsonFile};
+        f << json.str();
+        size = total;
+    }
+
+    /**
+     * The original Table::find() algorithm
+     */
+    const Entry* find(const std::string& error,
+                      const std::string& modifier) const
+    {
+        auto policy = reference.find(error);
+        if (policy == reference.end())
+        {
+            return nullptr;
+        }
+
+        auto details = std::find_if(
+            policy->second.begin(), policy->second.end(),
+            [&modifier](const auto& d) { return modifier == std::get<0>(d); });
+
+        if ((details == policy->second.end()) && !modifier.empty())
+        {
+            details = std::find_if(
+                policy->second.begin(), policy->second.end(),
+                [](const auto& d) { return std::get<0>(d).empty(); });
+        }
+
+        return (details != policy->second.end()) ? &*details : nullptr;
+    }
+
+    /**
+     * Checks that a table gives the same results as the
+     * reference for every error and modifier, plus misses.
+     */
+    void compare(const policy::Table& table) const
+    {
+        std::vector<std::string> extraModifiers{
+            "", "nomatch", "/xyz/openbmc_project/inventory/system"};
+
+        auto check = [&](const std::string& error, const std::string& mod) {
+            auto expected = find(error, mod);
+            auto actual = table.find(error, mod);
+
+            ASSERT_EQ(static_cast<bool>(actual), expected != nullptr)
+                << error << " " << mod;
+            if (expected)
+            {
+                ASSERT_EQ(actual->ceid, std::get<2>(*expected))
+                    << error << " " << mod;
+                ASSERT_EQ(actual->msg, std::get<1>(*expected));
+                ASSERT_EQ(actual->modifier, std::get<0>(*expected));
+            }
+        };
+
+        for (const auto& [error, mod] : queries)
+        {
+            check(error, mod);
+        }
+
+        for (const auto& error : errors)
+        {
+            for (const auto& mod : extraModifiers)
+            {
+                check(error, mod);
+            }
+        }
+
+        check("xyz.openbmc_project.Error.Missing", "");
+        check("xyz.openbmc_project.Error.Missing", queries.back().second);
+    }
+
+    /**
+     * The table in the original policy table layout
+     */
+    const ReferenceMap& map() const
+    {
+        return reference;
+    }
+
+    size_t size = 0;
+
+  private:
+    std::vector<std::string> errors;
+    std::vector<std::pair<std::string, std::string>> queries;
+    ReferenceMap reference;
+};
+
+/**
+ * Test that the hash indexed lookups give identical results to
+ * the original implementation on a large table, both from the
+ * JSON and from a compiled image.
+ */
+TEST(PolicyIndexTest, TestLargeTable)
+{
+    char dir[] = {"./jsonTestXXXXXX"};
+    fs::path jsonDir = mkdtemp(dir);
+    auto jsonFile = jsonDir / "policy.json";
+    auto imageFile = jsonDir / "policy.bin";
+
+    GeneratedTable generated{jsonFile, 100000};
+    ASSERT_GE(generated.size, 100000);
+
+    {
+        policy::Table table{jsonFile};
+        ASSERT_EQ(table.isLoaded(), true);
+        generated.compare(table);
+    }
+
+    {
+        policy::image::compile(jsonFile, imageFile);
+        policy::Table table{imageFile, jsonDir / "missing.json"};
+        ASSERT_EQ(table.isLoaded(), true);
+        generated.compare(table);
+    }
+
+    fs::remove_all(jsonDir);
+}
+
+/**
+ * Reports the heap used by a loaded table with its strings in a pool,
+ * compared to the original layout of a std::string per field.
+ */
+TEST(PolicyIndexTest, TestHeapUsage)
+{
+    char dir[] = {"./jsonTestXXXXXX"};
+    fs::path jsonDir = mkdtemp(dir);
+    auto jsonFile = jsonDir / "policy.json";
+
+    GeneratedTable generated{jsonFile, 100000};
+
+    long before = 0;
+    {
+        test::AllocCounter counter;
+        auto copy =
+            std::make_unique<GeneratedTable::ReferenceMap>(generated.map());
+        before = counter.bytes();
+    }
+
+    long after = 0;
+    {
+        test::AllocCounter counter;
+        auto table = std::make_unique<policy::Table>(jsonFile);
+        ASSERT_EQ(table->isLoaded(), true);
+        after = counter.bytes();
+    }
+
+    std::cout << "Heap used by " << generated.size
+              << " policy entries: " << before << " bytes before, " << after
+              << " bytes after\n";
+    RecordProperty("HeapBefore", std::to_string(before));
+    RecordProperty("HeapAfter", std::to_string(after));
+
+    EXPECT_LT(after, before);
+
+    fs::remove_all(jsonDir);
+}
+
+/**
+ * Test that loading a large table never needs much more memory
+ * than the loaded table itself, and less than just building the
+ * JSON document would.
+ */
+TEST(PolicyIndexTest, TestLoadPeak)
+{
+    char dir[] = {"./jsonTestXXXXXX"};
+    fs::path jsonDir = mkdtemp(dir);
+    auto jsonFile = jsonDir / "policy.json";
+
+    GeneratedTable generated{jsonFile, 100000};
+
+    size_t documentPeak = 0;
+    {
+        test::AllocCounter counter;
+        std::ifstream file{jsonFile};
+        auto json = nlohmann::json::parse(file);
+        documentPeak = counter.peak();
+    }
+
+    size_t loadPeak = 0;
+    long loaded = 0;
+    {
+        test::AllocCounter counter;
+        policy::Table table{jsonFile};
+        ASSERT_EQ(table.isLoaded(), true);
+        loadPeak = counter.peak();
+        loaded = counter.bytes();
+
+        generated.compare(table);
+    }
+
+    std::cout << "Loading " << generated.size
+              << " policy entries: " << loadPeak << " bytes peak, " << loaded
+              << " bytes loaded, " << documentPeak
+              << " bytes for the JSON document alone\n";
+    RecordProperty("LoadPeak", std::to_string(loadPeak));
+    RecordProperty("DocumentPeak", std::to_string(documentPeak));
+
+    EXPECT_LT(loadPeak, documentPeak);
+    EXPECT_LT(loadPeak, 2 * static_cast<size_t>(loaded));
+
+    fs::remove_all(jsonDir);
+}